@@ -32,6 +32,8 @@ PRODUCT_PACKAGES += \
     ProxyHandler \
     SharedStorageBackup \
     VpnDialogs \
-    Jdts160demo
+    Jdts160demo \
+    jdtsd \
+    libjdts_jni
 
 $(call inherit-product, $(SRC_TARGET_DIR)/product/core_base.mk)
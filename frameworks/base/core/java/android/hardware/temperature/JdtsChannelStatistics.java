@@ -0,0 +1,69 @@
+package android.hardware.temperature;
+
+import android.os.Parcel;
+import android.os.Parcelable;
+
+/**
+ * Statistics of one channel over the samples of the last windowMs, see
+ * JdtsManager.getStatistics(). Temperatures are in 0.01C like JdtsTemperatureData.
+ *
+ * {@hide}
+ */
+public final class JdtsChannelStatistics implements Parcelable {
+    // JdtsTemperatureData.CHANNEL_*
+    public int channel;
+    public int windowMs;
+    // samples in the window, the rest is meaningless when 0
+    public int count;
+    // from the oldest to the newest sample of the window
+    public int spanMs;
+    public float mean;
+    public float stddev;
+    public int min;
+    public int max;
+    // least squares trend, 0.01C per second
+    public float slope;
+
+    public static final Parcelable.Creator<JdtsChannelStatistics> CREATOR = new Parcelable.Creator<JdtsChannelStatistics>() {
+        public JdtsChannelStatistics createFromParcel(Parcel in) {
+            return new JdtsChannelStatistics(in);
+        }
+
+        public JdtsChannelStatistics[] newArray(int size) {
+            return new JdtsChannelStatistics[size];
+        }
+    };
+
+    public JdtsChannelStatistics() {
+    }
+
+    private JdtsChannelStatistics(Parcel in) {
+        channel = in.readInt();
+        windowMs = in.readInt();
+        count = in.readInt();
+        spanMs = in.readInt();
+        mean = in.readFloat();
+        stddev = in.readFloat();
+        min = in.readInt();
+        max = in.readInt();
+        slope = in.readFloat();
+    }
+
+    @Override
+    public void writeToParcel(Parcel out, int flags) {
+        out.writeInt(channel);
+        out.writeInt(windowMs);
+        out.writeInt(count);
+        out.writeInt(spanMs);
+        out.writeFloat(mean);
+        out.writeFloat(stddev);
+        out.writeInt(min);
+        out.writeInt(max);
+        out.writeFloat(slope);
+    }
+
+    @Override
+    public int describeContents() {
+        return 0;
+    }
+}
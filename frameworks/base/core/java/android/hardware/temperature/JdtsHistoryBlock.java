@@ -0,0 +1,104 @@
+package android.hardware.temperature;
+
+import android.os.Parcel;
+import android.os.Parcelable;
+
+/**
+ * Samples of the long-term history, see JdtsManager.queryHistory(), in sequence order.
+ * Only the calibrated temperatures are kept there, in 0.01C like JdtsTemperatureData,
+ * with the wall clock time of their read.
+ *
+ * {@hide}
+ */
+public final class JdtsHistoryBlock implements Parcelable {
+    private final int mCount;
+    private final long[] mSequences;
+    private final long[] mTimesMs;
+    // JdtsTemperatureData.CHANNEL_COUNT per sample
+    private final int[] mTemperatures;
+
+    public static final Parcelable.Creator<JdtsHistoryBlock> CREATOR = new Parcelable.Creator<JdtsHistoryBlock>() {
+        public JdtsHistoryBlock createFromParcel(Parcel in) {
+            int count = in.readInt();
+            return new JdtsHistoryBlock(in.createLongArray(), in.createLongArray(), in.createIntArray(), count);
+        }
+
+        public JdtsHistoryBlock[] newArray(int size) {
+            return new JdtsHistoryBlock[size];
+        }
+    };
+
+    /**
+     * Wraps the first 'count' samples of the arrays, which are not copied.
+     */
+    public JdtsHistoryBlock(long[] sequences, long[] timesMs, int[] temperatures, int count) {
+        if (count < 0 || sequences.length < count || timesMs.length < count ||
+                temperatures.length < count * JdtsTemperatureData.CHANNEL_COUNT) {
+            throw new IllegalArgumentException("invalid sample count");
+        }
+        mCount = count;
+        mSequences = sequences;
+        mTimesMs = timesMs;
+        mTemperatures = temperatures;
+    }
+
+    public int getCount() {
+        return mCount;
+    }
+
+    /**
+     * The sequence of the sample at 'index', it keeps counting across reboots.
+     */
+    public long getSequence(int index) {
+        checkIndex(index);
+        return mSequences[index];
+    }
+
+    /**
+     * The wall clock time of the sample at 'index', in ms since the epoch.
+     */
+    public long getTimeMs(int index) {
+        checkIndex(index);
+        return mTimesMs[index];
+    }
+
+    /**
+     * The temperature of 'channel' (JdtsTemperatureData.CHANNEL_*) in the sample at 'index'.
+     */
+    public int getTemperature(int index, int channel) {
+        checkIndex(index);
+        if (channel < 0 || channel >= JdtsTemperatureData.CHANNEL_COUNT) {
+            throw new IllegalArgumentException("invalid channel");
+        }
+        return mTemperatures[index * JdtsTemperatureData.CHANNEL_COUNT + channel];
+    }
+
+    private void checkIndex(int index) {
+        if (index < 0 || index >= mCount) {
+            throw new IndexOutOfBoundsException("no sample " + index);
+        }
+    }
+
+    @Override
+    public void writeToParcel(Parcel out, int flags) {
+        out.writeInt(mCount);
+        // the arrays may be longer than the samples they hold
+        out.writeInt(mCount);
+        for (int i = 0; i < mCount; i++) {
+            out.writeLong(mSequences[i]);
+        }
+        out.writeInt(mCount);
+        for (int i = 0; i < mCount; i++) {
+            out.writeLong(mTimesMs[i]);
+        }
+        out.writeInt(mCount * JdtsTemperatureData.CHANNEL_COUNT);
+        for (int i = 0; i < mCount * JdtsTemperatureData.CHANNEL_COUNT; i++) {
+            out.writeInt(mTemperatures[i]);
+        }
+    }
+
+    @Override
+    public int describeContents() {
+        return 0;
+    }
+}
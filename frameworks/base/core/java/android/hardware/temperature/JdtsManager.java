@@ -1,11 +1,68 @@
 package android.hardware.temperature;
 
+import android.os.Binder;
+import android.os.Handler;
+import android.os.IBinder;
+import android.os.Looper;
+import android.os.ParcelFileDescriptor;
 import android.os.RemoteException;
+import android.hardware.temperature.IJdtsListener;
 import android.hardware.temperature.IJdtsService;
 
+import java.io.IOException;
+import java.util.HashMap;
+
 /** {@hide} */
 public class JdtsManager
 {
+    /**
+     * Receives the samples pushed by the service, see {@link #registerListener}.
+     */
+    public interface SampleListener {
+        void onSamples(JdtsTemperatureData[] samples);
+    }
+
+    /**
+     * A SampleListener also implementing this gets the detector alerts as soon as they
+     * are raised, ahead of the batched samples. 'alerts' are the JdtsTemperatureData.FLAG_*
+     * that 'sample' raised and the one before it did not have.
+     */
+    public interface AlertListener {
+        void onAlert(JdtsTemperatureData sample, int alerts);
+    }
+
+    // forwards the oneway Binder callbacks to the listener's handler
+    private static final class ListenerTransport extends IJdtsListener.Stub {
+        private final SampleListener mListener;
+        private final Handler mHandler;
+
+        ListenerTransport(SampleListener listener, Handler handler) {
+            mListener = listener;
+            mHandler = handler;
+        }
+
+        @Override
+        public void onSamples(final JdtsTemperatureData[] samples) {
+            mHandler.post(new Runnable() {
+                public void run() {
+                    mListener.onSamples(samples);
+                }
+            });
+        }
+
+        @Override
+        public void onAlert(final JdtsTemperatureData sample, final int alerts) {
+            if (!(mListener instanceof AlertListener)) {
+                return;
+            }
+            mHandler.post(new Runnable() {
+                public void run() {
+                    ((AlertListener) mListener).onAlert(sample, alerts);
+                }
+            });
+        }
+    }
+
     public JdtsTemperatureData readSample() {
 		try {
 		    return mService.readSample();
@@ -14,25 +71,241 @@ public class JdtsManager
 		}
     }
 
+    /**
+     * Returns a sample taken no more than maxAgeMs ago, served from the service's cache
+     * when it has one. Concurrent callers share a single device read.
+     */
+    public JdtsTemperatureData readCachedSample(int maxAgeMs) {
+		try {
+		    return mService.readCachedSample(maxAgeMs);
+		} catch (RemoteException e) {
+		    return null;
+		}
+    }
+
+    /**
+     * Catches up on the samples following sinceSequence (-1 for all the service holds),
+     * at most maxCount of them in one call. Returns null on failure.
+     */
+    public JdtsSampleBlock readSamples(long sinceSequence, int maxCount) {
+		try {
+		    return mService.readSamples(sinceSequence, maxCount);
+		} catch (RemoteException e) {
+		    return null;
+		}
+    }
+
+    /**
+     * Returns the mean, standard deviation, min, max and trend of a channel
+     * (JdtsTemperatureData.CHANNEL_*, CHANNEL_COMPENSATED_OBJECT included) over the last
+     * windowMs, up to an hour, computed by the service as samples arrive. Returns null
+     * on failure.
+     */
+    public JdtsChannelStatistics getStatistics(int channel, int windowMs) {
+		try {
+		    return mService.getStatistics(channel, windowMs);
+		} catch (RemoteException e) {
+		    return null;
+		}
+    }
+
+    /**
+     * Returns the samples of the long-term history taken between fromMs (included) and
+     * toMs (excluded), wall clock ms, oldest first and at most maxCount of them. The
+     * history survives reboots, it goes back as far as the storage set aside for it.
+     * A block holding maxCount samples may not be the whole range: continue from the
+     * time of its last sample, skipping the sequences already seen. Returns null on
+     * failure or when the history is off.
+     */
+    public JdtsHistoryBlock queryHistory(long fromMs, long toMs, int maxCount) {
+		try {
+		    return mService.queryHistory(fromMs, toMs, maxCount);
+		} catch (RemoteException e) {
+		    return null;
+		}
+    }
+
+    /**
+     * Returns the min, max and mean of every channel over the buckets of resolutionMs
+     * between fromMs and toMs (wall clock ms), oldest first and at most maxCount of them.
+     * The resolution is rounded down to a whole number of 1 s, 1 min or 1 h buckets,
+     * those without samples are left out. Cheap whatever the range, they are kept up to
+     * date as samples arrive.
+     * Returns null on failure or when the history is off.
+     */
+    public JdtsRollup[] queryRollups(long fromMs, long toMs, long resolutionMs, int maxCount) {
+		try {
+		    return mService.queryRollups(fromMs, toMs, resolutionMs, maxCount);
+		} catch (RemoteException e) {
+		    return null;
+		}
+    }
+
+    /**
+     * Sets the filter the HAL runs a channel (JdtsTemperatureData.CHANNEL_*) through, its
+     * output is in the filtered* fields of every sample. The filter is shared by all the
+     * clients, setting it needs android.permission.HARDWARE_TEST; an application smoothing
+     * for itself does it on its own samples. type is JdtsTemperatureData.FILTER_*:
+     * FILTER_EWMA takes alpha, the weight of a new sample, FILTER_KALMAN takes the
+     * per-sample process noise and the measurement noise as variances in (0.01C)^2.
+     * Returns false if the filter is invalid or the permission is missing.
+     */
+    public boolean setFilter(int channel, int type, float alpha, float processNoise, float measurementNoise) {
+		try {
+		    return mService.setFilter(channel, type, alpha, processNoise, measurementNoise);
+		} catch (RemoteException e) {
+		    return false;
+		}
+    }
+
+    /**
+     * Asks for the sensor to be powered or not. The service weighs the requests of all
+     * its clients: it stays powered while anybody needs it, whatever this one asks.
+     */
     public boolean activate(boolean enabled) {
 		try {
-		    return mService.activate(enabled);
+		    return mService.activate(mToken, enabled);
 		} catch (RemoteException e) {
 		    return false;
 		}
     }
 
+    /**
+     * Asks for continuous (true) or burst mode. Continuous mode wins while any client
+     * asks for it or reads fast, the requests of a client end with its process.
+     */
     public boolean setMode(boolean is_continuous) {
 		try {
-		    return mService.setMode(is_continuous);
+		    return mService.setMode(mToken, is_continuous);
 		} catch (RemoteException e) {
 		    return false;
 		}
     }
 
+    /**
+     * Withdraws what this client asked for with activate() and setMode(), leaving the
+     * sensor to the other clients. A client done with the sensor calls it rather than
+     * wait for its process to end.
+     */
+    public void releaseVotes() {
+		try {
+		    mService.releaseVotes(mToken);
+		} catch (RemoteException e) {
+		}
+    }
+
+    /**
+     * Starts delivering samples to 'listener' on the thread of 'handler', at most one
+     * per samplingPeriodUs (0 for every sample) and batched for up to maxReportLatencyUs
+     * (0 to deliver as soon as they arrive). With 'average' each sample carries the mean
+     * temperatures of its period instead of being one picked from it. A single reader in
+     * the service feeds all listeners, in burst mode at the pace of the fastest one.
+     * Registering the same listener again updates its rates.
+     *
+     * With a changeThreshold (0.01C) a sample is delivered only when a channel has moved
+     * by at least that much since the last delivered one, or when heartbeatMs have passed
+     * (0 for no heartbeat). A steady temperature then costs no callbacks. The service
+     * checks this as samples arrive, so a heartbeat can be late by a sensor period.
+     */
+    public boolean registerListener(SampleListener listener, int samplingPeriodUs,
+            int maxReportLatencyUs, boolean average, int changeThreshold, int heartbeatMs,
+            Handler handler) {
+        ListenerTransport transport;
+        synchronized (mListeners) {
+            transport = mListeners.get(listener);
+            if (transport == null) {
+                transport = new ListenerTransport(listener,
+                        handler != null ? handler : new Handler(Looper.getMainLooper()));
+                mListeners.put(listener, transport);
+            }
+        }
+
+		try {
+		    return mService.registerListener(transport, samplingPeriodUs, maxReportLatencyUs, average,
+		            changeThreshold, heartbeatMs);
+		} catch (RemoteException e) {
+		    return false;
+		}
+    }
+
+    public boolean registerListener(SampleListener listener, int samplingPeriodUs,
+            int maxReportLatencyUs, Handler handler) {
+        return registerListener(listener, samplingPeriodUs, maxReportLatencyUs, false, 0, 0, handler);
+    }
+
+    public boolean registerListener(SampleListener listener, int samplingPeriodUs, int maxReportLatencyUs) {
+        return registerListener(listener, samplingPeriodUs, maxReportLatencyUs, false, 0, 0, null);
+    }
+
+    public void unregisterListener(SampleListener listener) {
+        ListenerTransport transport;
+        synchronized (mListeners) {
+            transport = mListeners.remove(listener);
+        }
+        if (transport == null) {
+            return;
+        }
+
+		try {
+		    mService.unregisterListener(transport);
+		} catch (RemoteException e) {
+		}
+    }
+
+    /**
+     * Maps the service's shared sample region, for clients polling the current value
+     * often (a UI at 60 Hz) without a Binder call per read. The service keeps the region
+     * up to date until the returned object is closed. Returns null if it is not available.
+     */
+    public JdtsSharedMemory openSharedMemory() {
+        // identifies this client to the service, which drops it if the process dies
+        Binder token = new Binder();
+        ParcelFileDescriptor fd;
+
+		try {
+		    fd = mService.openSharedMemory(token);
+		} catch (RemoteException e) {
+		    return null;
+		}
+        if (fd == null) {
+            return null;
+        }
+
+        try {
+            return new JdtsSharedMemory(mService, token, fd);
+        } catch (IOException e) {
+            try {
+                mService.closeSharedMemory(token);
+            } catch (RemoteException re) {
+            }
+            return null;
+        }
+    }
+
+    /**
+     * Opens a stream of every sample (samplingPeriodUs 0) or one per samplingPeriodUs,
+     * for loggers reading in bulk. The pipe carries JdtsTemperatureData.RECORD_SIZE byte
+     * records in native byte order, read them with JdtsTemperatureData.readFromRecord()
+     * from a buffer ordered with ByteOrder.nativeOrder(). Closing the descriptor ends the
+     * stream. Returns null if it cannot be opened.
+     */
+    public ParcelFileDescriptor openStream(int samplingPeriodUs) {
+		try {
+		    return mService.openStream(samplingPeriodUs);
+		} catch (RemoteException e) {
+		    return null;
+		}
+    }
+
     public JdtsManager(IJdtsService service) {
         mService = service;
     }
 
     IJdtsService mService;
+
+    // identifies the power and mode requests of this manager to the service
+    private final IBinder mToken = new Binder();
+
+    private final HashMap<SampleListener, ListenerTransport> mListeners =
+            new HashMap<SampleListener, ListenerTransport>();
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+package android.hardware.temperature;
+
+import android.os.Parcel;
+import android.os.Parcelable;
+
+/**
+ * Aggregate of the long-term history over one bucket of time, see
+ * JdtsManager.queryRollups(). Temperatures are in 0.01C like JdtsTemperatureData,
+ * indexed by JdtsTemperatureData.CHANNEL_*.
+ *
+ * {@hide}
+ */
+public final class JdtsRollup implements Parcelable {
+    // the samples taken from startMs (wall clock) and for durationMs
+    public long startMs;
+    public long durationMs;
+    public int count;
+    public final int[] min = new int[JdtsTemperatureData.CHANNEL_COUNT];
+    public final int[] max = new int[JdtsTemperatureData.CHANNEL_COUNT];
+    public final float[] mean = new float[JdtsTemperatureData.CHANNEL_COUNT];
+
+    public static final Parcelable.Creator<JdtsRollup> CREATOR = new Parcelable.Creator<JdtsRollup>() {
+        public JdtsRollup createFromParcel(Parcel in) {
+            return new JdtsRollup(in);
+        }
+
+        public JdtsRollup[] newArray(int size) {
+            return new JdtsRollup[size];
+        }
+    };
+
+    public JdtsRollup() {
+    }
+
+    private JdtsRollup(Parcel in) {
+        startMs = in.readLong();
+        durationMs = in.readLong();
+        count = in.readInt();
+        for (int ch = 0; ch < JdtsTemperatureData.CHANNEL_COUNT; ch++) {
+            min[ch] = in.readInt();
+            max[ch] = in.readInt();
+            mean[ch] = in.readFloat();
+        }
+    }
+
+    @Override
+    public void writeToParcel(Parcel out, int flags) {
+        out.writeLong(startMs);
+        out.writeLong(durationMs);
+        out.writeInt(count);
+        for (int ch = 0; ch < JdtsTemperatureData.CHANNEL_COUNT; ch++) {
+            out.writeInt(min[ch]);
+            out.writeInt(max[ch]);
+            out.writeFloat(mean[ch]);
+        }
+    }
+
+    @Override
+    public int describeContents() {
+        return 0;
+    }
+}
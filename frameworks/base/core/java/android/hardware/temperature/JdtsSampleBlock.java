@@ -0,0 +1,78 @@
+package android.hardware.temperature;
+
+import android.os.Parcel;
+import android.os.Parcelable;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+/**
+ * A run of consecutive samples sent as one byte array of packed records
+ * (JdtsTemperatureData.RECORD_*, native byte order) instead of an object per sample.
+ *
+ * {@hide}
+ */
+public final class JdtsSampleBlock implements Parcelable {
+    private final int mCount;
+    private final byte[] mRecords;
+    private final ByteBuffer mBuffer;
+
+    public static final Parcelable.Creator<JdtsSampleBlock> CREATOR = new Parcelable.Creator<JdtsSampleBlock>() {
+        public JdtsSampleBlock createFromParcel(Parcel in) {
+            int count = in.readInt();
+            return new JdtsSampleBlock(in.createByteArray(), count);
+        }
+
+        public JdtsSampleBlock[] newArray(int size) {
+            return new JdtsSampleBlock[size];
+        }
+    };
+
+    /**
+     * Wraps the first 'count' records of 'records', which is not copied.
+     */
+    public JdtsSampleBlock(byte[] records, int count) {
+        if (count < 0 || records.length < count * JdtsTemperatureData.RECORD_SIZE) {
+            throw new IllegalArgumentException("invalid record count");
+        }
+        mCount = count;
+        mRecords = records;
+        mBuffer = ByteBuffer.wrap(records).order(ByteOrder.nativeOrder());
+    }
+
+    public int getCount() {
+        return mCount;
+    }
+
+    /**
+     * Unpacks the sample at 'index' into 'data', so running over a block allocates nothing.
+     */
+    public void get(int index, JdtsTemperatureData data) {
+        if (index < 0 || index >= mCount) {
+            throw new IndexOutOfBoundsException("no sample " + index);
+        }
+        data.readFromRecord(mBuffer, index * JdtsTemperatureData.RECORD_SIZE);
+    }
+
+    /**
+     * The sequence of the last sample, the one to continue from; -1 for an empty block.
+     */
+    public long getLastSequence() {
+        if (mCount == 0) {
+            return -1;
+        }
+        return mBuffer.getLong((mCount - 1) * JdtsTemperatureData.RECORD_SIZE
+                + JdtsTemperatureData.RECORD_SEQUENCE);
+    }
+
+    @Override
+    public void writeToParcel(Parcel out, int flags) {
+        out.writeInt(mCount);
+        out.writeByteArray(mRecords, 0, mCount * JdtsTemperatureData.RECORD_SIZE);
+    }
+
+    @Override
+    public int describeContents() {
+        return 0;
+    }
+}
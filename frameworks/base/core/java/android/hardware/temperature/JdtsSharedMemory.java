@@ -0,0 +1,90 @@
+package android.hardware.temperature;
+
+import android.os.IBinder;
+import android.os.ParcelFileDescriptor;
+import android.os.RemoteException;
+import android.util.Log;
+
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+/**
+ * The read-only shared memory region of the temperature service, see
+ * {@link JdtsManager#openSharedMemory}. It holds the latest sample and a ring of the
+ * recent ones, reading them is a memory copy with no IPC. The service keeps publishing
+ * samples until {@link #close} is called.
+ *
+ * {@hide}
+ */
+public final class JdtsSharedMemory {
+    private static final String TAG = "TECHARTMS_JDTS";
+
+    // records kept in the ring, see TECHART_MS_JDTS_SHM_RING_SIZE
+    public static final int RING_SIZE = 1024;
+
+    static {
+        System.loadLibrary("jdts_jni");
+    }
+
+    private final IJdtsService mService;
+    private final IBinder mToken;
+    private long mNativePointer;
+
+    JdtsSharedMemory(IJdtsService service, IBinder token, ParcelFileDescriptor fd) throws IOException {
+        mService = service;
+        mToken = token;
+        try {
+            // the mapping keeps the region alive, the fd is not needed past this
+            mNativePointer = map_native(fd.getFileDescriptor());
+        } finally {
+            fd.close();
+        }
+        if (mNativePointer == 0) {
+            throw new IOException("cannot map the shared sample region");
+        }
+    }
+
+    /**
+     * Copies the latest sample into 'data', false if the region is closed or holds no
+     * sample yet.
+     */
+    public synchronized boolean readLatest(JdtsTemperatureData data) {
+        return read_latest_native(mNativePointer, data);
+    }
+
+    /**
+     * Copies up to maxCount of the most recent samples, oldest first, into a direct
+     * buffer allocated with ByteOrder.nativeOrder(), packed as JdtsTemperatureData.RECORD_*
+     * from its start. Returns the number of records.
+     */
+    public synchronized int readRecent(ByteBuffer buffer, int maxCount) {
+        return read_recent_native(mNativePointer, buffer, maxCount);
+    }
+
+    public void close() {
+        synchronized (this) {
+            if (mNativePointer == 0) {
+                return;
+            }
+            unmap_native(mNativePointer);
+            mNativePointer = 0;
+        }
+
+		try {
+		    mService.closeSharedMemory(mToken);
+		} catch (RemoteException e) {
+		    Log.w(TAG, "cannot release the shared memory", e);
+		}
+    }
+
+    protected void finalize() throws Throwable {
+        close();
+        super.finalize();
+    }
+
+    private static native long map_native(FileDescriptor fd);
+    private static native void unmap_native(long ptr);
+    private static native boolean read_latest_native(long ptr, JdtsTemperatureData data);
+    private static native int read_recent_native(long ptr, ByteBuffer buffer, int maxCount);
+}
@@ -3,13 +3,67 @@ package android.hardware.temperature;
 import android.os.Parcel;
 import android.os.Parcelable;
 
+import java.nio.ByteBuffer;
+
 /** {@hide} */
 public final class JdtsTemperatureData implements Parcelable {
+    // a sample packed into a byte buffer, native byte order, see
+    // techartms_jdts_record_t in hardware/sensor_jdts_temperature.h
+    public static final int RECORD_SIZE = 40;
+    public static final int RECORD_SEQUENCE = 0;
+    public static final int RECORD_TIMESTAMP = 8;
+    public static final int RECORD_SYNCHRO = 16;
+    public static final int RECORD_FLAGS = 18;
+    public static final int RECORD_OBJECT = 20;
+    public static final int RECORD_NTC1 = 22;
+    public static final int RECORD_NTC2 = 24;
+    public static final int RECORD_NTC3 = 26;
+    public static final int RECORD_FILTERED_OBJECT = 28;
+    public static final int RECORD_FILTERED_NTC1 = 30;
+    public static final int RECORD_FILTERED_NTC2 = 32;
+    public static final int RECORD_FILTERED_NTC3 = 34;
+    public static final int RECORD_COMPENSATED_OBJECT = 36;
+
+    // the temperature channels, as TECHART_MS_JDTS_CHANNEL_* in the HAL
+    public static final int CHANNEL_OBJECT = 0;
+    public static final int CHANNEL_NTC1 = 1;
+    public static final int CHANNEL_NTC2 = 2;
+    public static final int CHANNEL_NTC3 = 3;
+    public static final int CHANNEL_COUNT = 4;
+    // derived by the HAL from the others, see compensatedObjectTemperature
+    public static final int CHANNEL_COMPENSATED_OBJECT = 4;
+
+    // raised by the HAL detector on the sample that trips them, TECHART_MS_JDTS_FLAG_*
+    public static final int FLAG_RISE = 0x0001;
+    public static final int FLAG_FALL = 0x0002;
+    public static final int FLAG_OUTLIER = 0x0004;
+    public static final int FLAG_STUCK = 0x0008;
+    public static final int FLAG_NTC_MISMATCH = 0x0010;
+
+    // the filter stage of the HAL, see JdtsManager.setFilter()
+    public static final int FILTER_NONE = 0;
+    public static final int FILTER_EWMA = 1;
+    public static final int FILTER_KALMAN = 2;
+
+    // counts samples since the service started, unlike synchro it does not wrap
+    public long sequence;
+    // CLOCK_MONOTONIC, the System.nanoTime() base
+    public long timestampNanos;
 	public int synchro;
+    // FLAG_*
+    public int flags;
     public int objectTemperature;
     public int ntc1Temperature;
     public int ntc2Temperature;
     public int ntc3Temperature;
+    // the same through the channel's filter, equal to them on an unfiltered channel
+    public int filteredObjectTemperature;
+    public int filteredNtc1Temperature;
+    public int filteredNtc2Temperature;
+    public int filteredNtc3Temperature;
+    // the object temperature corrected for the sensor body temperature the NTCs measure,
+    // by the model in /data/calibration/jdts_compensation.conf; objectTemperature without one
+    public int compensatedObjectTemperature;
 
     public static final Parcelable.Creator<JdtsTemperatureData> CREATOR = new Parcelable.Creator<JdtsTemperatureData>() {
         public JdtsTemperatureData createFromParcel(Parcel in) {
@@ -29,20 +83,104 @@ public final class JdtsTemperatureData implements Parcelable {
     }
 
     @Override
-    public void writeToParcel(Parcel out, int flags) {
+    public void writeToParcel(Parcel out, int parcelableFlags) {
+        out.writeLong(sequence);
+        out.writeLong(timestampNanos);
         out.writeInt(synchro);
+        out.writeInt(flags);
         out.writeInt(objectTemperature);
         out.writeInt(ntc1Temperature);
         out.writeInt(ntc2Temperature);
         out.writeInt(ntc3Temperature);
+        out.writeInt(filteredObjectTemperature);
+        out.writeInt(filteredNtc1Temperature);
+        out.writeInt(filteredNtc2Temperature);
+        out.writeInt(filteredNtc3Temperature);
+        out.writeInt(compensatedObjectTemperature);
     }
 
     public void readFromParcel(Parcel in) {
+        sequence = in.readLong();
+        timestampNanos = in.readLong();
         synchro = in.readInt();
+        flags = in.readInt();
         objectTemperature = in.readInt();
         ntc1Temperature = in.readInt();
         ntc2Temperature = in.readInt();
         ntc3Temperature = in.readInt();
+        filteredObjectTemperature = in.readInt();
+        filteredNtc1Temperature = in.readInt();
+        filteredNtc2Temperature = in.readInt();
+        filteredNtc3Temperature = in.readInt();
+        compensatedObjectTemperature = in.readInt();
+    }
+
+    public void copyFrom(JdtsTemperatureData other) {
+        sequence = other.sequence;
+        timestampNanos = other.timestampNanos;
+        synchro = other.synchro;
+        flags = other.flags;
+        objectTemperature = other.objectTemperature;
+        ntc1Temperature = other.ntc1Temperature;
+        ntc2Temperature = other.ntc2Temperature;
+        ntc3Temperature = other.ntc3Temperature;
+        filteredObjectTemperature = other.filteredObjectTemperature;
+        filteredNtc1Temperature = other.filteredNtc1Temperature;
+        filteredNtc2Temperature = other.filteredNtc2Temperature;
+        filteredNtc3Temperature = other.filteredNtc3Temperature;
+        compensatedObjectTemperature = other.compensatedObjectTemperature;
+    }
+
+    /**
+     * Fills this object from the record at 'offset' of a buffer in native byte order.
+     */
+    public void readFromRecord(ByteBuffer buffer, int offset) {
+        sequence = buffer.getLong(offset + RECORD_SEQUENCE);
+        timestampNanos = buffer.getLong(offset + RECORD_TIMESTAMP);
+        synchro = buffer.getShort(offset + RECORD_SYNCHRO) & 0xffff;
+        flags = buffer.getShort(offset + RECORD_FLAGS) & 0xffff;
+        objectTemperature = buffer.getShort(offset + RECORD_OBJECT);
+        ntc1Temperature = buffer.getShort(offset + RECORD_NTC1);
+        ntc2Temperature = buffer.getShort(offset + RECORD_NTC2);
+        ntc3Temperature = buffer.getShort(offset + RECORD_NTC3);
+        filteredObjectTemperature = buffer.getShort(offset + RECORD_FILTERED_OBJECT);
+        filteredNtc1Temperature = buffer.getShort(offset + RECORD_FILTERED_NTC1);
+        filteredNtc2Temperature = buffer.getShort(offset + RECORD_FILTERED_NTC2);
+        filteredNtc3Temperature = buffer.getShort(offset + RECORD_FILTERED_NTC3);
+        compensatedObjectTemperature = buffer.getShort(offset + RECORD_COMPENSATED_OBJECT);
+    }
+
+    /**
+     * Packs this object into the record at 'offset' of a buffer in native byte order.
+     */
+    public void writeToRecord(ByteBuffer buffer, int offset) {
+        buffer.putLong(offset + RECORD_SEQUENCE, sequence);
+        buffer.putLong(offset + RECORD_TIMESTAMP, timestampNanos);
+        buffer.putShort(offset + RECORD_SYNCHRO, (short) synchro);
+        buffer.putShort(offset + RECORD_FLAGS, (short) flags);
+        buffer.putShort(offset + RECORD_OBJECT, (short) objectTemperature);
+        buffer.putShort(offset + RECORD_NTC1, (short) ntc1Temperature);
+        buffer.putShort(offset + RECORD_NTC2, (short) ntc2Temperature);
+        buffer.putShort(offset + RECORD_NTC3, (short) ntc3Temperature);
+        buffer.putShort(offset + RECORD_FILTERED_OBJECT, (short) filteredObjectTemperature);
+        buffer.putShort(offset + RECORD_FILTERED_NTC1, (short) filteredNtc1Temperature);
+        buffer.putShort(offset + RECORD_FILTERED_NTC2, (short) filteredNtc2Temperature);
+        buffer.putShort(offset + RECORD_FILTERED_NTC3, (short) filteredNtc3Temperature);
+        buffer.putShort(offset + RECORD_COMPENSATED_OBJECT, (short) compensatedObjectTemperature);
+        buffer.putShort(offset + RECORD_COMPENSATED_OBJECT + 2, (short) 0);
+    }
+
+    /**
+     * FLAG_* as text, for logs.
+     */
+    public static String flagsToString(int flags) {
+        StringBuilder sb = new StringBuilder();
+        if ((flags & FLAG_RISE) != 0) sb.append("rise ");
+        if ((flags & FLAG_FALL) != 0) sb.append("fall ");
+        if ((flags & FLAG_OUTLIER) != 0) sb.append("outlier ");
+        if ((flags & FLAG_STUCK) != 0) sb.append("stuck ");
+        if ((flags & FLAG_NTC_MISMATCH) != 0) sb.append("ntc-mismatch ");
+        return sb.length() > 0 ? sb.substring(0, sb.length() - 1) : "none";
     }
 
     @Override
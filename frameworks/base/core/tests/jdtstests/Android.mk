@@ -0,0 +1,12 @@
+LOCAL_PATH := $(call my-dir)
+include $(CLEAR_VARS)
+
+# the parcels and records of android.hardware.temperature, run with
+# adb shell am instrument -w com.android.jdtstests/android.test.InstrumentationTestRunner
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := $(call all-java-files-under, src)
+LOCAL_JAVA_LIBRARIES := android.test.runner
+LOCAL_PACKAGE_NAME := JdtsTests
+LOCAL_CERTIFICATE := platform
+
+include $(BUILD_PACKAGE)
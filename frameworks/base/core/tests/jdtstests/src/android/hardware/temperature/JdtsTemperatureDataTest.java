@@ -0,0 +1,91 @@
+package android.hardware.temperature;
+
+import android.os.Parcel;
+import android.os.Parcelable;
+import android.test.suitebuilder.annotation.SmallTest;
+
+import junit.framework.TestCase;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+public class JdtsTemperatureDataTest extends TestCase {
+
+    private static JdtsTemperatureData sample() {
+        JdtsTemperatureData data = new JdtsTemperatureData();
+        data.sequence = 0x123456789aL;
+        data.timestampNanos = 987654321012L;
+        data.synchro = 0xfffe;
+        // not FLAG_RISE, the value PARCELABLE_WRITE_RETURN_VALUE would decode as
+        data.flags = JdtsTemperatureData.FLAG_FALL | JdtsTemperatureData.FLAG_NTC_MISMATCH;
+        data.objectTemperature = 3712;
+        data.ntc1Temperature = 2501;
+        data.ntc2Temperature = -1234;
+        data.ntc3Temperature = 2499;
+        data.filteredObjectTemperature = 3700;
+        data.filteredNtc1Temperature = 2500;
+        data.filteredNtc2Temperature = -1230;
+        data.filteredNtc3Temperature = 2498;
+        data.compensatedObjectTemperature = 3650;
+        return data;
+    }
+
+    private static void assertSame(JdtsTemperatureData expected, JdtsTemperatureData actual) {
+        assertEquals(expected.sequence, actual.sequence);
+        assertEquals(expected.timestampNanos, actual.timestampNanos);
+        assertEquals(expected.synchro, actual.synchro);
+        assertEquals(expected.flags, actual.flags);
+        assertEquals(expected.objectTemperature, actual.objectTemperature);
+        assertEquals(expected.ntc1Temperature, actual.ntc1Temperature);
+        assertEquals(expected.ntc2Temperature, actual.ntc2Temperature);
+        assertEquals(expected.ntc3Temperature, actual.ntc3Temperature);
+        assertEquals(expected.filteredObjectTemperature, actual.filteredObjectTemperature);
+        assertEquals(expected.filteredNtc1Temperature, actual.filteredNtc1Temperature);
+        assertEquals(expected.filteredNtc2Temperature, actual.filteredNtc2Temperature);
+        assertEquals(expected.filteredNtc3Temperature, actual.filteredNtc3Temperature);
+        assertEquals(expected.compensatedObjectTemperature, actual.compensatedObjectTemperature);
+    }
+
+    private static JdtsTemperatureData roundTrip(JdtsTemperatureData data, int parcelableFlags) {
+        Parcel parcel = Parcel.obtain();
+        try {
+            data.writeToParcel(parcel, parcelableFlags);
+            parcel.setDataPosition(0);
+            return JdtsTemperatureData.CREATOR.createFromParcel(parcel);
+        } finally {
+            parcel.recycle();
+        }
+    }
+
+    @SmallTest
+    public void testParcelKeepsTheDetectorFlags() {
+        JdtsTemperatureData data = sample();
+        assertSame(data, roundTrip(data, 0));
+    }
+
+    @SmallTest
+    public void testParcelOfAReturnValueKeepsTheDetectorFlags() {
+        // how readSample() hands its sample back across binder
+        JdtsTemperatureData data = sample();
+        assertSame(data, roundTrip(data, Parcelable.PARCELABLE_WRITE_RETURN_VALUE));
+    }
+
+    @SmallTest
+    public void testParcelWithoutFlags() {
+        JdtsTemperatureData data = sample();
+        data.flags = 0;
+        assertSame(data, roundTrip(data, Parcelable.PARCELABLE_WRITE_RETURN_VALUE));
+    }
+
+    @SmallTest
+    public void testRecordRoundTrip() {
+        JdtsTemperatureData data = sample();
+        ByteBuffer buffer = ByteBuffer.allocate(2 * JdtsTemperatureData.RECORD_SIZE)
+                .order(ByteOrder.nativeOrder());
+        data.writeToRecord(buffer, JdtsTemperatureData.RECORD_SIZE);
+
+        JdtsTemperatureData read = new JdtsTemperatureData();
+        read.readFromRecord(buffer, JdtsTemperatureData.RECORD_SIZE);
+        assertSame(data, read);
+    }
+}
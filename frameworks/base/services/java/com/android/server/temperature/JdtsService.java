@@ -1,48 +1,1200 @@
 package com.android.server.temperature;
 
+import android.Manifest;
+import android.content.BroadcastReceiver;
 import android.content.Context;
+import android.content.Intent;
+import android.content.IntentFilter;
+import android.content.pm.PackageManager;
+import android.os.Binder;
 import android.os.Handler;
+import android.os.IBinder;
 import android.os.Looper;
 import android.os.Message;
+import android.os.ParcelFileDescriptor;
 import android.os.Process;
+import android.os.RemoteException;
+import android.os.SystemClock;
 import android.util.Log;
 
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.io.PrintWriter;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.Iterator;
+
+import android.hardware.temperature.IJdtsListener;
 import android.hardware.temperature.IJdtsService;
+import android.hardware.temperature.JdtsChannelStatistics;
+import android.hardware.temperature.JdtsHistoryBlock;
+import android.hardware.temperature.JdtsRollup;
+import android.hardware.temperature.JdtsSampleBlock;
 import android.hardware.temperature.JdtsTemperatureData;
 
 public class JdtsService extends IJdtsService.Stub {
     private static final String TAG = "TECHARTMS_JDTS";
 
+    // samples and rollups a query returns at most, bounding the size of the reply
+    private static final int MAX_HISTORY_QUERY = 4096;
+    private static final int MAX_ROLLUP_QUERY = 1024;
+
+    // layout of the arrays filled by query_rollups_native(), per rollup, see the JNI part
+    private static final int ROLLUP_START_MS = 0;
+    private static final int ROLLUP_DURATION_MS = 1;
+    private static final int ROLLUP_TIMES = 2;
+    private static final int ROLLUP_COUNT = 0;
+    private static final int ROLLUP_MIN = 1;
+    private static final int ROLLUP_MAX = ROLLUP_MIN + JdtsTemperatureData.CHANNEL_COUNT;
+    private static final int ROLLUP_VALUES = ROLLUP_MAX + JdtsTemperatureData.CHANNEL_COUNT;
+
+    // records per onSamples() call, the native reader reads up to this many at once
+    private static final int READER_BATCH = 64;
+
+    private final Context mContext;
     private long mNativePointer;
 
+    // a listener gets its batch once it holds this many samples, whatever its latency
+    private static final int MAX_LISTENER_BATCH = 256;
+
+    // samples kept for readSamples(), a power of two
+    private static final int HISTORY_SIZE = 4096;
+
+    // clients wanting samples more often than this get continuous mode, burst mode
+    // powers the sensor up for about 250 ms on every single sample read
+    private static final int CONTINUOUS_PERIOD_US = 1000000;
+
+    // layout of the long[] filled by get_read_stats_native(), see the JNI part
+    private static final int READ_STAT_READS = 0;
+    private static final int READ_STAT_ERRORS = 1;
+    private static final int READ_STAT_SAMPLES = 2;
+    private static final int READ_STAT_MAX_US = 3;
+    private static final int READ_STAT_COUNT = 4;
+
+    // windows getStatistics() keeps up to date at once, the least recently used goes first
+    private static final int MAX_STATISTICS_WINDOWS = 8;
+    private static final int MAX_STATISTICS_WINDOW_MS = 3600 * 1000;
+
+    // errors kept for dump()
+    private static final int RECENT_ERRORS = 16;
+
+    // the votes of a PowerClient
+    private static final int VOTE_NONE = 0;
+    private static final int VOTE_ON = 1;
+    private static final int VOTE_OFF = 2;
+
+    private final Object mLock = new Object();
+    // set while the native reader thread pushes samples into onSamples()
+    private boolean mReaderRunning;
+    // set once the device shuts down, the reader is closed and not started again
+    private boolean mShutdown;
+    // passed to every start of the reader, see updateReaderLocked()
+    private final ByteBuffer mReaderBuffer = ByteBuffer.allocateDirect(
+            READER_BATCH * JdtsTemperatureData.RECORD_SIZE).order(ByteOrder.nativeOrder());
+    // the latest sample, whether pushed by the reader or read on request
+    private boolean mHasLatest;
+    private final JdtsTemperatureData mLatest = new JdtsTemperatureData();
+    // set while a binder thread reads the device for everybody asking meanwhile
+    private boolean mReadInFlight;
+    private boolean mLastReadOk;
+    private int mReadGeneration;
+
+    // the last HISTORY_SIZE samples in sequence order, packed as JdtsTemperatureData.RECORD_*.
+    // Sample n of mHistoryCount is at record n % HISTORY_SIZE
+    private final byte[] mHistory = new byte[HISTORY_SIZE * JdtsTemperatureData.RECORD_SIZE];
+    private final ByteBuffer mHistoryBuffer = ByteBuffer.wrap(mHistory).order(ByteOrder.nativeOrder());
+    private long mHistoryCount;
+    // fed with every sample entering the history
+    private final ArrayList<WindowStatistics> mStatistics = new ArrayList<WindowStatistics>();
+
+    // the votes of this service, see updatePowerLocked(). The driver weighs them against
+    // those of the other processes having it open (jdtsd), it holds none for the service
+    // until the first is written, which the first update does for both
+    private boolean mPowered = false;
+    private boolean mContinuous = false;
+    private boolean mPowerVoted;
+    private boolean mModeVoted;
+    // the pace of the reader, see updatePowerLocked()
+    private int mReadPeriodUs;
+    // the activate() and setMode() requests, by client token
+    private final HashMap<IBinder, PowerClient> mPowerClients = new HashMap<IBinder, PowerClient>();
+
+    private final HashMap<IBinder, Listener> mListeners = new HashMap<IBinder, Listener>();
+    // clients of openSharedMemory(), the reader keeps the region fresh while there are any
+    private final HashMap<IBinder, SharedMemoryClient> mSharedMemoryClients =
+            new HashMap<IBinder, SharedMemoryClient>();
+    // set while the native reader writes into openStream() pipes, it drops a stream by
+    // itself once the client closes its end
+    private boolean mHasStreams;
+    // the shortest period asked for since the streams have been running
+    private int mMinStreamPeriodUs = Integer.MAX_VALUE;
+
+    // counters for dump(), the ones of the readSample() path are updated under mLock anyway
+    private long mCacheHits;
+    private long mCoalescedReads;
+    private long mDeviceReads;
+    private long mDeviceReadErrors;
+    private long mPowerErrors;
+    private long mDeliveryErrors;
+    private final String[] mRecentErrors = new String[RECENT_ERRORS];
+    private int mRecentErrorCount;
+    // the HAL filter of each channel as set by setFilter(), for dump(); null for none
+    private final String[] mFilters = new String[JdtsTemperatureData.CHANNEL_COUNT];
+    // the detector flags of the last sample seen, see checkAlertsLocked()
+    private int mAlertFlags;
+    private long mAlerts;
+    private JdtsTemperatureData mLastAlert;
+    private int mLastAlertFlags;
+    // how old the oldest sample of a batch is when it is sent to a listener
+    private final LatencyHistogram mDeliveryAge = new LatencyHistogram();
+    // how long the oneway onSamples() call takes to queue in the binder driver
+    private final LatencyHistogram mBinderCallTime = new LatencyHistogram();
+
+    // a client of registerListener(), fed from the one native reader
+    private final class Listener implements IBinder.DeathRecipient {
+        final IJdtsListener mListener;
+        final long mPeriodNanos;
+        final long mLatencyNanos;
+        // delivers the mean of the samples of each period rather than one of them
+        final boolean mAverage;
+        // with a threshold, a sample goes out only once a channel has moved by this much
+        // (0.01C) since the last one delivered, or after mHeartbeatNanos of silence
+        final int mChangeThreshold;
+        final long mHeartbeatNanos;
+        JdtsTemperatureData mLastDelivered;
+        // sums of the samples since the last one delivered, RECORD_OBJECT..RECORD_NTC3
+        // and RECORD_COMPENSATED_OBJECT
+        final long[] mSums = new long[5];
+        int mSummed;
+        final ArrayList<JdtsTemperatureData> mPending = new ArrayList<JdtsTemperatureData>();
+        long mPendingSince;
+        long mDelivered;
+        // left out by the decimation, or folded into a mean
+        long mSkipped;
+        // the next sample is taken once its timestamp reaches this
+        long mNextDueNanos = Long.MIN_VALUE;
+
+        Listener(IJdtsListener listener, int samplingPeriodUs, int maxReportLatencyUs, boolean average,
+                int changeThreshold, int heartbeatMs) {
+            mListener = listener;
+            mPeriodNanos = samplingPeriodUs * 1000L;
+            mLatencyNanos = maxReportLatencyUs * 1000L;
+            mAverage = average;
+            mChangeThreshold = changeThreshold;
+            mHeartbeatNanos = heartbeatMs * 1000000L;
+        }
+
+        // the change policy, applied to the samples the decimation has taken
+        boolean hasChanged(JdtsTemperatureData sample) {
+            JdtsTemperatureData last = mLastDelivered;
+            if (mChangeThreshold == 0 || last == null) {
+                return true;
+            }
+            if (mHeartbeatNanos > 0 && sample.timestampNanos - last.timestampNanos >= mHeartbeatNanos) {
+                return true;
+            }
+            return Math.abs(sample.objectTemperature - last.objectTemperature) >= mChangeThreshold ||
+                    Math.abs(sample.ntc1Temperature - last.ntc1Temperature) >= mChangeThreshold ||
+                    Math.abs(sample.ntc2Temperature - last.ntc2Temperature) >= mChangeThreshold ||
+                    Math.abs(sample.ntc3Temperature - last.ntc3Temperature) >= mChangeThreshold;
+        }
+
+        void accumulate(ByteBuffer buffer, int offset) {
+            mSums[0] += buffer.getShort(offset + JdtsTemperatureData.RECORD_OBJECT);
+            mSums[1] += buffer.getShort(offset + JdtsTemperatureData.RECORD_NTC1);
+            mSums[2] += buffer.getShort(offset + JdtsTemperatureData.RECORD_NTC2);
+            mSums[3] += buffer.getShort(offset + JdtsTemperatureData.RECORD_NTC3);
+            mSums[4] += buffer.getShort(offset + JdtsTemperatureData.RECORD_COMPENSATED_OBJECT);
+            mSummed++;
+        }
+
+        // the record at 'offset' with its temperatures replaced by the means, rounded
+        JdtsTemperatureData takeAverage(ByteBuffer buffer, int offset) {
+            JdtsTemperatureData data = new JdtsTemperatureData();
+            data.readFromRecord(buffer, offset);
+            data.objectTemperature = mean(0);
+            data.ntc1Temperature = mean(1);
+            data.ntc2Temperature = mean(2);
+            data.ntc3Temperature = mean(3);
+            data.compensatedObjectTemperature = mean(4);
+            for (int i = 0; i < mSums.length; i++) {
+                mSums[i] = 0;
+            }
+            mSummed = 0;
+            return data;
+        }
+
+        private int mean(int channel) {
+            long sum = mSums[channel];
+            return (int) ((sum >= 0 ? sum + mSummed / 2 : sum - mSummed / 2) / mSummed);
+        }
+
+        // decimates the sensor stream down to the client's period, by the rule of
+        // jdts_decimator_take() which the native streams use
+        boolean take(long timestampNanos) {
+            if (mNextDueNanos == Long.MIN_VALUE) {
+                mNextDueNanos = timestampNanos + mPeriodNanos;
+                return true;
+            }
+            if (timestampNanos < mNextDueNanos - mPeriodNanos / 4) {
+                return false;
+            }
+            mNextDueNanos = Math.max(mNextDueNanos + mPeriodNanos, timestampNanos);
+            return true;
+        }
+
+        @Override
+        public void binderDied() {
+            synchronized (mLock) {
+                removeListenerLocked(mListener.asBinder());
+            }
+        }
+    }
+
+    private final class SharedMemoryClient implements IBinder.DeathRecipient {
+        final IBinder mToken;
+
+        SharedMemoryClient(IBinder token) {
+            mToken = token;
+        }
+
+        @Override
+        public void binderDied() {
+            synchronized (mLock) {
+                removeSharedMemoryClientLocked(mToken);
+            }
+        }
+    }
+
+    // a client of activate() and setMode(), its requests go away with its process
+    private final class PowerClient implements IBinder.DeathRecipient {
+        final IBinder mToken;
+        int mPowerVote = VOTE_NONE;
+        int mModeVote = VOTE_NONE;
+
+        PowerClient(IBinder token) {
+            mToken = token;
+        }
+
+        @Override
+        public void binderDied() {
+            synchronized (mLock) {
+                if (mPowerClients.remove(mToken) != null) {
+                    updatePowerLocked();
+                }
+            }
+        }
+    }
+
     public JdtsService(Context context) {
     	super();
 
+        mContext = context;
+
     	Log.i(TAG, "JdtsTemperature Service started");
 
         mNativePointer = init_native();
+
+        synchronized (mLock) {
+            updatePowerLocked();
+        }
+
+        // the reader thread holds a reference to this service, which is thus never
+        // finalized: the thread is ended here instead
+        mContext.registerReceiver(new BroadcastReceiver() {
+            @Override
+            public void onReceive(Context context, Intent intent) {
+                shutdown();
+            }
+        }, new IntentFilter(Intent.ACTION_SHUTDOWN));
+    }
+
+    private void shutdown() {
+        synchronized (mLock) {
+            if (mShutdown) {
+                return;
+            }
+            mShutdown = true;
+            updateReaderLocked();
+        }
+        // outside mLock, it waits for the reader thread, which may be waiting for mLock
+        close_reader_native(mNativePointer);
     }
 
     protected void finalize() throws Throwable {
+        synchronized (mLock) {
+            stop_reader_native(mNativePointer);
+            mReaderRunning = false;
+        }
+        // outside mLock, it waits for the reader thread, which may be waiting for mLock
         finalize_native(mNativePointer);
         super.finalize();
     }
 
     public JdtsTemperatureData readSample() {
-        return read_sample_native(mNativePointer);
+        JdtsTemperatureData data = new JdtsTemperatureData();
+        return readSample(data, 0) ? data : null;
+    }
+
+    /**
+     * Returns the cached sample if it was taken no more than maxAgeMs ago, otherwise
+     * reads the device. A burst mode reader polling at its own period thus shares the
+     * power-ups of the others.
+     */
+    public JdtsTemperatureData readCachedSample(int maxAgeMs) {
+        if (maxAgeMs < 0) {
+            throw new IllegalArgumentException("invalid age");
+        }
+        JdtsTemperatureData data = new JdtsTemperatureData();
+        return readSample(data, maxAgeMs * 1000000L) ? data : null;
+    }
+
+    // callers arriving while a device read is in flight wait for it and share its sample
+    // instead of starting their own, so any number of them costs one read per period
+    private boolean readSample(JdtsTemperatureData data, long maxAgeNanos) {
+        synchronized (mLock) {
+            // while the reader runs, the latest sample it pushed is as fresh as the driver's
+            if (mHasLatest && (mReaderRunning ||
+                    System.nanoTime() - mLatest.timestampNanos <= maxAgeNanos)) {
+                data.copyFrom(mLatest);
+                mCacheHits++;
+                return true;
+            }
+
+            if (mReadInFlight) {
+                mCoalescedReads++;
+                int generation = mReadGeneration;
+                while (mReadGeneration == generation) {
+                    try {
+                        mLock.wait();
+                    } catch (InterruptedException e) {
+                    }
+                }
+                if (mLastReadOk) {
+                    data.copyFrom(mLatest);
+                }
+                return mLastReadOk;
+            }
+            mReadInFlight = true;
+        }
+
+        // the device may take a burst mode power-up to answer, not under the lock
+        boolean ok = read_sample_into_native(mNativePointer, data);
+
+        synchronized (mLock) {
+            mDeviceReads++;
+            if (!ok) {
+                mDeviceReadErrors++;
+                noteErrorLocked("device read failed");
+            }
+            // the reader may have pushed a newer one meanwhile
+            if (ok && (!mHasLatest || data.sequence >= mLatest.sequence)) {
+                mLatest.copyFrom(data);
+                mHasLatest = true;
+                if (isNewInHistoryLocked(data.sequence)) {
+                    data.writeToRecord(mHistoryBuffer, historyOffset(mHistoryCount++));
+                    addToStatisticsLocked(historyOffset(mHistoryCount - 1));
+                }
+                checkAlertsLocked(data.flags, data, null, 0);
+            }
+            if (ok) {
+                data.copyFrom(mLatest);
+            }
+            mLastReadOk = ok;
+            mReadInFlight = false;
+            mReadGeneration++;
+            mLock.notifyAll();
+        }
+        return ok;
+    }
+
+    /**
+     * Returns up to maxCount of the samples of the long-term history with
+     * fromMs <= time < toMs (wall clock), oldest first, or null when the history is off.
+     * The HAL scans it without holding up the reader, so this takes no lock of the service.
+     */
+    public JdtsHistoryBlock queryHistory(long fromMs, long toMs, int maxCount) {
+        if (maxCount < 0) {
+            throw new IllegalArgumentException("invalid count");
+        }
+        if (mNativePointer == 0) {
+            return null;
+        }
+
+        int capacity = Math.min(maxCount, MAX_HISTORY_QUERY);
+        long[] sequences = new long[capacity];
+        long[] timesMs = new long[capacity];
+        int[] temperatures = new int[capacity * JdtsTemperatureData.CHANNEL_COUNT];
+        int count = query_history_native(mNativePointer, fromMs, toMs, sequences, timesMs, temperatures);
+        if (count < 0) {
+            return null;
+        }
+        return new JdtsHistoryBlock(sequences, timesMs, temperatures, count);
+    }
+
+    /**
+     * Returns up to maxCount aggregates of the long-term history, one per resolutionMs
+     * between fromMs and toMs (wall clock), or null when the history is off.
+     */
+    public JdtsRollup[] queryRollups(long fromMs, long toMs, long resolutionMs, int maxCount) {
+        if (maxCount < 0 || resolutionMs <= 0) {
+            throw new IllegalArgumentException("invalid count or resolution");
+        }
+        if (mNativePointer == 0) {
+            return null;
+        }
+
+        int capacity = Math.min(maxCount, MAX_ROLLUP_QUERY);
+        long[] times = new long[capacity * ROLLUP_TIMES];
+        int[] values = new int[capacity * ROLLUP_VALUES];
+        float[] means = new float[capacity * JdtsTemperatureData.CHANNEL_COUNT];
+        int count = query_rollups_native(mNativePointer, fromMs, toMs, resolutionMs, times, values, means);
+        if (count < 0) {
+            return null;
+        }
+
+        JdtsRollup[] rollups = new JdtsRollup[count];
+        for (int i = 0; i < count; i++) {
+            JdtsRollup rollup = new JdtsRollup();
+            rollup.startMs = times[i * ROLLUP_TIMES + ROLLUP_START_MS];
+            rollup.durationMs = times[i * ROLLUP_TIMES + ROLLUP_DURATION_MS];
+            rollup.count = values[i * ROLLUP_VALUES + ROLLUP_COUNT];
+            for (int ch = 0; ch < JdtsTemperatureData.CHANNEL_COUNT; ch++) {
+                rollup.min[ch] = values[i * ROLLUP_VALUES + ROLLUP_MIN + ch];
+                rollup.max[ch] = values[i * ROLLUP_VALUES + ROLLUP_MAX + ch];
+                rollup.mean[ch] = means[i * JdtsTemperatureData.CHANNEL_COUNT + ch];
+            }
+            rollups[i] = rollup;
+        }
+        return rollups;
+    }
+
+    /**
+     * Records the mode 'token' asks for. The device runs in continuous mode while any
+     * powered client asks for it or reads faster than CONTINUOUS_PERIOD_US, in burst
+     * mode otherwise. Returns false if the resulting state could not be applied.
+     */
+    public boolean setMode(IBinder token, boolean is_continuous) {
+        synchronized (mLock) {
+            PowerClient client = getPowerClientLocked(token);
+            if (client == null) {
+                return false;
+            }
+            client.mModeVote = is_continuous ? VOTE_ON : VOTE_OFF;
+            return updatePowerLocked();
+        }
+    }
+
+    /**
+     * Records whether 'token' wants the sensor powered. It is switched off only when
+     * somebody asked for that and nobody needs it: no client asks for power and none
+     * listens, streams or maps the shared memory.
+     */
+    public boolean activate(IBinder token, boolean enabled) {
+        synchronized (mLock) {
+            PowerClient client = getPowerClientLocked(token);
+            if (client == null) {
+                return false;
+            }
+            client.mPowerVote = enabled ? VOTE_ON : VOTE_OFF;
+            return updatePowerLocked();
+        }
     }
 
-    public boolean setMode(boolean is_continuous) {
-        return set_mode_native(mNativePointer, is_continuous);
+    /**
+     * Drops the requests 'token' made through activate() and setMode(), as its death would.
+     */
+    public void releaseVotes(IBinder token) {
+        if (token == null) {
+            return;
+        }
+        synchronized (mLock) {
+            PowerClient client = mPowerClients.remove(token);
+            if (client != null) {
+                token.unlinkToDeath(client, 0);
+                updatePowerLocked();
+            }
+        }
+    }
+
+    private PowerClient getPowerClientLocked(IBinder token) {
+        if (token == null) {
+            throw new IllegalArgumentException("token is null");
+        }
+
+        PowerClient client = mPowerClients.get(token);
+        if (client == null) {
+            client = new PowerClient(token);
+            try {
+                token.linkToDeath(client, 0);
+            } catch (RemoteException e) {
+                // the client is gone already
+                return null;
+            }
+            mPowerClients.put(token, client);
+        }
+        return client;
+    }
+
+    // sets the device to the cheapest state serving every client, then starts or stops
+    // the reader to match. The driver calls are quick register writes, unlike reads
+    private boolean updatePowerLocked() {
+        boolean demand = !mListeners.isEmpty() || !mSharedMemoryClients.isEmpty() || mHasStreams;
+        // the shared memory is there for clients polling fast
+        boolean fastDemand = !mSharedMemoryClients.isEmpty() ||
+                (mHasStreams && mMinStreamPeriodUs < CONTINUOUS_PERIOD_US);
+        for (Listener listener : mListeners.values()) {
+            fastDemand |= listener.mPeriodNanos < CONTINUOUS_PERIOD_US * 1000L;
+        }
+
+        boolean powerOn = false;
+        boolean powerOff = false;
+        boolean continuous = fastDemand;
+        for (PowerClient client : mPowerClients.values()) {
+            powerOn |= client.mPowerVote == VOTE_ON;
+            powerOff |= client.mPowerVote == VOTE_OFF;
+            continuous |= client.mModeVote == VOTE_ON && client.mPowerVote != VOTE_OFF;
+        }
+        boolean powered = demand || powerOn || !powerOff;
+
+        boolean ok = mNativePointer != 0;
+        if (ok && (powered != mPowered || !mPowerVoted)) {
+            if (activate_native(mNativePointer, powered)) {
+                mPowered = powered;
+                mPowerVoted = true;
+            } else {
+                ok = false;
+                mPowerErrors++;
+                noteErrorLocked("cannot switch the power " + (powered ? "on" : "off"));
+            }
+        }
+        if (ok && powered && (continuous != mContinuous || !mModeVoted)) {
+            if (set_mode_native(mNativePointer, continuous)) {
+                mContinuous = continuous;
+                mModeVoted = true;
+            } else {
+                ok = false;
+                mPowerErrors++;
+                noteErrorLocked("cannot switch to " + (continuous ? "continuous" : "burst") + " mode");
+            }
+        }
+
+        // in burst mode the sensor only measures on a single sample read, the paced reader
+        // makes those at the pace of the fastest client; in continuous mode it drains the
+        // driver FIFO, which burst mode leaves empty. The period follows the mode the
+        // device is in, even one that could not be switched, and is never 0 in burst mode
+        // (as fast as the measurements go for a client asking for 0 or for the shared
+        // memory, when continuous mode failed)
+        int readPeriodUs = 0;
+        if (!mContinuous) {
+            readPeriodUs = mHasStreams ? mMinStreamPeriodUs : Integer.MAX_VALUE;
+            for (Listener listener : mListeners.values()) {
+                readPeriodUs = (int) Math.min(readPeriodUs, listener.mPeriodNanos / 1000);
+            }
+            if (readPeriodUs == Integer.MAX_VALUE || readPeriodUs < 1) {
+                readPeriodUs = 1;
+            }
+        }
+        if (mNativePointer != 0 && readPeriodUs != mReadPeriodUs) {
+            set_reader_period_native(mNativePointer, readPeriodUs);
+            mReadPeriodUs = readPeriodUs;
+        }
+
+        updateReaderLocked();
+        return ok;
+    }
+
+    /**
+     * Delivers samples to 'listener' in batches through oneway calls, at most one sample
+     * per samplingPeriodUs (0 for all of them) and no later than maxReportLatencyUs after
+     * the first sample of a batch has arrived (0 to deliver every read as it comes). The
+     * latency is checked as samples arrive, so it may be exceeded by one sensor period.
+     * With a changeThreshold (0.01C, 0 for none) a sample is only sent once a channel has
+     * moved by that much since the last one sent, or heartbeatMs (0 for never) after it.
+     * Registering a listener again updates its rates.
+     */
+    public boolean registerListener(IJdtsListener listener, int samplingPeriodUs, int maxReportLatencyUs,
+            boolean average, int changeThreshold, int heartbeatMs) {
+        if (listener == null || samplingPeriodUs < 0 || maxReportLatencyUs < 0 ||
+                changeThreshold < 0 || heartbeatMs < 0) {
+            throw new IllegalArgumentException("invalid listener, rates or thresholds");
+        }
+
+        IBinder binder = listener.asBinder();
+        Listener record = new Listener(listener, samplingPeriodUs, maxReportLatencyUs, average,
+                changeThreshold, heartbeatMs);
+        try {
+            binder.linkToDeath(record, 0);
+        } catch (RemoteException e) {
+            // the client is gone already
+            return false;
+        }
+
+        synchronized (mLock) {
+            removeListenerLocked(binder);
+            mListeners.put(binder, record);
+            updatePowerLocked();
+            return mReaderRunning;
+        }
+    }
+
+    public void unregisterListener(IJdtsListener listener) {
+        if (listener == null) {
+            return;
+        }
+        synchronized (mLock) {
+            removeListenerLocked(listener.asBinder());
+        }
+    }
+
+    /**
+     * Returns a read-only fd of the shared sample region (techartms_jdts_shm_t in
+     * hardware/sensor_jdts_temperature.h) or null. Samples are published there for as
+     * long as 'token' is alive and has not been passed to closeSharedMemory().
+     */
+    public ParcelFileDescriptor openSharedMemory(IBinder token) {
+        if (token == null) {
+            throw new IllegalArgumentException("token is null");
+        }
+
+        int fd = get_shared_memory_native(mNativePointer);
+        if (fd < 0) {
+            return null;
+        }
+
+        ParcelFileDescriptor pfd;
+        try {
+            pfd = ParcelFileDescriptor.fromFd(fd);
+        } catch (IOException e) {
+            Log.e(TAG, "cannot duplicate the shared memory fd", e);
+            return null;
+        }
+
+        synchronized (mLock) {
+            if (!mSharedMemoryClients.containsKey(token)) {
+                SharedMemoryClient client = new SharedMemoryClient(token);
+                try {
+                    token.linkToDeath(client, 0);
+                } catch (RemoteException e) {
+                    // the client is gone already
+                    return null;
+                }
+                mSharedMemoryClients.put(token, client);
+                updatePowerLocked();
+            }
+        }
+        return pfd;
+    }
+
+    public void closeSharedMemory(IBinder token) {
+        if (token == null) {
+            return;
+        }
+        synchronized (mLock) {
+            removeSharedMemoryClientLocked(token);
+        }
+    }
+
+    /**
+     * Returns the read end of a pipe the service writes every new sample into, at most
+     * one per samplingPeriodUs (0 for all of them), packed as JdtsTemperatureData.RECORD_*
+     * in native byte order. Records are never split, so reads of a multiple of
+     * RECORD_SIZE bytes return whole records. A client too slow to drain the pipe loses
+     * batches, visible as gaps in the sequence. Closing the pipe ends the stream.
+     */
+    public ParcelFileDescriptor openStream(int samplingPeriodUs) {
+        if (samplingPeriodUs < 0) {
+            throw new IllegalArgumentException("invalid sampling period");
+        }
+        if (mNativePointer == 0) {
+            return null;
+        }
+
+        ParcelFileDescriptor[] pipe;
+        try {
+            pipe = ParcelFileDescriptor.createPipe();
+        } catch (IOException e) {
+            Log.e(TAG, "cannot create a stream pipe", e);
+            return null;
+        }
+
+        synchronized (mLock) {
+            // the native part owns the write end from now on
+            if (!add_stream_native(mNativePointer, pipe[1].detachFd(), samplingPeriodUs * 1000L)) {
+                try {
+                    pipe[0].close();
+                } catch (IOException e) {
+                }
+                return null;
+            }
+            mHasStreams = true;
+            mMinStreamPeriodUs = Math.min(mMinStreamPeriodUs, samplingPeriodUs);
+            updatePowerLocked();
+        }
+        // closed here once it is written into the reply
+        return pipe[0];
+    }
+
+    /**
+     * Returns up to maxCount of the samples following sinceSequence (-1 for all those
+     * held) from the last HISTORY_SIZE the service has seen, oldest first. A client
+     * catching up passes the sequence of the last sample it got and calls again while
+     * the block comes back full.
+     */
+    public JdtsSampleBlock readSamples(long sinceSequence, int maxCount) {
+        if (maxCount < 0) {
+            throw new IllegalArgumentException("invalid count");
+        }
+
+        synchronized (mLock) {
+            // the history is in sequence order, the first sample past sinceSequence is searched
+            long low = Math.max(0, mHistoryCount - HISTORY_SIZE);
+            long high = mHistoryCount;
+            while (low < high) {
+                long middle = (low + high) >>> 1;
+                if (mHistoryBuffer.getLong(historyOffset(middle) + JdtsTemperatureData.RECORD_SEQUENCE)
+                        > sinceSequence) {
+                    high = middle;
+                } else {
+                    low = middle + 1;
+                }
+            }
+
+            int count = (int) Math.min(maxCount, mHistoryCount - low);
+            byte[] records = new byte[count * JdtsTemperatureData.RECORD_SIZE];
+            // at most two copies, the run may wrap around the end of the ring
+            int first = Math.min(count, HISTORY_SIZE - (int) (low % HISTORY_SIZE));
+            System.arraycopy(mHistory, historyOffset(low), records, 0,
+                    first * JdtsTemperatureData.RECORD_SIZE);
+            System.arraycopy(mHistory, 0, records, first * JdtsTemperatureData.RECORD_SIZE,
+                    (count - first) * JdtsTemperatureData.RECORD_SIZE);
+            return new JdtsSampleBlock(records, count);
+        }
+    }
+
+    /**
+     * Returns the mean, standard deviation, min, max and least squares slope of a
+     * channel (JdtsTemperatureData.CHANNEL_*) over the samples of the last windowMs.
+     * The first call for a window starts tracking it, from the history the service
+     * holds; later ones are answered from running sums.
+     */
+    public JdtsChannelStatistics getStatistics(int channel, int windowMs) {
+        if (channel < 0 || channel > JdtsTemperatureData.CHANNEL_COMPENSATED_OBJECT ||
+                windowMs <= 0 || windowMs > MAX_STATISTICS_WINDOW_MS) {
+            throw new IllegalArgumentException("invalid channel or window");
+        }
+
+        long now = System.nanoTime();
+        synchronized (mLock) {
+            WindowStatistics statistics = getWindowStatisticsLocked(windowMs * 1000000L, now);
+            statistics.mLastUsedNanos = now;
+            // the window ends now, not at the last sample the reader pushed
+            statistics.expire(now);
+            return statistics.get(channel);
+        }
+    }
+
+    /**
+     * Sets the HAL filter of a channel, see JdtsManager.setFilter(). Its output reaches
+     * every client through the filtered* fields, filtering once at the source, so it is
+     * left to callers holding HARDWARE_TEST. Returns false for the others.
+     */
+    public boolean setFilter(int channel, int type, float alpha, float processNoise, float measurementNoise) {
+        if (mContext.checkCallingOrSelfPermission(Manifest.permission.HARDWARE_TEST)
+                != PackageManager.PERMISSION_GRANTED) {
+            Log.w(TAG, "Permission Denial: can't set the filter from pid="
+                    + Binder.getCallingPid()
+                    + ", uid=" + Binder.getCallingUid());
+            return false;
+        }
+        if (channel < 0 || channel >= JdtsTemperatureData.CHANNEL_COUNT) {
+            throw new IllegalArgumentException("invalid channel");
+        }
+
+        synchronized (mLock) {
+            if (!set_filter_native(mNativePointer, channel, type, alpha, processNoise, measurementNoise)) {
+                return false;
+            }
+            switch (type) {
+                case JdtsTemperatureData.FILTER_EWMA:
+                    mFilters[channel] = "ewma alpha=" + alpha;
+                    break;
+                case JdtsTemperatureData.FILTER_KALMAN:
+                    mFilters[channel] = "kalman q=" + processNoise + " r=" + measurementNoise;
+                    break;
+                default:
+                    mFilters[channel] = null;
+                    break;
+            }
+            return true;
+        }
+    }
+
+    private WindowStatistics getWindowStatisticsLocked(long windowNanos, long now) {
+        WindowStatistics oldest = null;
+        for (WindowStatistics statistics : mStatistics) {
+            if (statistics.mWindowNanos == windowNanos) {
+                return statistics;
+            }
+            if (oldest == null || statistics.mLastUsedNanos < oldest.mLastUsedNanos) {
+                oldest = statistics;
+            }
+        }
+        if (mStatistics.size() == MAX_STATISTICS_WINDOWS) {
+            mStatistics.remove(oldest);
+        }
+
+        WindowStatistics statistics = new WindowStatistics(windowNanos);
+        for (long i = Math.max(0, mHistoryCount - HISTORY_SIZE); i < mHistoryCount; i++) {
+            int offset = historyOffset(i);
+            if (now - mHistoryBuffer.getLong(offset + JdtsTemperatureData.RECORD_TIMESTAMP) < windowNanos) {
+                addToStatistics(statistics, offset);
+            }
+        }
+        mStatistics.add(statistics);
+        return statistics;
+    }
+
+    private void addToStatisticsLocked(int offset) {
+        for (int i = 0; i < mStatistics.size(); i++) {
+            addToStatistics(mStatistics.get(i), offset);
+        }
+    }
+
+    private void addToStatistics(WindowStatistics statistics, int offset) {
+        statistics.add(mHistoryBuffer.getLong(offset + JdtsTemperatureData.RECORD_TIMESTAMP),
+                mHistoryBuffer.getShort(offset + JdtsTemperatureData.RECORD_OBJECT),
+                mHistoryBuffer.getShort(offset + JdtsTemperatureData.RECORD_NTC1),
+                mHistoryBuffer.getShort(offset + JdtsTemperatureData.RECORD_NTC2),
+                mHistoryBuffer.getShort(offset + JdtsTemperatureData.RECORD_NTC3),
+                mHistoryBuffer.getShort(offset + JdtsTemperatureData.RECORD_COMPENSATED_OBJECT));
+    }
+
+    private static int historyOffset(long index) {
+        return (int) (index & (HISTORY_SIZE - 1)) * JdtsTemperatureData.RECORD_SIZE;
+    }
+
+    // the reader and the device reads both feed the history, a sample goes in once
+    private boolean isNewInHistoryLocked(long sequence) {
+        return mHistoryCount == 0 || sequence > mHistoryBuffer.getLong(
+                historyOffset(mHistoryCount - 1) + JdtsTemperatureData.RECORD_SEQUENCE);
+    }
+
+    private void removeSharedMemoryClientLocked(IBinder token) {
+        SharedMemoryClient client = mSharedMemoryClients.remove(token);
+        if (client != null) {
+            token.unlinkToDeath(client, 0);
+            updatePowerLocked();
+        }
+    }
+
+    private void removeListenerLocked(IBinder binder) {
+        Listener record = mListeners.remove(binder);
+        if (record != null) {
+            binder.unlinkToDeath(record, 0);
+            updatePowerLocked();
+        }
+    }
+
+    // one reader serves everybody: it runs in continuous mode and, in burst mode, while
+    // somebody listens, maps the shared memory or streams. In burst mode it is paced by
+    // updatePowerLocked() before it starts, a paced reader reads single samples, on which
+    // the sensor wakes up to measure; an unpaced one would wait on the empty driver FIFO
+    private void updateReaderLocked() {
+        boolean wanted = mNativePointer != 0 && !mShutdown && mPowered &&
+                (mContinuous || !mListeners.isEmpty() || !mSharedMemoryClients.isEmpty() || mHasStreams);
+
+        if (wanted && !mReaderRunning) {
+            // a stop only pauses the native thread, which keeps the buffer it was first started with
+            mReaderRunning = start_reader_native(mNativePointer, this, mReaderBuffer);
+            mHasLatest = false;
+        } else if (!wanted && mReaderRunning) {
+            stop_reader_native(mNativePointer);
+            mReaderRunning = false;
+        }
+    }
+
+    /**
+     * Called on the native reader thread with 'count' new samples packed at the start
+     * of 'buffer' as JdtsTemperatureData.RECORD_*. The buffer is reused once this returns.
+     */
+    private void onSamples(ByteBuffer buffer, int count) {
+        synchronized (mLock) {
+            mLatest.readFromRecord(buffer, (count - 1) * JdtsTemperatureData.RECORD_SIZE);
+            mHasLatest = true;
+
+            ByteBuffer records = buffer.duplicate();
+            for (int i = 0; i < count; i++) {
+                int offset = i * JdtsTemperatureData.RECORD_SIZE;
+                if (isNewInHistoryLocked(buffer.getLong(offset + JdtsTemperatureData.RECORD_SEQUENCE))) {
+                    records.position(offset);
+                    records.get(mHistory, historyOffset(mHistoryCount++), JdtsTemperatureData.RECORD_SIZE);
+                    addToStatisticsLocked(historyOffset(mHistoryCount - 1));
+                }
+                // repeated samples too, a stuck synchro shows only there
+                checkAlertsLocked(buffer.getShort(offset + JdtsTemperatureData.RECORD_FLAGS) & 0xffff,
+                        null, buffer, offset);
+            }
+
+            if (!mListeners.isEmpty()) {
+                dispatchLocked(buffer, count);
+            }
+
+            // the streams have just been written, the last of them may have gone
+            if (mHasStreams && get_stream_count_native(mNativePointer) == 0) {
+                mHasStreams = false;
+                mMinStreamPeriodUs = Integer.MAX_VALUE;
+                updatePowerLocked();
+            }
+        }
+    }
+
+    // the HAL detector flags every sample (JdtsTemperatureData.FLAG_*), a flag raised
+    // that the previous sample did not have is an alert. It goes to every listener at
+    // once, bypassing their period, batching and change threshold. The sample is either
+    // 'sample' or the record at 'offset' of 'buffer'
+    private void checkAlertsLocked(int flags, JdtsTemperatureData sample, ByteBuffer buffer, int offset) {
+        int raised = flags & ~mAlertFlags;
+        mAlertFlags = flags;
+        if (raised == 0) {
+            return;
+        }
+
+        // 'sample' belongs to the caller, the alert keeps its own
+        JdtsTemperatureData alert = new JdtsTemperatureData();
+        if (sample != null) {
+            alert.copyFrom(sample);
+        } else {
+            alert.readFromRecord(buffer, offset);
+        }
+        sample = alert;
+        mAlerts++;
+        mLastAlert = sample;
+        mLastAlertFlags = raised;
+        Log.w(TAG, "alert: " + JdtsTemperatureData.flagsToString(raised) + " at seq=" + sample.sequence
+                + " object=" + sample.objectTemperature + " ntc=" + sample.ntc1Temperature + "/"
+                + sample.ntc2Temperature + "/" + sample.ntc3Temperature);
+
+        for (Listener listener : mListeners.values()) {
+            try {
+                listener.mListener.onAlert(sample, raised);
+            } catch (RemoteException e) {
+                // dispatchLocked() or the death notification drops it
+                mDeliveryErrors++;
+            }
+        }
+    }
+
+    private void dispatchLocked(ByteBuffer buffer, int count) {
+        // every record is unpacked once and shared by the listeners taking it
+        JdtsTemperatureData[] samples = new JdtsTemperatureData[count];
+        long now = System.nanoTime();
+
+        for (int i = 0; i < count; i++) {
+            int offset = i * JdtsTemperatureData.RECORD_SIZE;
+            long timestamp = buffer.getLong(offset + JdtsTemperatureData.RECORD_TIMESTAMP);
+            for (Listener listener : mListeners.values()) {
+                if (listener.mAverage) {
+                    listener.accumulate(buffer, offset);
+                }
+                if (!listener.take(timestamp)) {
+                    listener.mSkipped++;
+                    continue;
+                }
+
+                JdtsTemperatureData sample;
+                if (listener.mAverage) {
+                    sample = listener.takeAverage(buffer, offset);
+                } else {
+                    if (samples[i] == null) {
+                        samples[i] = new JdtsTemperatureData();
+                        samples[i].readFromRecord(buffer, offset);
+                    }
+                    sample = samples[i];
+                }
+                // checked here so that a flat temperature costs no binder call at all
+                if (!listener.hasChanged(sample)) {
+                    listener.mSkipped++;
+                    continue;
+                }
+                listener.mLastDelivered = sample;
+                if (listener.mPending.isEmpty()) {
+                    listener.mPendingSince = now;
+                }
+                listener.mPending.add(sample);
+            }
+        }
+
+        // oneway calls do not wait for the clients
+        boolean removed = false;
+        Iterator<Listener> it = mListeners.values().iterator();
+        while (it.hasNext()) {
+            Listener listener = it.next();
+            if (listener.mPending.isEmpty() ||
+                    (now - listener.mPendingSince < listener.mLatencyNanos &&
+                    listener.mPending.size() < MAX_LISTENER_BATCH)) {
+                continue;
+            }
+            mDeliveryAge.record(now - listener.mPending.get(0).timestampNanos);
+            try {
+                long start = System.nanoTime();
+                listener.mListener.onSamples(
+                        listener.mPending.toArray(new JdtsTemperatureData[listener.mPending.size()]));
+                mBinderCallTime.record(System.nanoTime() - start);
+                listener.mDelivered += listener.mPending.size();
+                listener.mPending.clear();
+            } catch (RemoteException e) {
+                Log.w(TAG, "dropping a listener that is gone");
+                mDeliveryErrors++;
+                noteErrorLocked("listener gone, " + listener.mPending.size() + " samples dropped");
+                it.remove();
+                listener.mListener.asBinder().unlinkToDeath(listener, 0);
+                removed = true;
+            }
+        }
+
+        if (removed) {
+            updatePowerLocked();
+        }
+    }
+
+    private void noteErrorLocked(String what) {
+        mRecentErrors[mRecentErrorCount++ % RECENT_ERRORS] = SystemClock.elapsedRealtime() + " " + what;
+    }
+
+    @Override
+    protected void dump(FileDescriptor fd, PrintWriter pw, String[] args) {
+        if (mContext.checkCallingOrSelfPermission(Manifest.permission.DUMP)
+                != PackageManager.PERMISSION_GRANTED) {
+            pw.println("Permission Denial: can't dump JdtsService from pid="
+                    + Binder.getCallingPid()
+                    + ", uid=" + Binder.getCallingUid());
+            return;
+        }
+
+        long[] readStats = new long[READ_STAT_COUNT];
+        long[] readHistogram = new long[LatencyHistogram.BUCKETS];
+        long[] streamStats = new long[3 * 32];
+        int streams = 0;
+        LatencyHistogram readLatency = new LatencyHistogram();
+        if (mNativePointer != 0) {
+            get_read_stats_native(mNativePointer, readStats, readHistogram);
+            readLatency.set(readHistogram, readStats[READ_STAT_MAX_US]);
+            streams = get_stream_stats_native(mNativePointer, streamStats);
+        }
+
+        synchronized (mLock) {
+            pw.println("JDTS TEMPERATURE SERVICE (dumpsys jdtstemperature)");
+            pw.println("  device: " + (mNativePointer != 0 ? "open" : "not available"));
+            pw.println("  votes: power " + (mPowered ? "on" : "off")
+                    + ", mode " + (mContinuous ? "continuous" : "burst")
+                    + ", reader: " + (mReaderRunning ? "running" : "stopped")
+                    + (mReadPeriodUs > 0 ? " every " + mReadPeriodUs + "us" : ""));
+            pw.println("  latest sample: " + (mHasLatest ? "seq=" + mLatest.sequence + " age="
+                    + (System.nanoTime() - mLatest.timestampNanos) / 1000000 + "ms" : "none"));
+            pw.println("  history: " + Math.min(mHistoryCount, HISTORY_SIZE) + " of "
+                    + mHistoryCount + " samples held");
+            pw.println("  alerts: " + mAlerts + ", active: " + JdtsTemperatureData.flagsToString(mAlertFlags)
+                    + (mLastAlert != null ? ", last: " + JdtsTemperatureData.flagsToString(mLastAlertFlags)
+                            + " at seq=" + mLastAlert.sequence : ""));
+            for (int ch = 0; ch < JdtsTemperatureData.CHANNEL_COUNT; ch++) {
+                if (mFilters[ch] != null) {
+                    pw.println("  channel " + ch + " filter: " + mFilters[ch]);
+                }
+            }
+            for (WindowStatistics statistics : mStatistics) {
+                pw.println("  statistics window " + statistics.mWindowNanos / 1000000 + "ms: "
+                        + statistics.getCount() + " samples");
+            }
+
+            pw.println();
+            pw.println("  native reads: " + readStats[READ_STAT_READS]
+                    + ", samples: " + readStats[READ_STAT_SAMPLES]
+                    + ", errors: " + readStats[READ_STAT_ERRORS]);
+            readLatency.dump(pw, "native read latency");
+            mDeliveryAge.dump(pw, "sample age at delivery");
+            mBinderCallTime.dump(pw, "binder call time");
+
+            long requests = mCacheHits + mCoalescedReads + mDeviceReads;
+            pw.println("  readSample(): " + requests + " requests, "
+                    + mCacheHits + " cache hits, "
+                    + mCoalescedReads + " coalesced, "
+                    + mDeviceReads + " device reads"
+                    + (requests > 0 ? ", hit ratio "
+                            + (100 * (mCacheHits + mCoalescedReads) / requests) + "%" : ""));
+
+            pw.println();
+            pw.println("  listeners: " + mListeners.size());
+            for (Listener listener : mListeners.values()) {
+                pw.println("    " + listener.mListener.asBinder()
+                        + " period=" + listener.mPeriodNanos / 1000 + "us"
+                        + " latency=" + listener.mLatencyNanos / 1000 + "us"
+                        + (listener.mAverage ? " average" : "")
+                        + (listener.mChangeThreshold > 0 ? " delta=" + listener.mChangeThreshold
+                                + " heartbeat=" + listener.mHeartbeatNanos / 1000000 + "ms" : "")
+                        + " delivered=" + listener.mDelivered
+                        + " skipped=" + listener.mSkipped
+                        + " pending=" + listener.mPending.size());
+            }
+            pw.println("  streams: " + streams);
+            for (int i = 0; i < streams; i++) {
+                pw.println("    period=" + streamStats[i * 3] / 1000 + "us"
+                        + " written=" + streamStats[i * 3 + 1]
+                        + " dropped batches=" + streamStats[i * 3 + 2]);
+            }
+            pw.println("  shared memory clients: " + mSharedMemoryClients.size());
+            pw.println("  power clients: " + mPowerClients.size());
+            for (PowerClient client : mPowerClients.values()) {
+                pw.println("    " + client.mToken
+                        + " power=" + voteToString(client.mPowerVote)
+                        + " continuous=" + voteToString(client.mModeVote));
+            }
+
+            pw.println();
+            pw.println("  errors: device reads " + mDeviceReadErrors
+                    + ", power/mode " + mPowerErrors
+                    + ", deliveries " + mDeliveryErrors);
+            int first = Math.max(0, mRecentErrorCount - RECENT_ERRORS);
+            if (mRecentErrorCount > 0) {
+                pw.println("  recent errors (elapsed realtime ms):");
+            }
+            for (int i = first; i < mRecentErrorCount; i++) {
+                pw.println("    " + mRecentErrors[i % RECENT_ERRORS]);
+            }
+        }
     }
 
-    public boolean activate(boolean enabled) {
-        return activate_native(mNativePointer, enabled);
+    private static String voteToString(int vote) {
+        switch (vote) {
+            case VOTE_ON:
+                return "yes";
+            case VOTE_OFF:
+                return "no";
+            default:
+                return "-";
+        }
     }
 
     private static native long init_native();
     private static native void finalize_native(long ptr);
-    private static native JdtsTemperatureData read_sample_native(long ptr);
+    private static native boolean read_sample_into_native(long ptr, JdtsTemperatureData data);
+    private static native boolean start_reader_native(long ptr, JdtsService service, ByteBuffer buffer);
+    private static native void stop_reader_native(long ptr);
+    private static native void close_reader_native(long ptr);
+    private static native void set_reader_period_native(long ptr, int periodUs);
+    private static native int get_shared_memory_native(long ptr);
+    private static native boolean add_stream_native(long ptr, int fd, long periodNanos);
+    private static native int get_stream_count_native(long ptr);
+    private static native void get_read_stats_native(long ptr, long[] counters, long[] histogram);
+    private static native int get_stream_stats_native(long ptr, long[] out);
+    private static native boolean set_filter_native(long ptr, int channel, int type, float alpha,
+            float processNoise, float measurementNoise);
     private static native boolean activate_native(long ptr, boolean enabled);
     private static native boolean set_mode_native(long ptr, boolean is_continuous);
+    private static native int query_history_native(long ptr, long fromMs, long toMs, long[] sequences,
+            long[] timesMs, int[] temperatures);
+    private static native int query_rollups_native(long ptr, long fromMs, long toMs, long resolutionMs,
+            long[] times, int[] values, float[] means);
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+package com.android.server.temperature;
+
+import java.io.PrintWriter;
+import java.util.concurrent.atomic.AtomicLong;
+import java.util.concurrent.atomic.AtomicLongArray;
+
+/**
+ * Latencies in log-linear buckets of microseconds: exact below 4 us, then four buckets
+ * per power of two, which bounds the error of a percentile to 25%. Recording is a pair
+ * of atomic updates with no lock, the native reader keeps the same buckets (see
+ * latency_bucket() in com_android_server_temperature_JdtsService.cpp).
+ */
+final class LatencyHistogram {
+    static final int BUCKETS = 100;
+
+    private final AtomicLongArray mCounts = new AtomicLongArray(BUCKETS);
+    private final AtomicLong mMaxUs = new AtomicLong();
+
+    static int bucket(long us) {
+        if (us < 4) {
+            return us < 0 ? 0 : (int) us;
+        }
+        int msb = 63 - Long.numberOfLeadingZeros(us);
+        int index = (msb - 1) * 4 + (int) ((us >> (msb - 2)) & 3);
+        return Math.min(index, BUCKETS - 1);
+    }
+
+    // the largest value falling into 'index'
+    static long bucketLimit(int index) {
+        if (index < 4) {
+            return index;
+        }
+        int msb = index / 4 + 1;
+        return ((4L + index % 4 + 1) << (msb - 2)) - 1;
+    }
+
+    void record(long nanos) {
+        long us = nanos / 1000;
+        mCounts.incrementAndGet(bucket(us));
+
+        long max = mMaxUs.get();
+        while (us > max && !mMaxUs.compareAndSet(max, us)) {
+            max = mMaxUs.get();
+        }
+    }
+
+    // replaces the content by a copy of the native counterpart
+    void set(long[] counts, long maxUs) {
+        for (int i = 0; i < BUCKETS; i++) {
+            mCounts.set(i, counts[i]);
+        }
+        mMaxUs.set(maxUs);
+    }
+
+    long getCount() {
+        long count = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            count += mCounts.get(i);
+        }
+        return count;
+    }
+
+    // the bucket limit under which 'fraction' of the values are, capped by the maximum
+    long getPercentileUs(double fraction) {
+        long count = getCount();
+        long rank = (long) Math.ceil(count * fraction);
+        long seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += mCounts.get(i);
+            if (seen >= rank && seen > 0) {
+                return Math.min(bucketLimit(i), mMaxUs.get());
+            }
+        }
+        return 0;
+    }
+
+    void dump(PrintWriter pw, String name) {
+        long count = getCount();
+        if (count == 0) {
+            pw.println("  " + name + ": no samples");
+            return;
+        }
+        pw.println("  " + name + ": count=" + count
+                + " p50=" + getPercentileUs(0.5) + "us"
+                + " p99=" + getPercentileUs(0.99) + "us"
+                + " max=" + mMaxUs.get() + "us");
+    }
+}
@@ -0,0 +1,253 @@
+package com.android.server.temperature;
+
+import android.hardware.temperature.JdtsChannelStatistics;
+
+/**
+ * Running statistics of every channel over a sliding time window. A sample entering or
+ * leaving the window costs O(1) amortized: mean and variance follow Welford's update and
+ * its inverse, min and max come from monotonic deques, the slope from the running sums
+ * of a least squares fit. The window holds at most MAX_SAMPLES samples, past that the
+ * oldest leave early and the statistics cover a shorter span.
+ */
+final class WindowStatistics {
+    // the sensor channels and the compensated object temperature
+    static final int CHANNELS = 5;
+    static final int MAX_SAMPLES = 65536;
+
+    private static final int INITIAL_CAPACITY = 256;
+    // the regression sums are rebased once their time origin is this far behind
+    private static final long REBASE_NANOS = 3600L * 1000000000L;
+
+    final long mWindowNanos;
+    // when getStatistics() last asked for this window
+    long mLastUsedNanos;
+
+    // the samples in the window, sample number n at n % capacity; mFirst is the oldest
+    private long[] mTimes = new long[INITIAL_CAPACITY];
+    private int[][] mValues = new int[CHANNELS][INITIAL_CAPACITY];
+    private long mFirst;
+    private long mNext;
+
+    private final double[] mMean = new double[CHANNELS];
+    private final double[] mM2 = new double[CHANNELS];
+
+    // time in seconds from mOriginNanos, sums over the window
+    private long mOriginNanos;
+    private double mSumT;
+    private double mSumTT;
+    private final double[] mSumTX = new double[CHANNELS];
+
+    // sample numbers whose values decrease (max) or increase (min) from the front
+    private final SampleDeque[] mMax = new SampleDeque[CHANNELS];
+    private final SampleDeque[] mMin = new SampleDeque[CHANNELS];
+
+    // a deque of sample numbers, never longer than the window
+    private static final class SampleDeque {
+        long[] mItems = new long[INITIAL_CAPACITY];
+        int mHead;
+        int mSize;
+
+        boolean isEmpty() {
+            return mSize == 0;
+        }
+
+        long first() {
+            return mItems[mHead];
+        }
+
+        long last() {
+            return mItems[(mHead + mSize - 1) & (mItems.length - 1)];
+        }
+
+        void removeFirst() {
+            mHead = (mHead + 1) & (mItems.length - 1);
+            mSize--;
+        }
+
+        void removeLast() {
+            mSize--;
+        }
+
+        void addLast(long item) {
+            if (mSize == mItems.length) {
+                long[] items = new long[mItems.length * 2];
+                for (int i = 0; i < mSize; i++) {
+                    items[i] = mItems[(mHead + i) & (mItems.length - 1)];
+                }
+                mItems = items;
+                mHead = 0;
+            }
+            mItems[(mHead + mSize) & (mItems.length - 1)] = item;
+            mSize++;
+        }
+    }
+
+    WindowStatistics(long windowNanos) {
+        mWindowNanos = windowNanos;
+        for (int ch = 0; ch < CHANNELS; ch++) {
+            mMax[ch] = new SampleDeque();
+            mMin[ch] = new SampleDeque();
+        }
+    }
+
+    int getCount() {
+        return (int) (mNext - mFirst);
+    }
+
+    void add(long timestampNanos, int object, int ntc1, int ntc2, int ntc3, int compensated) {
+        if (getCount() == MAX_SAMPLES) {
+            removeOldest();
+        } else if (getCount() == mTimes.length) {
+            grow();
+        }
+        if (getCount() == 0 || timestampNanos - mOriginNanos > REBASE_NANOS) {
+            rebase(timestampNanos);
+        }
+
+        long n = mNext++;
+        int index = (int) (n & (mTimes.length - 1));
+        mTimes[index] = timestampNanos;
+        mValues[0][index] = object;
+        mValues[1][index] = ntc1;
+        mValues[2][index] = ntc2;
+        mValues[3][index] = ntc3;
+        mValues[4][index] = compensated;
+
+        int count = getCount();
+        double t = seconds(timestampNanos);
+        mSumT += t;
+        mSumTT += t * t;
+        for (int ch = 0; ch < CHANNELS; ch++) {
+            int x = mValues[ch][index];
+            double delta = x - mMean[ch];
+            mMean[ch] += delta / count;
+            mM2[ch] += delta * (x - mMean[ch]);
+            mSumTX[ch] += t * x;
+
+            SampleDeque max = mMax[ch];
+            while (!max.isEmpty() && value(ch, max.last()) <= x) {
+                max.removeLast();
+            }
+            max.addLast(n);
+            SampleDeque min = mMin[ch];
+            while (!min.isEmpty() && value(ch, min.last()) >= x) {
+                min.removeLast();
+            }
+            min.addLast(n);
+        }
+
+        expire(timestampNanos);
+    }
+
+    // drops the samples older than the window ending at 'nowNanos'
+    void expire(long nowNanos) {
+        while (getCount() > 0 && nowNanos - mTimes[(int) (mFirst & (mTimes.length - 1))] >= mWindowNanos) {
+            removeOldest();
+        }
+    }
+
+    JdtsChannelStatistics get(int channel) {
+        JdtsChannelStatistics stats = new JdtsChannelStatistics();
+        int count = getCount();
+
+        stats.channel = channel;
+        stats.windowMs = (int) (mWindowNanos / 1000000);
+        stats.count = count;
+        if (count == 0) {
+            return stats;
+        }
+
+        stats.spanMs = (int) ((mTimes[(int) ((mNext - 1) & (mTimes.length - 1))]
+                - mTimes[(int) (mFirst & (mTimes.length - 1))]) / 1000000);
+        stats.mean = (float) mMean[channel];
+        stats.stddev = count > 1 ? (float) Math.sqrt(Math.max(0, mM2[channel]) / (count - 1)) : 0;
+        stats.min = value(channel, mMin[channel].first());
+        stats.max = value(channel, mMax[channel].first());
+
+        double denominator = count * mSumTT - mSumT * mSumT;
+        if (count > 1 && denominator > 0) {
+            double sumX = mMean[channel] * count;
+            stats.slope = (float) ((count * mSumTX[channel] - mSumT * sumX) / denominator);
+        }
+        return stats;
+    }
+
+    private int value(int channel, long n) {
+        return mValues[channel][(int) (n & (mTimes.length - 1))];
+    }
+
+    private double seconds(long timestampNanos) {
+        return (timestampNanos - mOriginNanos) / 1e9;
+    }
+
+    private void removeOldest() {
+        long n = mFirst++;
+        int index = (int) (n & (mTimes.length - 1));
+        int count = getCount();
+        double t = seconds(mTimes[index]);
+
+        mSumT -= t;
+        mSumTT -= t * t;
+        for (int ch = 0; ch < CHANNELS; ch++) {
+            int x = mValues[ch][index];
+            if (count == 0) {
+                mMean[ch] = 0;
+                mM2[ch] = 0;
+            } else {
+                double delta = x - mMean[ch];
+                mMean[ch] -= delta / count;
+                mM2[ch] -= delta * (x - mMean[ch]);
+            }
+            mSumTX[ch] -= t * x;
+
+            if (mMax[ch].first() == n) {
+                mMax[ch].removeFirst();
+            }
+            if (mMin[ch].first() == n) {
+                mMin[ch].removeFirst();
+            }
+        }
+        if (count == 0) {
+            mSumT = 0;
+            mSumTT = 0;
+            for (int ch = 0; ch < CHANNELS; ch++) {
+                mSumTX[ch] = 0;
+            }
+        }
+    }
+
+    // moves the time origin to keep the sums of t and t^2 small, O(window) once an hour
+    private void rebase(long originNanos) {
+        mOriginNanos = originNanos;
+        mSumT = 0;
+        mSumTT = 0;
+        for (int ch = 0; ch < CHANNELS; ch++) {
+            mSumTX[ch] = 0;
+        }
+        for (long n = mFirst; n < mNext; n++) {
+            int index = (int) (n & (mTimes.length - 1));
+            double t = seconds(mTimes[index]);
+            mSumT += t;
+            mSumTT += t * t;
+            for (int ch = 0; ch < CHANNELS; ch++) {
+                mSumTX[ch] += t * mValues[ch][index];
+            }
+        }
+    }
+
+    private void grow() {
+        int capacity = mTimes.length * 2;
+        long[] times = new long[capacity];
+        int[][] values = new int[CHANNELS][capacity];
+        for (long n = mFirst; n < mNext; n++) {
+            int from = (int) (n & (mTimes.length - 1));
+            int to = (int) (n & (capacity - 1));
+            times[to] = mTimes[from];
+            for (int ch = 0; ch < CHANNELS; ch++) {
+                values[ch][to] = mValues[ch][from];
+            }
+        }
+        mTimes = times;
+        mValues = values;
+    }
+}
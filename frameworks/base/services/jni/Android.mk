@@ -31,6 +31,7 @@ LOCAL_C_INCLUDES += \
     libcore/include/libsuspend \
 	$(call include-path-for, libhardware)/hardware \
 	$(call include-path-for, libhardware_legacy)/hardware_legacy \
+    hardware/libhardware/modules/techartms \
 
 LOCAL_SHARED_LIBRARIES := \
     libandroid_runtime \
@@ -53,6 +54,9 @@ LOCAL_SHARED_LIBRARIES := \
     libEGL \
     libGLESv2
 
+# the reader of JdtsService, shared with the host build of the HAL
+LOCAL_STATIC_LIBRARIES := libjdts_reader libjdts_common
+
 LOCAL_CFLAGS += -DEGL_EGLEXT_PROTOTYPES -DGL_GLEXT_PROTOTYPES
 
 ifeq ($(WITH_MALLOC_LEAK_CHECK),true)
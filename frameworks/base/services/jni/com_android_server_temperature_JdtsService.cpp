@@ -6,18 +6,103 @@
 
 #include <utils/misc.h>
 #include <utils/Log.h>
+#include <cutils/ashmem.h>
+#include <cutils/properties.h>
 #include <hardware/hardware.h>
 #include <hardware/sensor_jdts_temperature.h>
 
+#include "jdts_decode.h"
+#include "jdts_reader.h"
+
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace android
 {
+    // lets the service run against a simulated sensor, e.g. "sim:rate=100",
+    // empty for /dev/jdts_temperature
+    static const char* BACKEND_PROPERTY = "persist.jdts.backend";
+    // "0" turns the long-term sample history off
+    static const char* HISTORY_PROPERTY = "persist.jdts.history";
+    static const char* HISTORY_DIR = "/data/sensors/jdts";
+
+    // records the reader thread reads at once into the buffer of start_reader_native()
+    static const size_t READ_CHUNK = JDTS_READER_CHUNK;
+
+    // looked up once in register_android_server_JdtsService(), a sample is then
+    // a few field stores with no class lookups or allocations
+    static struct {
+        jclass clazz;
+        jfieldID sequence;
+        jfieldID timestampNanos;
+        jfieldID synchro;
+        jfieldID flags;
+        jfieldID objectTemperature;
+        jfieldID ntc1Temperature;
+        jfieldID ntc2Temperature;
+        jfieldID ntc3Temperature;
+        jfieldID filtered[TECHART_MS_JDTS_CHANNEL_COUNT];
+        jfieldID compensatedObjectTemperature;
+    } gJdtsTemperatureDataClassInfo;
+
+    // JdtsService.onSamples(ByteBuffer, int), called on the reader thread
+    static jmethodID gOnSamplesMethod;
+
+    // the context of the reader thread, see start_reader_native()
+    struct ReaderContext {
+        // global references, dropped by the thread when it exits
+        jobject service;
+        jobject buffer;
+        JNIEnv* env;
+    };
+
+    // the region of get_shared_memory_native(), only the reader thread writes it.
+    // Created once with the device and kept for the life of the process
+    static int gSharedFd = -1;
+
+    static void init_shared_memory()
+    {
+        int fd = ashmem_create_region("jdts_samples", TECHART_MS_JDTS_SHM_SIZE);
+        if (fd < 0) {
+            ALOGE("init_shared_memory: cannot create the region");
+            return;
+        }
+
+        void* addr = mmap(NULL, TECHART_MS_JDTS_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ALOGE("init_shared_memory: cannot map the region");
+            close(fd);
+            return;
+        }
+
+        techartms_jdts_shm_t* shm = (techartms_jdts_shm_t*)addr;
+        shm->magic = TECHART_MS_JDTS_SHM_MAGIC;
+        shm->version = TECHART_MS_JDTS_SHM_VERSION;
+        shm->record_size = TECHART_MS_JDTS_RECORD_SIZE;
+        shm->ring_size = TECHART_MS_JDTS_SHM_RING_SIZE;
+
+        // our mapping stays writable, the ones made from the fd handed out can only read
+        if (ashmem_set_prot_region(fd, PROT_READ) < 0) {
+            ALOGE("init_shared_memory: cannot make the region read-only");
+            munmap(addr, TECHART_MS_JDTS_SHM_SIZE);
+            close(fd);
+            return;
+        }
+
+        gSharedFd = fd;
+        jdts_reader_set_shared(shm);
+    }
+
     static jlong init_native(JNIEnv *env, jobject clazz)
     {
         int err;
         hw_module_t* module;
         techartms_jdts_device_t* dev = NULL;
+        char backend[PROPERTY_VALUE_MAX];
         
         // find the HAL
         // internal function checks several paths where HW modules can locate
@@ -25,16 +110,25 @@ namespace android
         // ".default" - it would be better to give it a more HW specific postfix, but who cares...
         err = hw_get_module(TECHART_MS_JDTS_HARDWARE_MODULE_ID, (hw_module_t const**)&module);
         if (err == 0) {
-            err = module->methods->open(module, "", ((hw_device_t**) &dev));
+            property_get(BACKEND_PROPERTY, backend, "");
+            err = module->methods->open(module, backend, ((hw_device_t**) &dev));
             if (err != 0) {
                 ALOGE("init_native: cannot open device module: %d", err);
-                return -1;
+                return 0;
+            }
+
+            char history[PROPERTY_VALUE_MAX];
+            property_get(HISTORY_PROPERTY, history, "1");
+            if (strcmp(history, "0") != 0 && dev->set_history(HISTORY_DIR) != 0) {
+                ALOGE("init_native: cannot open the sample history in %s", HISTORY_DIR);
             }
         } else {
             ALOGE("init_native: cannot get device module: %d", err);
             return 0;
         }
 
+        init_shared_memory();
+
         ALOGD("init_native: start ok");
         // this pointer is saved in Java part of the service to access other HAL functions
         return (jlong)dev;
@@ -49,67 +143,248 @@ namespace android
             return;
         }
 
-        free(dev);
+        // the reader thread may be blocked in a read of the device
+        jdts_reader_close();
+        if (dev->common.close != NULL) {
+            dev->common.close(&dev->common);
+        } else {
+            free(dev);
+        }
         ALOGD("finalize_native: finalized ok");
     }
 
+    // layout of the long[] filled by get_read_stats_native(), see JdtsService.java
+    enum {
+        READ_STAT_READS = 0,
+        READ_STAT_ERRORS,
+        READ_STAT_SAMPLES,
+        READ_STAT_MAX_US,
+        READ_STAT_COUNT
+    };
+
     // read the data from HAL here
-    // the return type is newly created JdtsTemperatureData
-    static jobject read_sample_native(JNIEnv *env, jobject clazz, jlong ptr)
+    // the sample is stored into the caller's JdtsTemperatureData
+    static jboolean read_sample_into_native(JNIEnv *env, jobject clazz, jlong ptr, jobject data)
     {
         techartms_jdts_device_t* dev = (techartms_jdts_device_t*)ptr;
-        int ret = 0;
+        techartms_jdts_batch_t* batch;
+        int ret;
+
+        if (dev == NULL) {
+            ALOGE("read_sample_into_native: invalid device pointer");
+            return JNI_FALSE;
+        }
+        if (data == NULL) {
+            jniThrowNullPointerException(env, "data");
+            return JNI_FALSE;
+        }
 
-        unsigned short synchro = 0;
-        short obj_temp = 0;
-        short ntc1_temp = 0;
-        short ntc2_temp = 0;
-        short ntc3_temp = 0;
+        batch = jdts_batch_alloc(1);
+        if (batch == NULL) {
+            jniThrowException(env, "java/lang/OutOfMemoryError", "sample batch");
+            return JNI_FALSE;
+        }
+        ret = jdts_reader_read(dev, batch, 1);
+        if (ret < 1) {
+            if (ret < 0) {
+                ALOGE("read_sample_into_native: Cannot read JdtsTemperatureData");
+            }
+            jdts_batch_free(batch);
+            return JNI_FALSE;
+        }
+
+        env->SetLongField(data, gJdtsTemperatureDataClassInfo.sequence, (jlong)batch->sequence[0]);
+        env->SetLongField(data, gJdtsTemperatureDataClassInfo.timestampNanos, batch->timestamp_ns[0]);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.synchro, batch->synchro[0]);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.flags, batch->flags[0]);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.objectTemperature,
+                batch->value[TECHART_MS_JDTS_CHANNEL_OBJ][0]);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.ntc1Temperature,
+                batch->value[TECHART_MS_JDTS_CHANNEL_NTC1][0]);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.ntc2Temperature,
+                batch->value[TECHART_MS_JDTS_CHANNEL_NTC2][0]);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.ntc3Temperature,
+                batch->value[TECHART_MS_JDTS_CHANNEL_NTC3][0]);
+        for (int ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            env->SetIntField(data, gJdtsTemperatureDataClassInfo.filtered[ch], batch->filtered[ch][0]);
+        }
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.compensatedObjectTemperature, batch->compensated[0]);
+        jdts_batch_free(batch);
+        return JNI_TRUE;
+    }
+
+    static void reader_thread_start(void* cookie)
+    {
+        ReaderContext* context = (ReaderContext*)cookie;
+        JavaVMAttachArgs args = { JNI_VERSION_1_4, "JdtsReader", NULL };
+
+        // attached once for the lifetime of the thread, a callback is then a plain method call
+        if (AndroidRuntime::getJavaVM()->AttachCurrentThread(&context->env, &args) != JNI_OK) {
+            ALOGE("reader_thread_start: cannot attach to the VM");
+            context->env = NULL;
+        }
+    }
+
+    static void reader_samples(void* cookie, size_t count)
+    {
+        ReaderContext* context = (ReaderContext*)cookie;
+        JNIEnv* env = context->env;
+
+        if (env == NULL) {
+            return;
+        }
+        env->CallVoidMethod(context->service, gOnSamplesMethod, context->buffer, (jint)count);
+        if (env->ExceptionCheck()) {
+            ALOGE("reader_samples: exception thrown by JdtsService.onSamples()");
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+        }
+    }
+
+    static void reader_thread_stop(void* cookie)
+    {
+        ReaderContext* context = (ReaderContext*)cookie;
+
+        if (context->env != NULL) {
+            context->env->DeleteGlobalRef(context->service);
+            context->env->DeleteGlobalRef(context->buffer);
+            AndroidRuntime::getJavaVM()->DetachCurrentThread();
+        }
+        delete context;
+    }
+
+    static const jdts_reader_callbacks_t gReaderCallbacks = {
+        reader_thread_start,
+        reader_thread_stop,
+        reader_samples,
+    };
+
+    // starts a thread which reads the HAL and passes every batch of new samples to
+    // service.onSamples(buffer, count), packed at the start of 'buffer'. The buffer is
+    // direct and holds at least READ_CHUNK records. The thread is paused rather than ended
+    // by stop_reader_native(), a later start resumes it with the buffer and service it was
+    // started with, it owns them until close_reader_native()
+    static jboolean start_reader_native(JNIEnv *env, jobject clazz, jlong ptr, jobject service, jobject buffer)
+    {
+        techartms_jdts_device_t* dev = (techartms_jdts_device_t*)ptr;
 
         if (dev == NULL) {
-            ALOGE("read_sample_native: invalid device pointer");
-            return (jobject)NULL;
+            ALOGE("start_reader_native: invalid device pointer");
+            return JNI_FALSE;
+        }
+        if (service == NULL || buffer == NULL) {
+            jniThrowNullPointerException(env, service == NULL ? "service" : "buffer");
+            return JNI_FALSE;
         }
 
-        ret = dev->read_sample(&synchro, &obj_temp, &ntc1_temp, &ntc2_temp, &ntc3_temp);
-        if (ret < 0) {
-            ALOGE("read_sample_native: Cannot read JdtsTemperatureData");
-            return (jobject)NULL;
+        uint8_t* records = (uint8_t*)env->GetDirectBufferAddress(buffer);
+        if (records == NULL ||
+                env->GetDirectBufferCapacity(buffer) < (jlong)(READ_CHUNK * TECHART_MS_JDTS_RECORD_SIZE)) {
+            jniThrowException(env, "java/lang/IllegalArgumentException", "buffer is not direct or too small");
+            return JNI_FALSE;
         }
 
-        jclass c = env->FindClass("android/hardware/temperature/JdtsTemperatureData");
-        if (c == 0) {
-            ALOGE("read_sample_native: Find Class JdtsTemperatureData Failed");
-            return (jobject)NULL;
+        ReaderContext* context = new ReaderContext;
+        context->service = env->NewGlobalRef(service);
+        context->buffer = env->NewGlobalRef(buffer);
+        context->env = NULL;
+
+        int err = jdts_reader_start(dev, &gReaderCallbacks, context, (techartms_jdts_record_t*)records);
+        if (err != 0) {
+            env->DeleteGlobalRef(context->service);
+            env->DeleteGlobalRef(context->buffer);
+            delete context;
         }
+        if (err != 0 && err != -EALREADY) {
+            ALOGE("start_reader_native: cannot start the reader thread: %d", err);
+            return JNI_FALSE;
+        }
+        return JNI_TRUE;
+    }
 
-        jmethodID cnstrctr = env->GetMethodID(c, "<init>", "()V");
-        if (cnstrctr == 0) {
-            ALOGE("read_sample_native: Find constructor JdtsTemperatureData Failed");
-            return (jobject)NULL;
+    // a paced reader reads one sample at a time, see jdts_reader_set_period(): burst mode
+    // measures on such reads only
+    static void set_reader_period_native(JNIEnv *env, jobject clazz, jlong ptr, jint period_us)
+    {
+        jdts_reader_set_period(period_us);
+    }
+
+    // pauses the thread without waiting for it, its blocked read is cancelled. The samples
+    // it has read already are still passed to onSamples(), which may then be called after this
+    static void stop_reader_native(JNIEnv *env, jobject clazz, jlong ptr)
+    {
+        jdts_reader_stop();
+    }
+
+    // ends the thread and waits for it, which drops its references to the service and
+    // the buffer. It must not be called with a lock onSamples() may wait for
+    static void close_reader_native(JNIEnv *env, jobject clazz, jlong ptr)
+    {
+        jdts_reader_close();
+    }
+
+    // the fd of the shared sample region, owned by the native part, or -1
+    static jint get_shared_memory_native(JNIEnv *env, jobject clazz, jlong ptr)
+    {
+        return gSharedFd;
+    }
+
+    // takes over the write end of a pipe, see jdts_reader_add_stream()
+    static jboolean add_stream_native(JNIEnv *env, jobject clazz, jlong ptr, jint fd, jlong period_ns)
+    {
+        return jdts_reader_add_stream(fd, period_ns) == 0 ? JNI_TRUE : JNI_FALSE;
+    }
+
+    static jint get_stream_count_native(JNIEnv *env, jobject clazz, jlong ptr)
+    {
+        return jdts_reader_get_stream_count();
+    }
+
+    // copies the jdts_reader_read() counters (READ_STAT_*) and latency histogram
+    static void get_read_stats_native(JNIEnv *env, jobject clazz, jlong ptr, jlongArray counters,
+            jlongArray histogram)
+    {
+        jdts_reader_stats_t stats;
+        jlong values[READ_STAT_COUNT];
+        jlong buckets[JDTS_READER_LATENCY_BUCKETS];
+
+        if (counters == NULL || histogram == NULL) {
+            jniThrowNullPointerException(env, counters == NULL ? "counters" : "histogram");
+            return;
+        }
+        if (env->GetArrayLength(counters) < READ_STAT_COUNT ||
+                env->GetArrayLength(histogram) < JDTS_READER_LATENCY_BUCKETS) {
+            jniThrowException(env, "java/lang/IllegalArgumentException", "arrays are too short");
+            return;
         }
 
-        jfieldID synchroField = env->GetFieldID(c, "synchro", "I");
-        jfieldID objTempField = env->GetFieldID(c, "objectTemperature", "I");
-        jfieldID ntc1TempField = env->GetFieldID(c, "ntc1Temperature", "I");
-        jfieldID ntc2TempField = env->GetFieldID(c, "ntc2Temperature", "I");
-        jfieldID ntc3TempField = env->GetFieldID(c, "ntc3Temperature", "I");
-        if (synchroField == 0 || objTempField == 0 ||
-            ntc1TempField == 0 || ntc2TempField == 0 || ntc3TempField == 0) {
-            ALOGE("read_sample_native: cannot get fields of resulting object");
-            return (jobject)NULL;
+        jdts_reader_get_stats(&stats);
+        values[READ_STAT_READS] = (jlong)stats.reads;
+        values[READ_STAT_ERRORS] = (jlong)stats.errors;
+        values[READ_STAT_SAMPLES] = (jlong)stats.samples;
+        values[READ_STAT_MAX_US] = (jlong)stats.max_us;
+        for (int i = 0; i < JDTS_READER_LATENCY_BUCKETS; i++) {
+            buckets[i] = (jlong)stats.latency[i];
         }
+        env->SetLongArrayRegion(counters, 0, READ_STAT_COUNT, values);
+        env->SetLongArrayRegion(histogram, 0, JDTS_READER_LATENCY_BUCKETS, buckets);
+    }
 
-        jobject jdtsData = env->NewObject(c, cnstrctr);
+    // fills 'out' with a (period_ns, written, dropped) triple per stream, returns their count
+    static jint get_stream_stats_native(JNIEnv *env, jobject clazz, jlong ptr, jlongArray out)
+    {
+        if (out == NULL) {
+            jniThrowNullPointerException(env, "out");
+            return 0;
+        }
 
-        env->SetIntField(jdtsData, synchroField, (jint)synchro);
-        env->SetIntField(jdtsData, objTempField, (jint)obj_temp);
-        env->SetIntField(jdtsData, ntc1TempField, (jint)ntc1_temp);
-        env->SetIntField(jdtsData, ntc2TempField, (jint)ntc2_temp);
-        env->SetIntField(jdtsData, ntc3TempField, (jint)ntc3_temp);
+        jsize capacity = env->GetArrayLength(out) / 3;
+        jlong* values = new jlong[capacity * 3 + 1];
+        jint count = jdts_reader_get_stream_stats((int64_t*)values, capacity);
 
-        ALOGD("read_sample_native: read ok");
-        return jdtsData;
+        env->SetLongArrayRegion(out, 0, count * 3, values);
+        delete[] values;
+        return count;
     }
 
     static jboolean activate_native(JNIEnv *env, jobject clazz, jlong ptr, jboolean enabled)
@@ -148,24 +423,243 @@ namespace android
         return JNI_TRUE;
     }
 
+    static jboolean set_filter_native(JNIEnv *env, jobject clazz, jlong ptr, jint channel, jint type,
+            jfloat alpha, jfloat process_noise, jfloat measurement_noise)
+    {
+        techartms_jdts_device_t* dev = (techartms_jdts_device_t*)ptr;
+        if (dev == NULL || dev->set_filter == NULL) {
+            ALOGE("set_filter_native: no filter stage in the HAL");
+            return JNI_FALSE;
+        }
+
+        techartms_jdts_filter_t filter;
+        filter.type = type;
+        filter.alpha = alpha;
+        filter.process_noise = process_noise;
+        filter.measurement_noise = measurement_noise;
+        return dev->set_filter(channel, &filter) == 0 ? JNI_TRUE : JNI_FALSE;
+    }
+
+    // the samples of query_history_native(), collected before they are copied out at once
+    struct HistoryQuery {
+        techartms_jdts_history_sample_t* samples;
+        size_t count;
+        size_t max_count;
+    };
+
+    static int collect_history(void* cookie, const techartms_jdts_history_sample_t* sample)
+    {
+        HistoryQuery* query = (HistoryQuery*)cookie;
+        query->samples[query->count++] = *sample;
+        return query->count == query->max_count;
+    }
+
+    // the history samples with from_ms <= time < to_ms, at most as many as 'sequences'
+    // holds, TECHART_MS_JDTS_CHANNEL_COUNT temperatures per sample in 'temperatures'.
+    // Returns their count or -1 when there is no history
+    static jint query_history_native(JNIEnv *env, jobject clazz, jlong ptr, jlong from_ms, jlong to_ms,
+            jlongArray sequences, jlongArray times, jintArray temperatures)
+    {
+        techartms_jdts_device_t* dev = (techartms_jdts_device_t*)ptr;
+        if (dev == NULL || dev->query_history == NULL) {
+            ALOGE("query_history_native: no history in the HAL");
+            return -1;
+        }
+        if (sequences == NULL || times == NULL || temperatures == NULL) {
+            jniThrowNullPointerException(env, "arrays");
+            return -1;
+        }
+
+        HistoryQuery query;
+        query.max_count = env->GetArrayLength(sequences);
+        if (env->GetArrayLength(times) < (jsize)query.max_count ||
+                env->GetArrayLength(temperatures) < (jsize)(query.max_count * TECHART_MS_JDTS_CHANNEL_COUNT)) {
+            jniThrowException(env, "java/lang/IllegalArgumentException", "arrays are too short");
+            return -1;
+        }
+        if (query.max_count == 0) {
+            return 0;
+        }
+        query.samples = new techartms_jdts_history_sample_t[query.max_count];
+        query.count = 0;
+
+        if (dev->query_history(from_ms, to_ms, collect_history, &query) < 0) {
+            delete[] query.samples;
+            return -1;
+        }
+
+        jlong* columns = new jlong[query.count + 1];
+        for (size_t i = 0; i < query.count; i++) {
+            columns[i] = (jlong)query.samples[i].sequence;
+        }
+        env->SetLongArrayRegion(sequences, 0, query.count, columns);
+        for (size_t i = 0; i < query.count; i++) {
+            columns[i] = query.samples[i].time_ms;
+        }
+        env->SetLongArrayRegion(times, 0, query.count, columns);
+        delete[] columns;
+
+        jint* values = new jint[query.count * TECHART_MS_JDTS_CHANNEL_COUNT + 1];
+        for (size_t i = 0; i < query.count; i++) {
+            for (int ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+                values[i * TECHART_MS_JDTS_CHANNEL_COUNT + ch] = query.samples[i].value[ch];
+            }
+        }
+        env->SetIntArrayRegion(temperatures, 0, query.count * TECHART_MS_JDTS_CHANNEL_COUNT, values);
+        delete[] values;
+
+        delete[] query.samples;
+        return query.count;
+    }
+
+    // layout of the arrays filled by query_rollups_native(), per rollup, see JdtsService.java
+    enum {
+        ROLLUP_START_MS = 0,
+        ROLLUP_DURATION_MS,
+        ROLLUP_TIMES
+    };
+    enum {
+        ROLLUP_COUNT = 0,
+        ROLLUP_MIN,     // TECHART_MS_JDTS_CHANNEL_COUNT of them, then as many maxima
+        ROLLUP_VALUES = ROLLUP_MIN + 2 * TECHART_MS_JDTS_CHANNEL_COUNT
+    };
+
+    // the rollups of query_rollups(), at most as many as 'times' holds, with
+    // TECHART_MS_JDTS_CHANNEL_COUNT means each in 'means'. Returns their count or -1
+    static jint query_rollups_native(JNIEnv *env, jobject clazz, jlong ptr, jlong from_ms, jlong to_ms,
+            jlong resolution_ms, jlongArray times, jintArray values, jfloatArray means)
+    {
+        techartms_jdts_device_t* dev = (techartms_jdts_device_t*)ptr;
+        if (dev == NULL || dev->query_rollups == NULL) {
+            ALOGE("query_rollups_native: no rollups in the HAL");
+            return -1;
+        }
+        if (times == NULL || values == NULL || means == NULL) {
+            jniThrowNullPointerException(env, "arrays");
+            return -1;
+        }
+
+        size_t max_count = env->GetArrayLength(times) / ROLLUP_TIMES;
+        if (env->GetArrayLength(values) < (jsize)(max_count * ROLLUP_VALUES) ||
+                env->GetArrayLength(means) < (jsize)(max_count * TECHART_MS_JDTS_CHANNEL_COUNT)) {
+            jniThrowException(env, "java/lang/IllegalArgumentException", "arrays are too short");
+            return -1;
+        }
+        if (max_count == 0) {
+            return 0;
+        }
+
+        techartms_jdts_rollup_t* rollups = new techartms_jdts_rollup_t[max_count];
+        int count = dev->query_rollups(from_ms, to_ms, resolution_ms, rollups, max_count);
+        if (count <= 0) {
+            delete[] rollups;
+            return count;
+        }
+
+        jlong* out_times = new jlong[count * ROLLUP_TIMES];
+        jint* out_values = new jint[count * ROLLUP_VALUES];
+        jfloat* out_means = new jfloat[count * TECHART_MS_JDTS_CHANNEL_COUNT];
+        for (int i = 0; i < count; i++) {
+            out_times[i * ROLLUP_TIMES + ROLLUP_START_MS] = rollups[i].start_ms;
+            out_times[i * ROLLUP_TIMES + ROLLUP_DURATION_MS] = rollups[i].duration_ms;
+            out_values[i * ROLLUP_VALUES + ROLLUP_COUNT] = (jint)rollups[i].count;
+            for (int ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+                out_values[i * ROLLUP_VALUES + ROLLUP_MIN + ch] = rollups[i].min[ch];
+                out_values[i * ROLLUP_VALUES + ROLLUP_MIN + TECHART_MS_JDTS_CHANNEL_COUNT + ch] =
+                        rollups[i].max[ch];
+                out_means[i * TECHART_MS_JDTS_CHANNEL_COUNT + ch] = rollups[i].mean[ch];
+            }
+        }
+        env->SetLongArrayRegion(times, 0, count * ROLLUP_TIMES, out_times);
+        env->SetIntArrayRegion(values, 0, count * ROLLUP_VALUES, out_values);
+        env->SetFloatArrayRegion(means, 0, count * TECHART_MS_JDTS_CHANNEL_COUNT, out_means);
+        delete[] out_times;
+        delete[] out_values;
+        delete[] out_means;
+
+        delete[] rollups;
+        return count;
+    }
+
     static JNINativeMethod method_table[] = {
         { "init_native", "()J", (void*)init_native },
         { "finalize_native", "(J)V", (void*)finalize_native },
-        { "read_sample_native", "(J)Landroid/hardware/temperature/JdtsTemperatureData;", (void*)read_sample_native },
+        { "read_sample_into_native", "(JLandroid/hardware/temperature/JdtsTemperatureData;)Z", (void*)read_sample_into_native },
+        { "start_reader_native", "(JLcom/android/server/temperature/JdtsService;Ljava/nio/ByteBuffer;)Z",
+                (void*)start_reader_native },
+        { "stop_reader_native", "(J)V", (void*)stop_reader_native },
+        { "close_reader_native", "(J)V", (void*)close_reader_native },
+        { "set_reader_period_native", "(JI)V", (void*)set_reader_period_native },
+        { "get_shared_memory_native", "(J)I", (void*)get_shared_memory_native },
+        { "add_stream_native", "(JIJ)Z", (void*)add_stream_native },
+        { "get_stream_count_native", "(J)I", (void*)get_stream_count_native },
+        { "get_read_stats_native", "(J[J[J)V", (void*)get_read_stats_native },
+        { "set_filter_native", "(JIIFFF)Z", (void*)set_filter_native },
+        { "get_stream_stats_native", "(J[J)I", (void*)get_stream_stats_native },
         { "activate_native", "(JZ)Z", (void*)activate_native },
         { "set_mode_native", "(JZ)Z", (void*)set_mode_native},
+        { "query_history_native", "(JJJ[J[J[I)I", (void*)query_history_native },
+        { "query_rollups_native", "(JJJJ[J[I[F)I", (void*)query_rollups_native },
     };
 
+#define FIND_CLASS(var, className) \
+        var = env->FindClass(className); \
+        LOG_FATAL_IF(! var, "Unable to find class " className);
+
+#define GET_FIELD_ID(var, clazz, fieldName, fieldDescriptor) \
+        var = env->GetFieldID(clazz, fieldName, fieldDescriptor); \
+        LOG_FATAL_IF(! var, "Unable to find field " fieldName);
+
     // this function is called from onload.cpp, 
     // which in turn is called when system service starts
     int register_android_server_JdtsService(JNIEnv *env)
     {
         ALOGD("register_android_server_JdtsService");
 
-        return jniRegisterNativeMethods(
+        int res = jniRegisterNativeMethods(
             env, 
             "com/android/server/temperature/JdtsService",
             method_table,
             NELEM(method_table));
+        LOG_FATAL_IF(res < 0, "Unable to register native methods.");
+
+        jclass clazz;
+        FIND_CLASS(clazz, "android/hardware/temperature/JdtsTemperatureData");
+        gJdtsTemperatureDataClassInfo.clazz = jclass(env->NewGlobalRef(clazz));
+        env->DeleteLocalRef(clazz);
+
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.sequence, gJdtsTemperatureDataClassInfo.clazz,
+                "sequence", "J");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.timestampNanos, gJdtsTemperatureDataClassInfo.clazz,
+                "timestampNanos", "J");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.synchro, gJdtsTemperatureDataClassInfo.clazz,
+                "synchro", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.flags, gJdtsTemperatureDataClassInfo.clazz,
+                "flags", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.objectTemperature, gJdtsTemperatureDataClassInfo.clazz,
+                "objectTemperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.ntc1Temperature, gJdtsTemperatureDataClassInfo.clazz,
+                "ntc1Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.ntc2Temperature, gJdtsTemperatureDataClassInfo.clazz,
+                "ntc2Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.ntc3Temperature, gJdtsTemperatureDataClassInfo.clazz,
+                "ntc3Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.filtered[TECHART_MS_JDTS_CHANNEL_OBJ],
+                gJdtsTemperatureDataClassInfo.clazz, "filteredObjectTemperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.filtered[TECHART_MS_JDTS_CHANNEL_NTC1],
+                gJdtsTemperatureDataClassInfo.clazz, "filteredNtc1Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.filtered[TECHART_MS_JDTS_CHANNEL_NTC2],
+                gJdtsTemperatureDataClassInfo.clazz, "filteredNtc2Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.filtered[TECHART_MS_JDTS_CHANNEL_NTC3],
+                gJdtsTemperatureDataClassInfo.clazz, "filteredNtc3Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.compensatedObjectTemperature, gJdtsTemperatureDataClassInfo.clazz,
+                "compensatedObjectTemperature", "I");
+
+        FIND_CLASS(clazz, "com/android/server/temperature/JdtsService");
+        gOnSamplesMethod = env->GetMethodID(clazz, "onSamples", "(Ljava/nio/ByteBuffer;I)V");
+        LOG_FATAL_IF(! gOnSamplesMethod, "Unable to find method onSamples");
+        env->DeleteLocalRef(clazz);
+
+        return res;
     };
 };
\ No newline at end of file
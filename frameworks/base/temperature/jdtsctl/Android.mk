@@ -0,0 +1,25 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+# streams, records and measures the JDTS samples from adb shell,
+# see the comment at the top of jdtsctl.c
+LOCAL_SRC_FILES:= \
+    jdtsctl.c
+
+LOCAL_C_INCLUDES += \
+    $(call include-path-for, libhardware) \
+    frameworks/base/temperature/jdtsd \
+    kernel/tegra/drivers/thermal
+
+LOCAL_STATIC_LIBRARIES := \
+    libjdts_common
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libhardware \
+    liblog
+
+LOCAL_MODULE:= jdtsctl
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
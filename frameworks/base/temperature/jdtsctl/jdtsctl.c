@@ -0,0 +1,777 @@
+/*
+ * Command line access to the JDTS sensor path, to look at it from adb shell:
+ *
+ * jdtsctl stream [-r | -s] [-b backend] [-n count] [-p period_ms] [-a]
+ * jdtsctl record [-b backend] [-n count] [-t seconds] [-a] <file>
+ * jdtsctl stats
+ * jdtsctl selftest [-r | -s] [-b backend] [-t seconds] [-a]
+ *
+ * stream    prints the samples as they are read, as fast as the sensor gives them
+ * record    writes a capture of the raw frames, replayable with the "replay:file=<path>" backend
+ * stats     prints the counters of jdtsd and the time spent in each stage of its HAL
+ * selftest  reads for a while and reports the samples/s, the cost of a read call and
+ *           the samples lost
+ *
+ * -r  raw frames straight from /dev/jdts_temperature, no HAL: values are not calibrated.
+ *     The driver FIFO only fills in continuous mode, so the run votes for it
+ * -s  through jdtsd rather than through a HAL opened by jdtsctl itself
+ * -b  backend passed to the HAL's open(), persist.jdts.backend by default
+ * -n  stops after this many samples
+ * -p  with -s, one sample per period
+ * -t  stops after this many seconds, 5 by default for selftest
+ * -a  votes for the sensor to be awake in continuous mode for the run. The votes go with
+ *     the run, the sensor then gets back to what the other users ask of it
+ *
+ * The device and the jdtsd socket belong to system: run it as root or system.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <cutils/sockets.h>
+#include <hardware/hardware.h>
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_decode.h"
+#include "jdts_temperature.h"
+#include "jdtsd_protocol.h"
+
+#define DEVICE_PATH         "/dev/jdts_temperature"
+#define BACKEND_PROPERTY    "persist.jdts.backend"
+
+// samples asked for by a read of the HAL or the driver, a jdtsd packet holds more
+#define READ_CHUNK          64
+#define READ_BUFFER         (READ_CHUNK > JDTSD_MAX_RECORDS ? READ_CHUNK : JDTSD_MAX_RECORDS)
+// the calls whose latency is kept by selftest, the later ones are only counted
+#define MAX_LATENCIES       (1 << 18)
+#define SELFTEST_SECONDS    5
+
+enum {
+    SOURCE_HAL = 0,
+    SOURCE_RAW,
+    SOURCE_JDTSD
+};
+
+static const char *source_names[] = { "hal", "raw", "jdtsd" };
+
+struct options {
+    int source;
+    const char *backend;    // NULL for the property
+    uint64_t count;         // 0 for no limit
+    uint32_t period_us;
+    int seconds;            // 0 for no limit
+    int wake;
+};
+
+struct source {
+    int type;
+    struct techartms_jdts_device_t *dev;
+    int fd;
+    struct jdts_decoder_t decoder;
+    struct techartms_jdts_batch_t *batch;
+    uint32_t token;
+    uint64_t dropped;       // reported by jdtsd
+};
+
+union packet {
+    struct jdtsd_header_t header;
+    uint64_t align;
+    uint8_t bytes[JDTSD_MAX_PACKET];
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void print_latencies(const char *title, int64_t *latencies, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    qsort(latencies, count, sizeof(*latencies), compare_int64);
+    printf("%-14s p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", title,
+            latencies[count / 2] / 1000.0,
+            latencies[count * 99 / 100] / 1000.0,
+            latencies[count - 1] / 1000.0);
+}
+
+static void print_stages(const struct techartms_jdts_stage_stats_t *stats, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        printf("stage %-10s %10llu batches  %8.1f ns/sample  max %8.1f us/batch  %llu errors\n",
+                stats[i].name, (unsigned long long)stats[i].batches,
+                stats[i].samples > 0 ? (double)stats[i].total_ns / stats[i].samples : 0.0,
+                stats[i].max_ns / 1e3, (unsigned long long)stats[i].errors);
+    }
+}
+
+// SIGINT stops a command cleanly, SIGALRM ends a timed one. Neither restarts the
+// call it interrupts, so a read blocked on a silent sensor returns
+static void setup_signals(int seconds)
+{
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGALRM, &action, NULL);
+    if (seconds > 0) {
+        alarm((unsigned int)seconds);
+    }
+}
+
+// sends a request to jdtsd and waits for its reply, samples coming in between are skipped.
+// Returns the size of the reply or -errno
+static int request(struct source *src, void *message, size_t size, union packet *reply)
+{
+    struct jdtsd_header_t *header = (struct jdtsd_header_t *)message;
+    ssize_t ret;
+
+    header->token = ++src->token;
+    if (send(src->fd, message, size, MSG_NOSIGNAL) < 0) {
+        return -errno;
+    }
+    for (;;) {
+        ret = recv(src->fd, reply, sizeof(*reply), 0);
+        if (ret < 0 && errno == EINTR && !stopping) {
+            continue;
+        }
+        if (ret <= 0) {
+            return ret < 0 ? -errno : -ECONNRESET;
+        }
+        if ((size_t)ret >= sizeof(reply->header) && reply->header.token == header->token) {
+            return (int)ret;
+        }
+    }
+}
+
+// for the requests answered by JDTSD_MSG_STATUS, returns the status
+static int request_status(struct source *src, void *message, size_t size)
+{
+    union packet reply;
+    int ret = request(src, message, size, &reply);
+
+    if (ret < 0) {
+        return ret;
+    }
+    if (reply.header.type != JDTSD_MSG_STATUS || (size_t)ret < sizeof(struct jdtsd_status_t)) {
+        return -EPROTO;
+    }
+    return ((struct jdtsd_status_t *)&reply)->status;
+}
+
+static int request_set(struct source *src, uint16_t type, int32_t value)
+{
+    struct jdtsd_set_t set;
+
+    memset(&set, 0, sizeof(set));
+    set.header.type = type;
+    set.value = value;
+    return request_status(src, &set, sizeof(set));
+}
+
+static int write_command(int fd, uint8_t type, uint8_t arg)
+{
+    uint8_t command[2] = { type, arg };
+
+    return write(fd, command, sizeof(command)) < 0 ? -errno : 0;
+}
+
+static int connect_jdtsd(struct source *src)
+{
+    struct jdtsd_hello_t hello;
+    union packet reply;
+    int ret;
+
+    src->fd = socket_local_client(JDTSD_SOCKET_NAME, ANDROID_SOCKET_NAMESPACE_RESERVED, SOCK_SEQPACKET);
+    if (src->fd < 0) {
+        fprintf(stderr, "cannot connect to jdtsd: %s\n", strerror(errno));
+        return -1;
+    }
+
+    memset(&hello, 0, sizeof(hello));
+    hello.header.type = JDTSD_MSG_HELLO;
+    hello.version = JDTSD_PROTOCOL_VERSION;
+    hello.record_size = TECHART_MS_JDTS_RECORD_SIZE;
+    ret = request(src, &hello, sizeof(hello), &reply);
+    if (ret < (int)sizeof(hello) || reply.header.type != JDTSD_MSG_HELLO) {
+        fprintf(stderr, "jdtsd does not answer\n");
+        return -1;
+    }
+    if (((struct jdtsd_hello_t *)&reply)->version != JDTSD_PROTOCOL_VERSION ||
+            ((struct jdtsd_hello_t *)&reply)->record_size != TECHART_MS_JDTS_RECORD_SIZE) {
+        fprintf(stderr, "jdtsd speaks protocol %u with records of %u bytes, expected %u and %u\n",
+                ((struct jdtsd_hello_t *)&reply)->version, ((struct jdtsd_hello_t *)&reply)->record_size,
+                JDTSD_PROTOCOL_VERSION, TECHART_MS_JDTS_RECORD_SIZE);
+        return -1;
+    }
+    return 0;
+}
+
+static int open_hal(struct source *src, const char *backend)
+{
+    const struct hw_module_t *module;
+    char property[PROPERTY_VALUE_MAX];
+    int err;
+
+    err = hw_get_module(TECHART_MS_JDTS_HARDWARE_MODULE_ID, &module);
+    if (err != 0) {
+        fprintf(stderr, "cannot get the HAL module: %d\n", err);
+        return -1;
+    }
+    if (backend == NULL) {
+        property_get(BACKEND_PROPERTY, property, "");
+        backend = property;
+    }
+    err = module->methods->open(module, backend, (struct hw_device_t **)&src->dev);
+    if (err != 0) {
+        fprintf(stderr, "cannot open the HAL with backend '%s': %d\n", backend, err);
+        src->dev = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// the votes of -a are not withdrawn: the driver drops them with the file and jdtsd
+// with the connection, and only then goes back to the votes of the others
+static void close_source(struct source *src)
+{
+    if (src->dev != NULL) {
+        src->dev->common.close(&src->dev->common);
+    }
+    if (src->fd >= 0) {
+        close(src->fd);
+    }
+    if (src->batch != NULL) {
+        jdts_batch_free(src->batch);
+    }
+    memset(src, 0, sizeof(*src));
+    src->fd = -1;
+}
+
+static int open_source(struct source *src, const struct options *options)
+{
+    struct jdtsd_subscribe_t subscribe;
+    int ret = 0;
+
+    memset(src, 0, sizeof(*src));
+    src->type = options->source;
+    src->fd = -1;
+
+    switch (src->type) {
+    case SOURCE_HAL:
+        ret = open_hal(src, options->backend);
+        break;
+    case SOURCE_RAW:
+        src->fd = open(DEVICE_PATH, O_RDWR);
+        if (src->fd < 0) {
+            fprintf(stderr, "cannot open %s: %s\n", DEVICE_PATH, strerror(errno));
+            ret = -1;
+            break;
+        }
+        // in burst mode the sensor only measures for a read of one frame, a read of
+        // the FIFO would then wait for ever
+        ret = write_command(src->fd, JDTS_CMD_TYPE_MEAS_MODE, JDTS_CMD_MEAS_MODE_CONT);
+        if (ret < 0) {
+            fprintf(stderr, "cannot set the continuous mode: %s\n", strerror(-ret));
+        }
+        // no calibration, the values are the sensor's
+        jdts_decoder_init(&src->decoder, NULL);
+        break;
+    case SOURCE_JDTSD:
+        ret = connect_jdtsd(src);
+        break;
+    }
+    if (ret == 0 && src->type != SOURCE_JDTSD) {
+        src->batch = jdts_batch_alloc(READ_CHUNK);
+        if (src->batch == NULL) {
+            fprintf(stderr, "cannot allocate a batch\n");
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && options->wake) {
+        // the mode first, so that the sensor wakes up in it
+        switch (src->type) {
+        case SOURCE_HAL:
+            ret = src->dev->set_mode(1) == 0 && src->dev->activate(1) == 0 ? 0 : -EIO;
+            break;
+        case SOURCE_RAW:
+            // the mode is already voted for
+            ret = write_command(src->fd, JDTS_CMD_TYPE_POWER, JDTS_CMD_POWER_WAKEUP);
+            break;
+        case SOURCE_JDTSD:
+            ret = request_set(src, JDTSD_MSG_SET_MODE, 1);
+            if (ret == 0) {
+                ret = request_set(src, JDTSD_MSG_SET_POWER, 1);
+            }
+            break;
+        }
+        if (ret < 0) {
+            fprintf(stderr, "cannot wake the sensor up: %s\n", strerror(-ret));
+        }
+    }
+
+    if (ret == 0 && src->type == SOURCE_JDTSD) {
+        memset(&subscribe, 0, sizeof(subscribe));
+        subscribe.header.type = JDTSD_MSG_SUBSCRIBE;
+        subscribe.period_us = options->period_us;
+        ret = request_status(src, &subscribe, sizeof(subscribe));
+        if (ret < 0) {
+            fprintf(stderr, "cannot subscribe to jdtsd: %s\n", strerror(-ret));
+        }
+    }
+
+    if (ret < 0) {
+        close_source(src);
+        return -1;
+    }
+    return 0;
+}
+
+// waits for samples where the source can be polled, so that the following read
+// only costs the call itself. Returns 0 once there are samples or -1 if interrupted
+static int wait_source(struct source *src)
+{
+    struct pollfd pfd;
+
+    if (src->type == SOURCE_HAL) {
+        // the HAL waits inside read_samples()
+        return 0;
+    }
+
+    pfd.fd = src->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    while (poll(&pfd, 1, -1) < 0) {
+        if (errno != EINTR || stopping) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// reads the next samples into 'records', READ_BUFFER of them. Returns the number read,
+// 0 when interrupted or for a packet without samples, or -1 on an error
+static int read_source(struct source *src, struct techartms_jdts_record_t *records)
+{
+    uint8_t frames[READ_CHUNK * TECHART_MS_JDTS_FRAME_SIZE];
+    int64_t timestamps[READ_CHUNK];
+    union packet packet;
+    struct jdtsd_samples_t *samples = (struct jdtsd_samples_t *)&packet;
+    ssize_t ret;
+    size_t count;
+    size_t i;
+
+    switch (src->type) {
+    case SOURCE_HAL:
+        src->batch->count = 0;
+        ret = src->dev->read_samples(src->batch, READ_CHUNK);
+        if (ret < 0) {
+            return stopping ? 0 : -1;
+        }
+        break;
+
+    case SOURCE_RAW:
+        // a read of several frames gets the driver FIFO, see jdts_temperature.c
+        ret = read(src->fd, frames, sizeof(frames));
+        if (ret < 0) {
+            return errno == EINTR ? 0 : -1;
+        }
+        count = (size_t)ret / TECHART_MS_JDTS_FRAME_SIZE;
+        timestamps[0] = now_ns();
+        for (i = 1; i < count; i++) {
+            timestamps[i] = timestamps[0];
+        }
+        src->batch->count = 0;
+        ret = (ssize_t)jdts_decode_frames(&src->decoder, frames, timestamps, count, src->batch);
+        break;
+
+    default:
+        ret = recv(src->fd, &packet, sizeof(packet), 0);
+        if (ret < 0) {
+            return errno == EINTR ? 0 : -1;
+        }
+        if (ret == 0) {
+            errno = ECONNRESET;
+            return -1;
+        }
+        if (packet.header.type != JDTSD_MSG_SAMPLES || (size_t)ret < sizeof(*samples)) {
+            return 0;
+        }
+        count = samples->count < READ_BUFFER ? samples->count : READ_BUFFER;
+        memcpy(records, samples + 1, count * sizeof(*records));
+        src->dropped += samples->dropped;
+        return (int)count;
+    }
+
+    for (i = 0; i < (size_t)ret; i++) {
+        techartms_jdts_pack_record(&records[i], src->batch, i);
+    }
+    return (int)ret;
+}
+
+static void print_flags(uint16_t flags)
+{
+    static const char *names[] = { "rise", "fall", "outlier", "stuck", "ntc" };
+    size_t i;
+
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (flags & (1 << i)) {
+            printf(" %s", names[i]);
+        }
+    }
+}
+
+static int cmd_stream(const struct options *options)
+{
+    struct techartms_jdts_record_t records[READ_BUFFER];
+    struct source src;
+    uint64_t total = 0;
+    int64_t last_sequence = -1;
+    int ret = 0;
+    int count;
+    int i;
+
+    if (open_source(&src, options) < 0) {
+        return 1;
+    }
+    setup_signals(options->seconds);
+
+    if (src.type == SOURCE_RAW) {
+        printf("# sequence synchro      obj   ntc1   ntc2   ntc3   (0.01C, as read)\n");
+    } else {
+        printf("# sequence   timestamp_ns synchro      obj    ntc1    ntc2    ntc3    comp   flags\n");
+    }
+
+    while (!stopping && (options->count == 0 || total < options->count)) {
+        count = read_source(&src, records);
+        if (count < 0) {
+            fprintf(stderr, "read failed: %s\n", strerror(errno));
+            ret = 1;
+            break;
+        }
+
+        for (i = 0; i < count && (options->count == 0 || total < options->count); i++) {
+            const struct techartms_jdts_record_t *r = &records[i];
+
+            // skips a sample already printed, should the source hand it again
+            if (r->sequence <= last_sequence) {
+                continue;
+            }
+            last_sequence = r->sequence;
+            total++;
+
+            if (src.type == SOURCE_RAW) {
+                printf("%10lld %7u %8d %6d %6d %6d\n", (long long)r->sequence, r->synchro,
+                        r->value[0], r->value[1], r->value[2], r->value[3]);
+            } else {
+                printf("%10lld %14lld %7u %8.2f %7.2f %7.2f %7.2f %7.2f  0x%02x",
+                        (long long)r->sequence, (long long)r->timestamp_ns, r->synchro,
+                        r->value[0] / 100.0, r->value[1] / 100.0, r->value[2] / 100.0,
+                        r->value[3] / 100.0, r->compensated / 100.0, r->flags);
+                print_flags(r->flags);
+                printf("\n");
+            }
+        }
+    }
+
+    fflush(stdout);
+    if (src.dropped > 0) {
+        fprintf(stderr, "%llu samples dropped by jdtsd\n", (unsigned long long)src.dropped);
+    }
+    close_source(&src);
+    return ret;
+}
+
+static int cmd_record(const struct options *options, const char *path)
+{
+    struct techartms_jdts_record_t records[READ_BUFFER];
+    struct source src;
+    uint64_t total = 0;
+    int64_t start;
+    int ret = 0;
+    int count;
+
+    if (options->source != SOURCE_HAL) {
+        fprintf(stderr, "record reads through the HAL, -r and -s do not apply\n");
+        return 1;
+    }
+    if (open_source(&src, options) < 0) {
+        return 1;
+    }
+    if (src.dev->start_capture(path) != 0) {
+        fprintf(stderr, "cannot start a capture to %s\n", path);
+        close_source(&src);
+        return 1;
+    }
+    setup_signals(options->seconds);
+
+    // every frame the HAL reads goes to the capture, repeated ones included
+    start = now_ns();
+    while (!stopping && (options->count == 0 || total < options->count)) {
+        count = read_source(&src, records);
+        if (count < 0) {
+            fprintf(stderr, "read failed after %llu samples\n", (unsigned long long)total);
+            ret = 1;
+            break;
+        }
+        total += count;
+    }
+
+    src.dev->stop_capture();
+    printf("%llu samples in %.3f s recorded to %s\n", (unsigned long long)total,
+            (now_ns() - start) / 1e9, path);
+    close_source(&src);
+    return ret;
+}
+
+static int cmd_stats(void)
+{
+    struct jdtsd_header_t header;
+    union packet reply;
+    struct jdtsd_stats_t *stats = (struct jdtsd_stats_t *)&reply;
+    struct source src;
+    int ret;
+
+    memset(&src, 0, sizeof(src));
+    src.type = SOURCE_JDTSD;
+    src.fd = -1;
+    if (connect_jdtsd(&src) < 0) {
+        close_source(&src);
+        return 1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.type = JDTSD_MSG_GET_STATS;
+    ret = request(&src, &header, sizeof(header), &reply);
+    if (ret < (int)sizeof(*stats) || reply.header.type != JDTSD_MSG_STATS ||
+            (size_t)ret < sizeof(*stats) + stats->stage_count * sizeof(struct techartms_jdts_stage_stats_t)) {
+        fprintf(stderr, "jdtsd does not answer\n");
+        close_source(&src);
+        return 1;
+    }
+
+    // the driver keeps no counters of its own, selftest -r measures it
+    printf("jdtsd: %u clients, %u subscribers\n", stats->clients, stats->subscribers);
+    printf("reads  %10llu calls  %10llu errors  %12llu samples  %6.1f samples/call\n",
+            (unsigned long long)stats->reads, (unsigned long long)stats->read_errors,
+            (unsigned long long)stats->samples,
+            stats->reads > 0 ? (double)stats->samples / stats->reads : 0.0);
+    printf("sent   %10llu packets  %10llu samples dropped\n",
+            (unsigned long long)stats->packets, (unsigned long long)stats->dropped);
+    print_stages((const struct techartms_jdts_stage_stats_t *)(stats + 1), (int)stats->stage_count);
+
+    close_source(&src);
+    return 0;
+}
+
+static int cmd_selftest(const struct options *options)
+{
+    struct techartms_jdts_record_t records[READ_BUFFER];
+    struct techartms_jdts_stage_stats_t stages[JDTSD_MAX_STAGES];
+    int64_t *call_ns = malloc(MAX_LATENCIES * sizeof(int64_t));
+    int64_t *delivery_ns = malloc(MAX_LATENCIES * sizeof(int64_t));
+    size_t call_count = 0;
+    size_t delivery_count = 0;
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    uint64_t samples = 0;
+    uint64_t repeated = 0;
+    uint64_t lost = 0;
+    int64_t last_sequence = -1;
+    struct source src;
+    int64_t start, end, t;
+    int count;
+    int i;
+
+    if (call_ns == NULL || delivery_ns == NULL) {
+        fprintf(stderr, "cannot allocate the latency buffers\n");
+        free(call_ns);
+        free(delivery_ns);
+        return 1;
+    }
+    if (open_source(&src, options) < 0) {
+        free(call_ns);
+        free(delivery_ns);
+        return 1;
+    }
+    setup_signals(options->seconds > 0 ? options->seconds : SELFTEST_SECONDS);
+
+    printf("source '%s', %d s\n", source_names[src.type], options->seconds > 0 ? options->seconds : SELFTEST_SECONDS);
+
+    start = now_ns();
+    while (!stopping) {
+        if (wait_source(&src) < 0) {
+            break;
+        }
+
+        t = now_ns();
+        count = read_source(&src, records);
+        end = now_ns();
+        if (stopping) {
+            break;
+        }
+        calls++;
+        if (count < 0) {
+            errors++;
+            if (src.type == SOURCE_JDTSD) {
+                fprintf(stderr, "jdtsd went away\n");
+                break;
+            }
+            continue;
+        }
+        if (call_count < MAX_LATENCIES) {
+            call_ns[call_count++] = end - t;
+        }
+
+        for (i = 0; i < count; i++) {
+            if (records[i].sequence <= last_sequence) {
+                repeated++;
+                continue;
+            }
+            if (last_sequence >= 0) {
+                lost += (uint64_t)(records[i].sequence - last_sequence - 1);
+            }
+            last_sequence = records[i].sequence;
+            samples++;
+            // the time from the read of the sample out of the driver to here
+            if (src.type != SOURCE_RAW && delivery_count < MAX_LATENCIES) {
+                delivery_ns[delivery_count++] = end - records[i].timestamp_ns;
+            }
+        }
+    }
+    t = now_ns() - start;
+
+    printf("%llu samples in %.3f s, %.0f samples/s, %llu calls, %.1f samples/call, %llu errors\n",
+            (unsigned long long)samples, t / 1e9, samples / (t / 1e9), (unsigned long long)calls,
+            calls > 0 ? (double)samples / calls : 0.0, (unsigned long long)errors);
+    printf("lost %llu samples, gap rate %.3f%%, %llu repeated",
+            (unsigned long long)lost, samples + lost > 0 ? 100.0 * lost / (samples + lost) : 0.0,
+            (unsigned long long)repeated);
+    if (src.type == SOURCE_JDTSD) {
+        printf(", %llu dropped by jdtsd", (unsigned long long)src.dropped);
+    }
+    printf("\n");
+    // the HAL waits for the samples in read_samples(), the other sources are polled first
+    print_latencies(src.type == SOURCE_HAL ? "  per call" : "  per read", call_ns, call_count);
+    print_latencies("  delivery", delivery_ns, delivery_count);
+    if (src.type == SOURCE_HAL) {
+        count = src.dev->get_stage_stats(stages, JDTSD_MAX_STAGES);
+        print_stages(stages, count < (int)JDTSD_MAX_STAGES ? count : (int)JDTSD_MAX_STAGES);
+    }
+
+    close_source(&src);
+    free(call_ns);
+    free(delivery_ns);
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s stream [-r | -s] [-b backend] [-n count] [-p period_ms] [-t seconds] [-a]\n"
+            "       %s record [-b backend] [-n count] [-t seconds] [-a] <file>\n"
+            "       %s stats\n"
+            "       %s selftest [-r | -s] [-b backend] [-t seconds] [-a]\n",
+            name, name, name, name);
+}
+
+int main(int argc, char **argv)
+{
+    struct options options;
+    const char *command;
+    int opt;
+
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    command = argv[1];
+
+    memset(&options, 0, sizeof(options));
+    options.source = SOURCE_HAL;
+    optind = 2;
+    while ((opt = getopt(argc, argv, "rsb:n:p:t:a")) != -1) {
+        switch (opt) {
+        case 'r':
+            options.source = SOURCE_RAW;
+            break;
+        case 's':
+            options.source = SOURCE_JDTSD;
+            break;
+        case 'b':
+            options.backend = optarg;
+            break;
+        case 'n':
+            options.count = strtoull(optarg, NULL, 0);
+            break;
+        case 'p':
+            options.period_us = (uint32_t)strtoul(optarg, NULL, 0) * 1000;
+            break;
+        case 't':
+            options.seconds = atoi(optarg);
+            break;
+        case 'a':
+            options.wake = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.backend != NULL && options.source != SOURCE_HAL) {
+        fprintf(stderr, "-b only applies to the HAL opened by %s\n", argv[0]);
+        return 1;
+    }
+
+    if (strcmp(command, "stream") == 0) {
+        return cmd_stream(&options);
+    }
+    if (strcmp(command, "record") == 0) {
+        if (optind != argc - 1) {
+            usage(argv[0]);
+            return 1;
+        }
+        return cmd_record(&options, argv[optind]);
+    }
+    if (strcmp(command, "stats") == 0) {
+        return cmd_stats();
+    }
+    if (strcmp(command, "selftest") == 0) {
+        return cmd_selftest(&options);
+    }
+
+    usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,25 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+# serves the JDTS samples to native clients over /dev/socket/jdtsd,
+# the protocol is in jdtsd_protocol.h
+LOCAL_SRC_FILES:= \
+    jdtsd.c
+
+LOCAL_C_INCLUDES += \
+    $(call include-path-for, libhardware)
+
+# the reader thread of JdtsService, which the daemon shares
+LOCAL_STATIC_LIBRARIES := \
+    libjdts_reader \
+    libjdts_common
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libhardware \
+    liblog
+
+LOCAL_MODULE:= jdtsd
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
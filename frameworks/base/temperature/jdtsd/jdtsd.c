@@ -0,0 +1,639 @@
+#define LOG_TAG "jdtsd"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <cutils/sockets.h>
+#include <hardware/hardware.h>
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_reader.h"
+#include "jdtsd_protocol.h"
+
+/*
+jdtsd opens the HAL on its own, next to the one of system_server: the driver gives every
+open file its own FIFO position, so both see all the samples. The HAL state of a process
+is its own too, a filter set through jdtsd only changes the samples of jdtsd's clients.
+The power and the mode of the sensor are global, the driver arbitrates between the votes
+of its open files (see jdts_temperature.c): jdtsd votes for all its clients together,
+JdtsService for the Java ones, and neither switches the sensor off under the other.
+
+The reader of JdtsService (jdts_reader.c) reads the HAL while there is a client, its
+callback keeps the new samples in a ring and wakes the main thread through an eventfd.
+While jdtsd votes for continuous mode it drains the driver FIFO back to back; otherwise it
+reads single frames, each one a measurement in burst mode, at the pace of the fastest
+subscriber. The main thread does everything else from a single epoll loop: it accepts the
+clients, answers their requests and passes the new samples on to the subscribers, never
+blocking on a client.
+*/
+
+// see JdtsService: lets the daemon run against a simulated sensor, e.g. "sim:rate=100"
+#define BACKEND_PROPERTY    "persist.jdts.backend"
+
+#define MAX_CLIENTS         16
+// the samples kept for JDTSD_MSG_READ, a power of two
+#define RING_SIZE           1024
+#define MAX_EVENTS          (MAX_CLIENTS + 2)
+
+// a burst mode measurement powers the sensor up for about 250 ms: a subscriber asking
+// for samples more often than this gets continuous mode, the clients which only poll
+// get a measurement this often
+#define BURST_PERIOD_NS     1000000000LL
+
+struct client {
+    int fd;                 // -1 for a free slot
+    int subscribed;
+    struct jdts_decimator_t decimator;
+    uint32_t max_records;
+    // samples lost since the last packet, reported with the next one
+    uint32_t dropped;
+    int power_vote;
+    int mode_vote;
+};
+
+// a packet as sent or received, aligned for any of the messages
+union packet {
+    struct jdtsd_header_t header;
+    uint64_t align;
+    uint8_t bytes[JDTSD_MAX_PACKET];
+};
+
+static struct techartms_jdts_device_t *dev;
+
+// the reader thread's, it packs the new samples of a read there
+static struct techartms_jdts_record_t reader_records[JDTS_READER_CHUNK];
+
+// shared between the reader and the main thread
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct techartms_jdts_record_t ring[RING_SIZE];
+static uint64_t ring_head;      // samples ever put in the ring
+static int wake_fd = -1;
+
+// the main thread only
+static struct client clients[MAX_CLIENTS];
+static int client_count;
+static int subscriber_count;
+static uint64_t fanout_head;    // the next ring sample to pass on
+static uint64_t stat_packets;
+static uint64_t stat_dropped;
+static int power_state;
+static int mode_state;
+
+// the reader's callback, on its thread
+static void reader_samples(void *cookie, size_t count)
+{
+    uint64_t one = 1;
+    size_t i;
+
+    (void)cookie;
+    pthread_mutex_lock(&ring_lock);
+    for (i = 0; i < count; i++) {
+        ring[(ring_head + i) & (RING_SIZE - 1)] = reader_records[i];
+    }
+    ring_head += count;
+    pthread_mutex_unlock(&ring_lock);
+
+    if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        ALOGE("reader_samples: cannot wake the main thread: %s", strerror(errno));
+    }
+}
+
+static const struct jdts_reader_callbacks_t reader_callbacks = {
+    NULL,
+    NULL,
+    reader_samples,
+};
+
+// the reader runs while there is a client, a stop only pauses it
+static void set_reader_wanted(int wanted)
+{
+    int err;
+
+    if (!wanted) {
+        jdts_reader_stop();
+        return;
+    }
+    err = jdts_reader_start(dev, &reader_callbacks, NULL, reader_records);
+    if (err != 0 && err != -EALREADY) {
+        ALOGE("cannot start the reader: %s", strerror(-err));
+    }
+}
+
+// a reply which does not fit the socket means the client stopped reading, it is dropped
+static int send_packet(struct client *client, const void *packet, size_t size)
+{
+    ssize_t ret;
+
+    do {
+        ret = send(client->fd, packet, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    return ret < 0 ? -errno : 0;
+}
+
+static int send_status(struct client *client, uint32_t token, int status)
+{
+    struct jdtsd_status_t reply;
+
+    memset(&reply, 0, sizeof(reply));
+    reply.header.type = JDTSD_MSG_STATUS;
+    reply.header.token = token;
+    reply.status = status;
+    return send_packet(client, &reply, sizeof(reply));
+}
+
+// jdtsd's vote is that of its clients together, a subscriber counting for power and,
+// faster than burst mode, for continuous mode. The driver weighs it against the votes of the other
+// processes, so a vote for sleep or burst mode is only jdtsd not needing more
+static void apply_votes(void)
+{
+    int64_t period_ns = BURST_PERIOD_NS;
+    int64_t client_period_ns;
+    int power = 0;
+    int mode = 0;
+    int i;
+
+    for (i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd < 0) {
+            continue;
+        }
+        power |= clients[i].power_vote;
+        mode |= clients[i].mode_vote;
+        // a subscription only gets samples from a sensor that is on
+        power |= clients[i].subscribed;
+        if (clients[i].subscribed) {
+            client_period_ns = clients[i].decimator.period_ns;
+            mode |= client_period_ns < BURST_PERIOD_NS;
+            if (client_period_ns < period_ns) {
+                period_ns = client_period_ns;
+            }
+        }
+    }
+
+    // the mode first, so that the sensor wakes up in the mode it is wanted in
+    if (mode != mode_state && dev->set_mode((unsigned char)mode) == 0) {
+        mode_state = mode;
+    }
+    if (power != power_state && dev->activate((unsigned char)power) == 0) {
+        power_state = power;
+    }
+
+    // the reader follows the mode jdtsd is in, even one it could not switch out of: it
+    // drains the FIFO in continuous mode and makes paced single reads otherwise, which
+    // in burst mode are measurements. The sensor may be in burst mode for another process
+    jdts_reader_set_period(mode_state ? 0 : (int32_t)(period_ns / 1000));
+}
+
+static void close_client(struct client *client)
+{
+    int power_vote = client->power_vote;
+    int mode_vote = client->mode_vote;
+    int subscribed = client->subscribed;
+
+    close(client->fd);
+    if (client->subscribed) {
+        subscriber_count--;
+    }
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+    client_count--;
+
+    if (power_vote || mode_vote || subscribed) {
+        apply_votes();
+    }
+    if (client_count == 0) {
+        set_reader_wanted(0);
+    }
+}
+
+static void accept_client(int listen_fd, int epoll_fd)
+{
+    struct epoll_event event;
+    struct client *client = NULL;
+    int fd;
+    int i;
+
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            ALOGE("accept_client: %s", strerror(errno));
+        }
+        return;
+    }
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        ALOGE("accept_client: cannot set up the client socket: %s", strerror(errno));
+        close(fd);
+        return;
+    }
+
+    for (i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd < 0) {
+            client = &clients[i];
+            break;
+        }
+    }
+    if (client == NULL) {
+        ALOGW("accept_client: too many clients");
+        close(fd);
+        return;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        ALOGE("accept_client: cannot watch the client: %s", strerror(errno));
+        close(fd);
+        return;
+    }
+
+    memset(client, 0, sizeof(*client));
+    client->fd = fd;
+    client_count++;
+    if (client_count == 1) {
+        set_reader_wanted(1);
+    }
+}
+
+static int handle_read(struct client *client, const struct jdtsd_read_t *request)
+{
+    union packet reply;
+    struct jdtsd_samples_t *samples = (struct jdtsd_samples_t *)&reply;
+    struct techartms_jdts_record_t *records = (struct techartms_jdts_record_t *)(samples + 1);
+    uint32_t max = request->max_records;
+    uint64_t first;
+    uint64_t i;
+
+    if (max == 0 || max > JDTSD_MAX_RECORDS) {
+        max = JDTSD_MAX_RECORDS;
+    }
+
+    memset(samples, 0, sizeof(*samples));
+    samples->header.type = JDTSD_MSG_SAMPLES;
+    samples->header.token = request->header.token;
+
+    pthread_mutex_lock(&ring_lock);
+    first = ring_head > RING_SIZE ? ring_head - RING_SIZE : 0;
+    // the sequences in the ring increase, the first one past 'after_sequence' is searched
+    // from the newest end, where a polling client finds it in a few steps
+    for (i = ring_head; i > first; i--) {
+        if (ring[(i - 1) & (RING_SIZE - 1)].sequence <= request->after_sequence) {
+            break;
+        }
+    }
+    for (; i < ring_head && samples->count < max; i++) {
+        records[samples->count++] = ring[i & (RING_SIZE - 1)];
+    }
+    pthread_mutex_unlock(&ring_lock);
+
+    return send_packet(client, samples, sizeof(*samples) + samples->count * sizeof(*records));
+}
+
+static int handle_stats(struct client *client, uint32_t token)
+{
+    union packet reply;
+    struct jdtsd_stats_t *stats = (struct jdtsd_stats_t *)&reply;
+    struct jdts_reader_stats_t reader_stats;
+    int count;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->header.type = JDTSD_MSG_STATS;
+    stats->header.token = token;
+
+    jdts_reader_get_stats(&reader_stats);
+    stats->reads = reader_stats.reads;
+    stats->read_errors = reader_stats.errors;
+    stats->samples = reader_stats.samples;
+    stats->packets = stat_packets;
+    stats->dropped = stat_dropped;
+    stats->clients = (uint32_t)client_count;
+    stats->subscribers = (uint32_t)subscriber_count;
+
+    count = dev->get_stage_stats((struct techartms_jdts_stage_stats_t *)(stats + 1), JDTSD_MAX_STAGES);
+    stats->stage_count = count < 0 ? 0 : (count < (int)JDTSD_MAX_STAGES ? (uint32_t)count : JDTSD_MAX_STAGES);
+
+    return send_packet(client, stats,
+            sizeof(*stats) + stats->stage_count * sizeof(struct techartms_jdts_stage_stats_t));
+}
+
+// returns what sending the reply returned
+static int handle_request(struct client *client, const union packet *request, size_t size)
+{
+    uint32_t token = request->header.token;
+    int status;
+
+    switch (request->header.type) {
+    case JDTSD_MSG_HELLO: {
+        struct jdtsd_hello_t reply;
+
+        memset(&reply, 0, sizeof(reply));
+        reply.header.type = JDTSD_MSG_HELLO;
+        reply.header.token = token;
+        reply.version = JDTSD_PROTOCOL_VERSION;
+        reply.record_size = TECHART_MS_JDTS_RECORD_SIZE;
+        reply.max_records = JDTSD_MAX_RECORDS;
+        return send_packet(client, &reply, sizeof(reply));
+    }
+
+    case JDTSD_MSG_SUBSCRIBE: {
+        const struct jdtsd_subscribe_t *subscribe = (const struct jdtsd_subscribe_t *)request;
+
+        if (size < sizeof(*subscribe)) {
+            return send_status(client, token, -EINVAL);
+        }
+        if (!client->subscribed) {
+            subscriber_count++;
+        }
+        client->subscribed = 1;
+        jdts_decimator_reset(&client->decimator, (int64_t)subscribe->period_us * 1000);
+        client->max_records = subscribe->max_records == 0 || subscribe->max_records > JDTSD_MAX_RECORDS ?
+                JDTSD_MAX_RECORDS : subscribe->max_records;
+        client->dropped = 0;
+        apply_votes();
+        return send_status(client, token, 0);
+    }
+
+    case JDTSD_MSG_UNSUBSCRIBE:
+        if (client->subscribed) {
+            subscriber_count--;
+        }
+        client->subscribed = 0;
+        apply_votes();
+        return send_status(client, token, 0);
+
+    case JDTSD_MSG_READ:
+        if (size < sizeof(struct jdtsd_read_t)) {
+            return send_status(client, token, -EINVAL);
+        }
+        return handle_read(client, (const struct jdtsd_read_t *)request);
+
+    case JDTSD_MSG_SET_FILTER: {
+        const struct jdtsd_set_filter_t *set = (const struct jdtsd_set_filter_t *)request;
+
+        if (size < sizeof(*set)) {
+            return send_status(client, token, -EINVAL);
+        }
+        status = dev->set_filter(set->channel, &set->filter) == 0 ? 0 : -EINVAL;
+        return send_status(client, token, status);
+    }
+
+    case JDTSD_MSG_SET_POWER:
+    case JDTSD_MSG_SET_MODE: {
+        const struct jdtsd_set_t *set = (const struct jdtsd_set_t *)request;
+        int *vote = request->header.type == JDTSD_MSG_SET_POWER ? &client->power_vote : &client->mode_vote;
+        int *state = request->header.type == JDTSD_MSG_SET_POWER ? &power_state : &mode_state;
+
+        if (size < sizeof(*set)) {
+            return send_status(client, token, -EINVAL);
+        }
+        *vote = set->value != 0;
+        apply_votes();
+        // another client's vote may keep the sensor as it is, which is not a failure
+        status = (*vote && !*state) ? -EIO : 0;
+        return send_status(client, token, status);
+    }
+
+    case JDTSD_MSG_GET_STATS:
+        return handle_stats(client, token);
+
+    default:
+        return send_status(client, token, -EOPNOTSUPP);
+    }
+}
+
+static void read_client(struct client *client)
+{
+    union packet request;
+    ssize_t size;
+
+    for (;;) {
+        size = recv(client->fd, &request, sizeof(request), MSG_DONTWAIT);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0 && errno == EAGAIN) {
+            return;
+        }
+        if (size <= 0) {
+            close_client(client);
+            return;
+        }
+
+        if ((size_t)size < sizeof(request.header)) {
+            ALOGW("read_client: short packet of %zd bytes", size);
+            close_client(client);
+            return;
+        }
+        if (handle_request(client, &request, (size_t)size) < 0) {
+            ALOGW("read_client: client not reading its replies, dropped");
+            close_client(client);
+            return;
+        }
+    }
+}
+
+// packs the samples due to 'client' out of 'records' and sends them, as many packets
+// as needed. A packet which does not fit the socket is lost and counted, never waited for
+static void send_samples(struct client *client, const struct techartms_jdts_record_t *records, size_t count)
+{
+    union packet packet;
+    struct jdtsd_samples_t *samples = (struct jdtsd_samples_t *)&packet;
+    struct techartms_jdts_record_t *out = (struct techartms_jdts_record_t *)(samples + 1);
+    size_t i;
+    int ret;
+
+    memset(samples, 0, sizeof(*samples));
+    samples->header.type = JDTSD_MSG_SAMPLES;
+
+    for (i = 0; i <= count; i++) {
+        if (i < count && jdts_decimator_take(&client->decimator, records[i].timestamp_ns)) {
+            out[samples->count++] = records[i];
+        }
+        if (samples->count == 0 || (samples->count < client->max_records && i < count)) {
+            continue;
+        }
+
+        samples->dropped = client->dropped;
+        ret = send_packet(client, samples, sizeof(*samples) + samples->count * sizeof(*out));
+        if (ret == 0) {
+            client->dropped = 0;
+            stat_packets++;
+        } else if (ret == -EAGAIN) {
+            client->dropped += samples->count;
+            stat_dropped += samples->count;
+        } else {
+            close_client(client);
+            return;
+        }
+        samples->count = 0;
+    }
+}
+
+static void fan_out(void)
+{
+    struct techartms_jdts_record_t records[JDTSD_MAX_RECORDS];
+    uint64_t lost;
+    size_t count;
+    size_t i;
+    int c;
+
+    for (;;) {
+        pthread_mutex_lock(&ring_lock);
+        // the main thread fell a whole ring behind, the overwritten samples are lost to all
+        lost = ring_head - fanout_head > RING_SIZE ? ring_head - fanout_head - RING_SIZE : 0;
+        fanout_head += lost;
+        count = ring_head - fanout_head < JDTSD_MAX_RECORDS ? (size_t)(ring_head - fanout_head) : JDTSD_MAX_RECORDS;
+        for (i = 0; i < count; i++) {
+            records[i] = ring[(fanout_head + i) & (RING_SIZE - 1)];
+        }
+        fanout_head += count;
+        pthread_mutex_unlock(&ring_lock);
+
+        if (count == 0) {
+            return;
+        }
+
+        for (c = 0; c < MAX_CLIENTS; c++) {
+            if (clients[c].fd >= 0 && clients[c].subscribed) {
+                clients[c].dropped += (uint32_t)lost;
+                stat_dropped += lost;
+                send_samples(&clients[c], records, count);
+            }
+        }
+    }
+}
+
+static int open_device(void)
+{
+    const struct hw_module_t *module;
+    char backend[PROPERTY_VALUE_MAX];
+    int err;
+
+    err = hw_get_module(TECHART_MS_JDTS_HARDWARE_MODULE_ID, &module);
+    if (err != 0) {
+        ALOGE("cannot get device module: %d", err);
+        return -1;
+    }
+
+    property_get(BACKEND_PROPERTY, backend, "");
+    err = module->methods->open(module, backend, (struct hw_device_t **)&dev);
+    if (err != 0) {
+        ALOGE("cannot open device module: %d", err);
+        return -1;
+    }
+    return 0;
+}
+
+static int get_listen_socket(void)
+{
+    int fd;
+
+    // created by init from the "socket" line of the service, or made here when the
+    // daemon is started by hand
+    fd = android_get_control_socket(JDTSD_SOCKET_NAME);
+    if (fd >= 0) {
+        if (listen(fd, MAX_CLIENTS) < 0) {
+            ALOGE("cannot listen on the socket: %s", strerror(errno));
+            return -1;
+        }
+    } else {
+        fd = socket_local_server(JDTSD_SOCKET_NAME, ANDROID_SOCKET_NAMESPACE_RESERVED, SOCK_SEQPACKET);
+        if (fd < 0) {
+            ALOGE("cannot create the socket");
+            return -1;
+        }
+    }
+    return fd;
+}
+
+int main(int argc, char **argv)
+{
+    struct epoll_event events[MAX_EVENTS];
+    struct epoll_event event;
+    uint64_t wakes;
+    int listen_fd;
+    int epoll_fd;
+    int count;
+    int i;
+
+    (void)argc;
+    (void)argv;
+
+    signal(SIGPIPE, SIG_IGN);
+    for (i = 0; i < MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+
+    if (open_device() < 0) {
+        return 1;
+    }
+
+    listen_fd = get_listen_socket();
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_fd = epoll_create(MAX_EVENTS);
+    if (listen_fd < 0 || wake_fd < 0 || epoll_fd < 0) {
+        ALOGE("cannot set up the event loop");
+        return 1;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = &listen_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) < 0) {
+        ALOGE("cannot watch the socket: %s", strerror(errno));
+        return 1;
+    }
+    event.data.ptr = &wake_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) < 0) {
+        ALOGE("cannot watch the reader: %s", strerror(errno));
+        return 1;
+    }
+
+    // single frames until jdtsd votes for continuous mode, the sensor may be in burst mode
+    // for another process; and no burst of what the driver queued while nobody read
+    jdts_reader_set_period((int32_t)(BURST_PERIOD_NS / 1000));
+    jdts_reader_set_drop_stale(1);
+
+    ALOGI("serving on %s", JDTSD_SOCKET_NAME);
+
+    for (;;) {
+        count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("epoll_wait: %s", strerror(errno));
+            return 1;
+        }
+
+        for (i = 0; i < count; i++) {
+            if (events[i].data.ptr == &listen_fd) {
+                accept_client(listen_fd, epoll_fd);
+            } else if (events[i].data.ptr == &wake_fd) {
+                if (read(wake_fd, &wakes, sizeof(wakes)) < 0 && errno != EAGAIN) {
+                    ALOGE("cannot read the reader's wake-ups: %s", strerror(errno));
+                }
+                fan_out();
+            } else {
+                struct client *client = (struct client *)events[i].data.ptr;
+
+                // a client closed while fanning out earlier in this round has no fd anymore
+                if (client->fd >= 0) {
+                    read_client(client);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+#ifndef ANDROID_JDTSD_PROTOCOL_H
+#define ANDROID_JDTSD_PROTOCOL_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+__BEGIN_DECLS
+
+/*
+The protocol of jdtsd, the native server of the JDTS samples, for the clients that would
+rather not go through Java and Binder. The socket is SOCK_SEQPACKET: every message is one
+packet of at most JDTSD_MAX_PACKET bytes starting with a jdtsd_header_t, in native byte
+order since both ends run on the device.
+
+Every request gets exactly one reply carrying the request's 'token'. The samples of a
+subscription come unrequested, as JDTSD_MSG_SAMPLES packets with a token of 0, in between
+the replies.
+
+    request                 reply
+    JDTSD_MSG_HELLO         JDTSD_MSG_HELLO, the server's version and sizes
+    JDTSD_MSG_SUBSCRIBE     JDTSD_MSG_STATUS, then the samples until JDTSD_MSG_UNSUBSCRIBE
+    JDTSD_MSG_UNSUBSCRIBE   JDTSD_MSG_STATUS
+    JDTSD_MSG_READ          JDTSD_MSG_SAMPLES, the buffered samples after a sequence
+    JDTSD_MSG_SET_FILTER    JDTSD_MSG_STATUS
+    JDTSD_MSG_SET_POWER     JDTSD_MSG_STATUS
+    JDTSD_MSG_SET_MODE      JDTSD_MSG_STATUS
+    JDTSD_MSG_GET_STATS     JDTSD_MSG_STATS
+
+A request the server cannot parse is answered by JDTSD_MSG_STATUS with -EINVAL, an
+unknown one with -EOPNOTSUPP.
+*/
+
+#define JDTSD_SOCKET_NAME       "jdtsd"     // created by init in /dev/socket
+#define JDTSD_PROTOCOL_VERSION  1
+#define JDTSD_MAX_PACKET        4096
+
+enum {
+    JDTSD_MSG_HELLO = 1,
+    JDTSD_MSG_SUBSCRIBE,
+    JDTSD_MSG_UNSUBSCRIBE,
+    JDTSD_MSG_READ,
+    JDTSD_MSG_SET_FILTER,
+    JDTSD_MSG_SET_POWER,
+    JDTSD_MSG_SET_MODE,
+    JDTSD_MSG_GET_STATS,
+    JDTSD_MSG_STATUS,
+    JDTSD_MSG_SAMPLES,
+    JDTSD_MSG_STATS
+};
+
+struct jdtsd_header_t {
+    uint16_t type;          // JDTSD_MSG_*
+    uint16_t reserved;
+    uint32_t token;         // chosen by the client, echoed in the reply
+};
+
+struct jdtsd_hello_t {
+    struct jdtsd_header_t header;
+    uint32_t version;       // JDTSD_PROTOCOL_VERSION
+    uint32_t record_size;   // TECHART_MS_JDTS_RECORD_SIZE
+    uint32_t max_records;   // records that fit a JDTSD_MSG_SAMPLES packet
+    uint32_t reserved;
+};
+
+struct jdtsd_status_t {
+    struct jdtsd_header_t header;
+    int32_t status;         // 0 or -errno
+    uint32_t reserved;
+};
+
+struct jdtsd_subscribe_t {
+    struct jdtsd_header_t header;
+    uint32_t period_us;     // one sample per period, 0 for every sample
+    uint32_t max_records;   // per packet, 0 for as many as fit
+};
+
+// the samples with a sequence above 'after_sequence' still buffered by the server,
+// oldest first. -1 for all of them, it never waits for new ones
+struct jdtsd_read_t {
+    struct jdtsd_header_t header;
+    int64_t after_sequence;
+    uint32_t max_records;
+    uint32_t reserved;
+};
+
+struct jdtsd_set_filter_t {
+    struct jdtsd_header_t header;
+    int32_t channel;        // TECHART_MS_JDTS_CHANNEL_*
+    struct techartms_jdts_filter_t filter;
+};
+
+// JDTSD_MSG_SET_POWER and JDTSD_MSG_SET_MODE: the client's vote, 1 for on/continuous,
+// 0 to withdraw it. The votes of a client go away with its connection. A subscription
+// counts as a vote for power and, faster than a sample a second, for continuous mode.
+// Another process may keep the sensor on or in continuous mode whatever jdtsd's clients vote
+struct jdtsd_set_t {
+    struct jdtsd_header_t header;
+    int32_t value;
+    uint32_t reserved;
+};
+
+// followed by 'count' struct techartms_jdts_record_t
+struct jdtsd_samples_t {
+    struct jdtsd_header_t header;
+    uint32_t count;
+    // subscription samples lost since the previous packet because this client's
+    // socket was full, always 0 in a reply to JDTSD_MSG_READ
+    uint32_t dropped;
+};
+
+#define JDTSD_MAX_RECORDS \
+    ((JDTSD_MAX_PACKET - sizeof(struct jdtsd_samples_t)) / TECHART_MS_JDTS_RECORD_SIZE)
+
+// followed by 'stage_count' struct techartms_jdts_stage_stats_t, see get_stage_stats()
+struct jdtsd_stats_t {
+    struct jdtsd_header_t header;
+    uint64_t reads;         // read_samples() calls of the server
+    uint64_t read_errors;
+    uint64_t samples;       // samples read, a frame read again counted again
+    uint64_t packets;       // JDTSD_MSG_SAMPLES sent to subscribers
+    uint64_t dropped;       // subscription samples lost to full sockets
+    uint32_t clients;
+    uint32_t subscribers;
+    uint32_t stage_count;
+    uint32_t reserved;
+};
+
+#define JDTSD_MAX_STAGES \
+    ((JDTSD_MAX_PACKET - sizeof(struct jdtsd_stats_t)) / sizeof(struct techartms_jdts_stage_stats_t))
+
+__END_DECLS
+
+#endif // ANDROID_JDTSD_PROTOCOL_H
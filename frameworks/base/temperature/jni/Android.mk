@@ -0,0 +1,22 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+# reads the shared sample region of JdtsService in the client processes,
+# loaded by android.hardware.temperature.JdtsSharedMemory
+LOCAL_SRC_FILES:= \
+    android_hardware_temperature_JdtsSharedMemory.cpp
+
+LOCAL_C_INCLUDES += \
+    $(JNI_H_INCLUDE) \
+    $(call include-path-for, libhardware)
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    liblog \
+    libnativehelper \
+    libutils
+
+LOCAL_MODULE:= libjdts_jni
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_SHARED_LIBRARY)
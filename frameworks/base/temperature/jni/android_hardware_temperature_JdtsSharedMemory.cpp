@@ -0,0 +1,196 @@
+#define LOG_TAG "TECHARTMS_JDTS"
+
+#include "jni.h"
+#include "JNIHelp.h"
+
+#include <utils/Log.h>
+#include <cutils/ashmem.h>
+#include <hardware/sensor_jdts_temperature.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// the client side of the shared sample region published by JdtsService: lives in its
+// own library as android.hardware.temperature.JdtsSharedMemory is loaded in the apps
+namespace android
+{
+    static struct {
+        jfieldID sequence;
+        jfieldID timestampNanos;
+        jfieldID synchro;
+        jfieldID flags;
+        jfieldID objectTemperature;
+        jfieldID ntc1Temperature;
+        jfieldID ntc2Temperature;
+        jfieldID ntc3Temperature;
+        jfieldID filtered[TECHART_MS_JDTS_CHANNEL_COUNT];
+        jfieldID compensatedObjectTemperature;
+    } gJdtsTemperatureDataClassInfo;
+
+    // maps the region read-only and checks it is one we understand, returns 0 on failure
+    static jlong map_native(JNIEnv *env, jobject clazz, jobject fileDescriptor)
+    {
+        int fd = jniGetFDFromFileDescriptor(env, fileDescriptor);
+        if (fd < 0) {
+            ALOGE("map_native: invalid fd");
+            return 0;
+        }
+
+        int size = ashmem_get_size_region(fd);
+        if (size < (int)TECHART_MS_JDTS_SHM_SIZE) {
+            ALOGE("map_native: the region is too small: %d", size);
+            return 0;
+        }
+
+        void* addr = mmap(NULL, TECHART_MS_JDTS_SHM_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ALOGE("map_native: cannot map the region");
+            return 0;
+        }
+
+        const techartms_jdts_shm_t* shm = (const techartms_jdts_shm_t*)addr;
+        if (shm->magic != TECHART_MS_JDTS_SHM_MAGIC || shm->version != TECHART_MS_JDTS_SHM_VERSION ||
+                shm->record_size != TECHART_MS_JDTS_RECORD_SIZE ||
+                shm->ring_size != TECHART_MS_JDTS_SHM_RING_SIZE) {
+            ALOGE("map_native: unknown region layout, version %u", shm->version);
+            munmap(addr, TECHART_MS_JDTS_SHM_SIZE);
+            return 0;
+        }
+
+        return (jlong)(intptr_t)addr;
+    }
+
+    static void unmap_native(JNIEnv *env, jobject clazz, jlong ptr)
+    {
+        if (ptr != 0) {
+            munmap((void*)(intptr_t)ptr, TECHART_MS_JDTS_SHM_SIZE);
+        }
+    }
+
+    // the latest sample into the caller's JdtsTemperatureData, false if there is none yet
+    static jboolean read_latest_native(JNIEnv *env, jobject clazz, jlong ptr, jobject data)
+    {
+        const techartms_jdts_shm_t* shm = (const techartms_jdts_shm_t*)(intptr_t)ptr;
+        techartms_jdts_record_t record;
+
+        if (data == NULL) {
+            jniThrowNullPointerException(env, "data");
+            return JNI_FALSE;
+        }
+        if (shm == NULL || techartms_jdts_shm_read_latest(shm, &record) != 0) {
+            return JNI_FALSE;
+        }
+
+        env->SetLongField(data, gJdtsTemperatureDataClassInfo.sequence, record.sequence);
+        env->SetLongField(data, gJdtsTemperatureDataClassInfo.timestampNanos, record.timestamp_ns);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.synchro, record.synchro);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.flags, record.flags);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.objectTemperature,
+                record.value[TECHART_MS_JDTS_CHANNEL_OBJ]);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.ntc1Temperature,
+                record.value[TECHART_MS_JDTS_CHANNEL_NTC1]);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.ntc2Temperature,
+                record.value[TECHART_MS_JDTS_CHANNEL_NTC2]);
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.ntc3Temperature,
+                record.value[TECHART_MS_JDTS_CHANNEL_NTC3]);
+        for (int ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            env->SetIntField(data, gJdtsTemperatureDataClassInfo.filtered[ch], record.filtered[ch]);
+        }
+        env->SetIntField(data, gJdtsTemperatureDataClassInfo.compensatedObjectTemperature, record.compensated);
+        return JNI_TRUE;
+    }
+
+    // up to 'max_count' of the most recent records, oldest first, packed from the start
+    // of a direct buffer. Returns their count
+    static jint read_recent_native(JNIEnv *env, jobject clazz, jlong ptr, jobject buffer, jint max_count)
+    {
+        const techartms_jdts_shm_t* shm = (const techartms_jdts_shm_t*)(intptr_t)ptr;
+        uint8_t* records;
+        jlong capacity;
+
+        if (buffer == NULL) {
+            jniThrowNullPointerException(env, "buffer");
+            return -1;
+        }
+        records = (uint8_t*)env->GetDirectBufferAddress(buffer);
+        capacity = env->GetDirectBufferCapacity(buffer);
+        if (records == NULL || capacity < 0) {
+            jniThrowException(env, "java/lang/IllegalArgumentException", "buffer is not direct");
+            return -1;
+        }
+        if (shm == NULL || max_count <= 0) {
+            return 0;
+        }
+        if (max_count > capacity / TECHART_MS_JDTS_RECORD_SIZE) {
+            max_count = (jint)(capacity / TECHART_MS_JDTS_RECORD_SIZE);
+        }
+
+        return (jint)techartms_jdts_shm_read_recent(shm, (techartms_jdts_record_t*)records, (size_t)max_count);
+    }
+
+    static JNINativeMethod method_table[] = {
+        { "map_native", "(Ljava/io/FileDescriptor;)J", (void*)map_native },
+        { "unmap_native", "(J)V", (void*)unmap_native },
+        { "read_latest_native", "(JLandroid/hardware/temperature/JdtsTemperatureData;)Z",
+                (void*)read_latest_native },
+        { "read_recent_native", "(JLjava/nio/ByteBuffer;I)I", (void*)read_recent_native },
+    };
+
+#define GET_FIELD_ID(var, clazz, fieldName, fieldDescriptor) \
+        var = env->GetFieldID(clazz, fieldName, fieldDescriptor); \
+        LOG_FATAL_IF(! var, "Unable to find field " fieldName);
+
+    static int register_android_hardware_temperature_JdtsSharedMemory(JNIEnv *env)
+    {
+        int res = jniRegisterNativeMethods(
+            env,
+            "android/hardware/temperature/JdtsSharedMemory",
+            method_table,
+            NELEM(method_table));
+        LOG_FATAL_IF(res < 0, "Unable to register native methods.");
+
+        jclass clazz = env->FindClass("android/hardware/temperature/JdtsTemperatureData");
+        LOG_FATAL_IF(! clazz, "Unable to find class android/hardware/temperature/JdtsTemperatureData");
+
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.sequence, clazz, "sequence", "J");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.timestampNanos, clazz, "timestampNanos", "J");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.synchro, clazz, "synchro", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.flags, clazz, "flags", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.objectTemperature, clazz, "objectTemperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.ntc1Temperature, clazz, "ntc1Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.ntc2Temperature, clazz, "ntc2Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.ntc3Temperature, clazz, "ntc3Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.filtered[TECHART_MS_JDTS_CHANNEL_OBJ], clazz,
+                "filteredObjectTemperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.filtered[TECHART_MS_JDTS_CHANNEL_NTC1], clazz,
+                "filteredNtc1Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.filtered[TECHART_MS_JDTS_CHANNEL_NTC2], clazz,
+                "filteredNtc2Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.filtered[TECHART_MS_JDTS_CHANNEL_NTC3], clazz,
+                "filteredNtc3Temperature", "I");
+        GET_FIELD_ID(gJdtsTemperatureDataClassInfo.compensatedObjectTemperature, clazz,
+                "compensatedObjectTemperature", "I");
+        env->DeleteLocalRef(clazz);
+
+        return res;
+    }
+};
+
+using namespace android;
+
+extern "C" jint JNI_OnLoad(JavaVM* vm, void* reserved)
+{
+    JNIEnv* env = NULL;
+
+    if (vm->GetEnv((void**) &env, JNI_VERSION_1_4) != JNI_OK) {
+        ALOGE("GetEnv failed!");
+        return -1;
+    }
+    if (register_android_hardware_temperature_JdtsSharedMemory(env) < 0) {
+        ALOGE("JdtsSharedMemory native registration failed");
+        return -1;
+    }
+
+    return JNI_VERSION_1_4;
+}
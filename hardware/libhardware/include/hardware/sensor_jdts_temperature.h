@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <sys/cdefs.h>
 #include <sys/types.h>
+#include <string.h>
 
 #include <hardware/hardware.h>
 
@@ -11,14 +12,275 @@ __BEGIN_DECLS
 
 #define TECHART_MS_JDTS_HARDWARE_MODULE_ID "techartmsjdts"
 
+// one raw sample as it is read out of /dev/jdts_temperature:
+// [0,1] object, [2,3] synchro counter, [4,5] ntc1, [6,7] ntc2, [8,9] ntc3
+// all values are little-endian, temperatures are int16 in 0.01C
+#define TECHART_MS_JDTS_FRAME_SIZE 10
+
+enum {
+    TECHART_MS_JDTS_CHANNEL_OBJ = 0,
+    TECHART_MS_JDTS_CHANNEL_NTC1,
+    TECHART_MS_JDTS_CHANNEL_NTC2,
+    TECHART_MS_JDTS_CHANNEL_NTC3,
+    TECHART_MS_JDTS_CHANNEL_COUNT
+};
+
+// alerts raised by the HAL's streaming detector on a sample, see jdts_detect.h
+#define TECHART_MS_JDTS_FLAG_RISE           0x0001  // object heating faster than the limit
+#define TECHART_MS_JDTS_FLAG_FALL           0x0002  // object cooling faster than the limit
+#define TECHART_MS_JDTS_FLAG_OUTLIER        0x0004  // a channel far from its recent mean
+#define TECHART_MS_JDTS_FLAG_STUCK          0x0008  // synchro or values not moving
+#define TECHART_MS_JDTS_FLAG_NTC_MISMATCH   0x0010  // the NTCs disagree
+
+// decoded samples kept as a struct of arrays: every channel is a contiguous array,
+// so consumers can run over a single channel without touching the others.
+// Storage is owned by whoever fills in the pointers, 'count' grows up to 'capacity'
+struct techartms_jdts_batch_t {
+    size_t capacity;
+    size_t count;
+
+    uint16_t *synchro;
+    uint64_t *sequence;     // synchro unwrapped past its 16 bit overflow, counts from the open
+    int64_t *timestamp_ns;  // CLOCK_MONOTONIC time of the read
+    uint16_t *flags;        // TECHART_MS_JDTS_FLAG_*, may be NULL
+    int16_t *raw[TECHART_MS_JDTS_CHANNEL_COUNT];    // 0.01C, as reported by the sensor
+    int16_t *value[TECHART_MS_JDTS_CHANNEL_COUNT];  // 0.01C, calibrated
+    float *celsius[TECHART_MS_JDTS_CHANNEL_COUNT];  // C, calibrated
+    int16_t *filtered[TECHART_MS_JDTS_CHANNEL_COUNT];   // 0.01C, value through set_filter(), may be NULL
+    int16_t *compensated;   // 0.01C, object corrected for the sensor body temperature, may be NULL
+};
+
+// a sample packed for consumers outside the HAL (Java buffers, shared memory, streams),
+// native byte order, TECHART_MS_JDTS_RECORD_SIZE bytes
+struct techartms_jdts_record_t {
+    int64_t sequence;
+    int64_t timestamp_ns;   // CLOCK_MONOTONIC
+    uint16_t synchro;
+    uint16_t flags;         // TECHART_MS_JDTS_FLAG_*
+    int16_t value[TECHART_MS_JDTS_CHANNEL_COUNT];   // 0.01C, calibrated
+    int16_t filtered[TECHART_MS_JDTS_CHANNEL_COUNT];    // 0.01C, calibrated and filtered
+    int16_t compensated;    // 0.01C, compensated object temperature
+    int16_t reserved;
+} __attribute__((packed));
+
+#define TECHART_MS_JDTS_RECORD_SIZE 40
+
+static inline void techartms_jdts_pack_record(struct techartms_jdts_record_t *record,
+        const struct techartms_jdts_batch_t *batch, size_t i)
+{
+    int ch;
+
+    record->sequence = (int64_t)batch->sequence[i];
+    record->timestamp_ns = batch->timestamp_ns[i];
+    record->synchro = batch->synchro[i];
+    record->flags = batch->flags != NULL ? batch->flags[i] : 0;
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        record->value[ch] = batch->value[ch][i];
+        record->filtered[ch] = batch->filtered[ch] != NULL ? batch->filtered[ch][i] : batch->value[ch][i];
+    }
+    record->compensated = batch->compensated != NULL ?
+            batch->compensated[i] : batch->value[TECHART_MS_JDTS_CHANNEL_OBJ][i];
+    record->reserved = 0;
+}
+
+// the read-only ashmem region JdtsService hands out to its clients: the latest sample
+// under a seqlock and a ring of the recent ones. The service's reader thread is the
+// only writer, clients map the region and read it without any IPC
+#define TECHART_MS_JDTS_SHM_MAGIC 0x4a445453    // "JDTS"
+#define TECHART_MS_JDTS_SHM_VERSION 2
+// records, a power of two
+#define TECHART_MS_JDTS_SHM_RING_SIZE 1024
+
+struct techartms_jdts_shm_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t ring_size;
+    // odd while the writer updates 'latest'
+    uint32_t latest_seq;
+    uint32_t reserved0;
+    // records written to the ring so far, record n is in ring[n & (ring_size - 1)]
+    int64_t count;
+    uint8_t reserved1[32];
+
+    struct techartms_jdts_record_t latest;
+    uint8_t reserved2[128 - 64 - TECHART_MS_JDTS_RECORD_SIZE];
+
+    struct techartms_jdts_record_t ring[TECHART_MS_JDTS_SHM_RING_SIZE];
+};
+
+#define TECHART_MS_JDTS_SHM_LATEST_OFFSET 64
+#define TECHART_MS_JDTS_SHM_RING_OFFSET 128
+#define TECHART_MS_JDTS_SHM_SIZE \
+    (TECHART_MS_JDTS_SHM_RING_OFFSET + TECHART_MS_JDTS_SHM_RING_SIZE * TECHART_MS_JDTS_RECORD_SIZE)
+
+// the writer side, 'records' are new and in sequence order
+static inline void techartms_jdts_shm_publish(struct techartms_jdts_shm_t *shm,
+        const struct techartms_jdts_record_t *records, size_t n)
+{
+    int64_t count = __atomic_load_n(&shm->count, __ATOMIC_RELAXED);
+    uint32_t seq;
+    size_t i;
+
+    if (n == 0) {
+        return;
+    }
+
+    // a slot is filled before the count covering it is released, one at a time so
+    // that only the slot of record 'count - ring_size' is ever in flight
+    for (i = 0; i < n; i++, count++) {
+        shm->ring[count & (TECHART_MS_JDTS_SHM_RING_SIZE - 1)] = records[i];
+        __atomic_store_n(&shm->count, count + 1, __ATOMIC_RELEASE);
+    }
+
+    seq = __atomic_load_n(&shm->latest_seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&shm->latest_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    shm->latest = records[n - 1];
+    __atomic_store_n(&shm->latest_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// copies the latest sample, returns 0 or -1 if there is none yet
+static inline int techartms_jdts_shm_read_latest(const struct techartms_jdts_shm_t *shm,
+        struct techartms_jdts_record_t *record)
+{
+    uint32_t seq;
+
+    for (;;) {
+        seq = __atomic_load_n(&shm->latest_seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+        *record = shm->latest;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm->latest_seq, __ATOMIC_RELAXED) == seq) {
+            return seq != 0 ? 0 : -1;
+        }
+    }
+}
+
+// copies up to 'max' of the most recent records, oldest first, and returns their count.
+// Slots the writer may have overwritten during the copy are dropped, not retried
+static inline size_t techartms_jdts_shm_read_recent(const struct techartms_jdts_shm_t *shm,
+        struct techartms_jdts_record_t *records, size_t max)
+{
+    int64_t end = __atomic_load_n(&shm->count, __ATOMIC_ACQUIRE);
+    int64_t begin, oldest, i;
+
+    if (max > TECHART_MS_JDTS_SHM_RING_SIZE) {
+        max = TECHART_MS_JDTS_SHM_RING_SIZE;
+    }
+    begin = end > (int64_t)max ? end - (int64_t)max : 0;
+    for (i = begin; i < end; i++) {
+        records[i - begin] = shm->ring[i & (TECHART_MS_JDTS_SHM_RING_SIZE - 1)];
+    }
+
+    // the writer fills record 'count' over the slot of 'count - ring_size'
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    oldest = __atomic_load_n(&shm->count, __ATOMIC_RELAXED) - TECHART_MS_JDTS_SHM_RING_SIZE + 1;
+    if (oldest > begin) {
+        if (oldest >= end) {
+            return 0;
+        }
+        memmove(records, records + (oldest - begin), (size_t)(end - oldest) * sizeof(*records));
+        begin = oldest;
+    }
+    return (size_t)(end - begin);
+}
+
+// one sample of the long-term history
+struct techartms_jdts_history_sample_t {
+    uint64_t sequence;      // keeps counting across restarts
+    int64_t time_ms;        // wall clock
+    int16_t value[TECHART_MS_JDTS_CHANNEL_COUNT];   // 0.01C, calibrated
+};
+
+// returns non-zero to stop the query
+typedef int (*techartms_jdts_history_visitor_t)(void *cookie, const struct techartms_jdts_history_sample_t *sample);
+
+// aggregate of the samples with start_ms <= time < start_ms + duration_ms
+struct techartms_jdts_rollup_t {
+    int64_t start_ms;       // wall clock
+    int64_t duration_ms;
+    uint32_t count;
+    int16_t min[TECHART_MS_JDTS_CHANNEL_COUNT];     // 0.01C, calibrated
+    int16_t max[TECHART_MS_JDTS_CHANNEL_COUNT];
+    float mean[TECHART_MS_JDTS_CHANNEL_COUNT];      // 0.01C
+};
+
+// the per-channel filter stage run as samples are decoded, see set_filter()
+enum {
+    TECHART_MS_JDTS_FILTER_NONE = 0,
+    TECHART_MS_JDTS_FILTER_EWMA,
+    TECHART_MS_JDTS_FILTER_KALMAN
+};
+
+struct techartms_jdts_filter_t {
+    int type;                   // TECHART_MS_JDTS_FILTER_*
+    float alpha;                // EWMA: weight of a new sample, 0 < alpha <= 1
+    float process_noise;        // Kalman: variance the temperature drifts by per sample, (0.01C)^2
+    float measurement_noise;    // Kalman: variance of a reading, (0.01C)^2
+};
+
+// the time spent in one stage of the HAL processing pipeline, see get_stage_stats()
+#define TECHART_MS_JDTS_STAGE_NAME_SIZE 16
+
+struct techartms_jdts_stage_stats_t {
+    char name[TECHART_MS_JDTS_STAGE_NAME_SIZE];
+    uint64_t batches;
+    uint64_t samples;
+    uint64_t total_ns;
+    uint64_t max_ns;        // the slowest batch
+    uint64_t errors;        // batches the stage failed on
+};
+
 struct techartms_jdts_device_t {
     struct hw_device_t common;
 
     int (*read_sample)(unsigned short *psynchro, short *pobj_temp, short *pntc1_temp, short *pntc2_temp, short *pntc3_temp);
+    // the power and the mode this process asks for: the driver keeps them as the votes of
+    // its open file and weighs them against those of the other processes, until the next
+    // call or the close (see jdts_temperature.c)
     int (*activate)(unsigned char enabled);
     int (*set_mode)(unsigned char is_continuous);
+
+    // appends up to 'max_count' samples to 'batch', waiting for the first one only when
+    // the backend queues samples (the driver FIFO): it returns once the queue is drained.
+    // Returns the number of samples appended, 0 if the wait was cut short by cancel_reads(),
+    // or -1
+    int (*read_samples)(struct techartms_jdts_batch_t *batch, size_t max_count);
+
+    // every raw frame read from now on is also written to a capture file which can be
+    // replayed with the "replay:file=<path>" backend, returns 0 or -1
+    int (*start_capture)(const char *path);
+    int (*stop_capture)(void);
+
+    // keeps every sample read from now on in a compressed history under 'dir',
+    // NULL stops it, returns 0 or -1
+    int (*set_history)(const char *dir);
+    // visits the history samples with from_ms <= time < to_ms (wall clock), reads go on
+    // while the visitor runs. Returns the number of samples visited or -1
+    int (*query_history)(int64_t from_ms, int64_t to_ms, techartms_jdts_history_visitor_t visitor, void *cookie);
+    // aggregates over from_ms <= time < to_ms, one per 'resolution_ms' rounded down to whole
+    // 1s/1min/1h buckets, empty ones are skipped. Returns the number written to 'out' or -1
+    int (*query_rollups)(int64_t from_ms, int64_t to_ms, int64_t resolution_ms,
+            struct techartms_jdts_rollup_t *out, size_t max_count);
+
+    // sets the filter of 'channel' (TECHART_MS_JDTS_CHANNEL_*) and restarts it from the
+    // next sample, 'filtered' then carries its output. Returns 0 or -1 for an invalid filter
+    int (*set_filter)(int channel, const struct techartms_jdts_filter_t *filter);
+
+    // copies the counters of up to 'max_count' stages, in the order they run,
+    // returns the number of stages
+    int (*get_stage_stats)(struct techartms_jdts_stage_stats_t *out, size_t max_count);
+
+    // while 'cancel' is set, read_samples() returns 0 instead of waiting for the sensor,
+    // the reads blocked at the time included, so that a reader thread can be stopped and
+    // joined whatever the sensor does. The 10 byte read of a single frame from the driver,
+    // a burst mode measurement, cannot be cut short and is left to finish. Returns 0 or -1
+    int (*cancel_reads)(int cancel);
 };
 
 __END_DECLS
 
-#endif // ANDROID_TECHART_MS_JDTS_INTERFACE_H
\ No newline at end of file
+#endif // ANDROID_TECHART_MS_JDTS_INTERFACE_H
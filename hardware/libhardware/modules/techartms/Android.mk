@@ -1,6 +1,25 @@
 # building path
 LOCAL_PATH := $(call my-dir)
 
+# sources shared between the HAL and the native tools working with raw JDTS data
+jdts_common_src_files := \
+    jdts_calibration.c \
+    jdts_capture.c \
+    jdts_compensation.c \
+    jdts_decode.c \
+    jdts_detect.c \
+    jdts_filter.c \
+    jdts_pipeline.c \
+    jdts_rollup.c \
+    jdts_store.c
+
+jdts_hal_src_files := \
+    sensor_jdts_temperature.c \
+    jdts_backend.c \
+    jdts_backend_device.c \
+    jdts_backend_replay.c \
+    jdts_backend_sim.c
+
 ifneq ($(TARGET_PRODUCT),sim)
 # modules` buildings follow one after another in a merged .mk file
 # this is why it is needed to clear the parameters beforehand
@@ -11,9 +30,11 @@ LOCAL_PRELINK_MODULE := false
 # this is where it will be in a loaded OS
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 # libs to build
-LOCAL_SHARED_LIBRARIES := liblog libcutils libhardware
+LOCAL_SHARED_LIBRARIES := liblog libcutils libhardware libm
 # source split with spaces
-LOCAL_SRC_FILES := sensor_jdts_temperature.c
+LOCAL_SRC_FILES := $(jdts_hal_src_files) $(jdts_common_src_files)
+# Tegra 3 has NEON, the frame decoder uses it
+LOCAL_ARM_NEON := true
 # output name (.default postfix matter. there are several 
 # types of postfixes, which are recofgnized at loading)
 LOCAL_MODULE := techartmsjdts.default
@@ -21,4 +42,90 @@ LOCAL_MODULE_TAGS := debug
 
 include $(BUILD_SHARED_LIBRARY)
 
-endif
\ No newline at end of file
+endif
+
+# the same decoding code for the offline analysis tools, on device and on the host
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(jdts_common_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)
+LOCAL_ARM_NEON := true
+LOCAL_MODULE := libjdts_common
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_STATIC_LIBRARY)
+
+# the reader thread of JdtsService, linked into libandroid_servers and, on the host,
+# into the bench, which runs it against the simulated sensor
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := jdts_reader.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH)
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)
+LOCAL_MODULE := libjdts_reader
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(jdts_common_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH) hardware/libhardware/include
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)
+# host builds are 32-bit x86, SSE2 is not on by default there
+ifneq ($(filter x86 x86_64,$(HOST_ARCH)),)
+LOCAL_CFLAGS += -msse2
+endif
+LOCAL_MODULE := libjdts_common
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+# the whole HAL on the host, running against the simulated sensor ("sim" backend)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(jdts_hal_src_files) $(jdts_common_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH) hardware/libhardware/include
+ifneq ($(filter x86 x86_64,$(HOST_ARCH)),)
+LOCAL_CFLAGS += -msse2
+endif
+LOCAL_MODULE := libjdts_hal
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := jdts_reader.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH) hardware/libhardware/include
+LOCAL_MODULE := libjdts_reader
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := jdts_hal_bench.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH) hardware/libhardware/include
+LOCAL_STATIC_LIBRARIES := libjdts_reader libjdts_hal libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt -lm
+LOCAL_MODULE := jdts_hal_bench
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# round trip test of the history store, with segments and a retention limit small enough
+# to be gone through in a few blocks. Built from the store sources rather than against
+# libjdts_common, whose sizes are the device ones
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := jdts_store_test.c jdts_store.c
+LOCAL_C_INCLUDES := $(LOCAL_PATH) hardware/libhardware/include
+LOCAL_CFLAGS += -DJDTS_STORE_SEGMENT_BYTES=16384 -DJDTS_STORE_MAX_BYTES=65536
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDLIBS := -lpthread -lm
+LOCAL_MODULE := jdts_store_test
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
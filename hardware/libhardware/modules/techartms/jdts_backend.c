@@ -0,0 +1,191 @@
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <cutils/log.h>
+
+#include "jdts_backend.h"
+
+#define     LOG_TAG  "TECHARTMS_JDTS"
+
+static const struct jdts_backend_ops_t *backends[] = {
+    &jdts_backend_device_ops,
+    &jdts_backend_sim_ops,
+    &jdts_backend_replay_ops,
+};
+
+int jdts_backend_open(struct jdts_backend_t *backend, const char *spec)
+{
+    const char *args = "";
+    size_t name_len;
+    size_t i;
+    int ret;
+
+    if (spec == NULL || spec[0] == '\0') {
+        spec = jdts_backend_device_ops.name;
+    }
+
+    name_len = strcspn(spec, ":");
+    if (spec[name_len] == ':') {
+        args = spec + name_len + 1;
+    }
+
+    memset(backend, 0, sizeof(*backend));
+    backend->fd = -1;
+    backend->cancel_fd = -1;
+
+    for (i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strlen(backends[i]->name) == name_len && strncmp(spec, backends[i]->name, name_len) == 0) {
+            backend->cancel_fd = eventfd(0, EFD_NONBLOCK);
+            if (backend->cancel_fd < 0) {
+                ret = -errno;
+                ALOGE("HAL - cannot create the cancel eventfd: %d", ret);
+                return ret;
+            }
+
+            backend->ops = backends[i];
+            ret = backend->ops->open(backend, args);
+            if (ret < 0) {
+                ALOGE("HAL - cannot open '%s' backend: %d", backend->ops->name, ret);
+                backend->ops = NULL;
+                close(backend->cancel_fd);
+                backend->cancel_fd = -1;
+            }
+            return ret;
+        }
+    }
+
+    ALOGE("HAL - unknown backend '%s'", spec);
+    return -EINVAL;
+}
+
+void jdts_backend_close(struct jdts_backend_t *backend)
+{
+    if (backend->ops != NULL) {
+        backend->ops->close(backend);
+        backend->ops = NULL;
+    }
+    if (backend->cancel_fd >= 0) {
+        close(backend->cancel_fd);
+        backend->cancel_fd = -1;
+    }
+}
+
+int jdts_backend_wait(struct jdts_backend_t *backend, int timeout_ms)
+{
+    struct pollfd pfd[2] = {
+        { backend->cancel_fd, POLLIN, 0 },
+        { backend->fd, POLLIN, 0 },
+    };
+    // not restarted after a signal, like the read it stands in front of
+    int ret = poll(pfd, 2, timeout_ms);
+
+    if (ret < 0) {
+        return -errno;
+    }
+    if (pfd[0].revents & POLLIN) {
+        return -ECANCELED;
+    }
+    return ret > 0 ? 1 : 0;
+}
+
+int jdts_backend_cancel(struct jdts_backend_t *backend, int cancel)
+{
+    eventfd_t value;
+
+    // the counter is the state: non-zero while cancelled, a read clears it whatever it holds
+    if (cancel) {
+        return eventfd_write(backend->cancel_fd, 1) < 0 ? -errno : 0;
+    }
+    if (eventfd_read(backend->cancel_fd, &value) < 0 && errno != EAGAIN) {
+        return -errno;
+    }
+    return 0;
+}
+
+const char *jdts_backend_option(const char *args, const char *key, char *value, size_t size)
+{
+    size_t key_len = strlen(key);
+    size_t len;
+    const char *p = args;
+
+    while (p != NULL && *p != '\0') {
+        len = strcspn(p, ",");
+        if (len > key_len && strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            len -= key_len + 1;
+            if (len >= size) {
+                len = size - 1;
+            }
+            memcpy(value, p + key_len + 1, len);
+            value[len] = '\0';
+            return value;
+        }
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+
+    return NULL;
+}
+
+int jdts_backend_stream_send(int fd, int status, const uint8_t *frame, int flags)
+{
+    uint8_t error_packet = (uint8_t)-status;
+    ssize_t ret;
+
+    if (status < 0) {
+        ret = send(fd, &error_packet, sizeof(error_packet), flags);
+    } else {
+        ret = send(fd, frame, TECHART_MS_JDTS_FRAME_SIZE, flags);
+    }
+    return ret < 0 ? -errno : 0;
+}
+
+int jdts_backend_stream_recv(int fd, uint8_t *frame)
+{
+    uint8_t packet[TECHART_MS_JDTS_FRAME_SIZE + 1];
+    ssize_t ret;
+
+    ret = recv(fd, packet, sizeof(packet), 0);
+    if (ret < 0) {
+        return -errno;
+    }
+    if (ret == 0) {
+        // the generator has nothing more to send, e.g. a capture has been replayed
+        return -ENODATA;
+    }
+    if (ret == 1) {
+        return -packet[0];
+    }
+    if (ret != TECHART_MS_JDTS_FRAME_SIZE) {
+        // the generator is gone
+        return -EPIPE;
+    }
+
+    memcpy(frame, packet, TECHART_MS_JDTS_FRAME_SIZE);
+    return 0;
+}
+
+int jdts_backend_stream_drain(int fd, uint8_t *frames, size_t max_count)
+{
+    uint8_t packet[TECHART_MS_JDTS_FRAME_SIZE + 1];
+    size_t count = 0;
+    ssize_t ret;
+
+    while (count < max_count) {
+        ret = recv(fd, packet, sizeof(packet), MSG_PEEK | MSG_DONTWAIT);
+        if (ret != TECHART_MS_JDTS_FRAME_SIZE) {
+            break;
+        }
+        if (recv(fd, frames + count * TECHART_MS_JDTS_FRAME_SIZE, TECHART_MS_JDTS_FRAME_SIZE, MSG_DONTWAIT) !=
+                TECHART_MS_JDTS_FRAME_SIZE) {
+            break;
+        }
+        count++;
+    }
+
+    return (int)count;
+}
@@ -0,0 +1,82 @@
+#ifndef ANDROID_TECHART_MS_JDTS_BACKEND_H
+#define ANDROID_TECHART_MS_JDTS_BACKEND_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_calibration.h"
+
+__BEGIN_DECLS
+
+// commands written to the driver, two bytes: [0] - command type, [1] - argument
+#define JDTS_CMD_TYPE_POWER         0x00
+#define JDTS_CMD_TYPE_MEAS_MODE     0x01
+
+#define JDTS_CMD_POWER_SLEEP        0x00
+#define JDTS_CMD_POWER_WAKEUP       0x01
+
+#define JDTS_CMD_MEAS_MODE_CONT     0x00
+#define JDTS_CMD_MEAS_MODE_BURST    0x01
+
+struct jdts_backend_t;
+
+// the HAL talks to the sensor through one of these, picked by the name given to
+// the module's open(): "" - /dev/jdts_temperature, "sim[:options]" - synthetic data,
+// "replay:file=<capture>[,options]" - a recorded capture
+struct jdts_backend_ops_t {
+    const char *name;
+    // 'args' is the part of the name after ':', may be empty; returns 0 or -errno
+    int (*open)(struct jdts_backend_t *backend, const char *args);
+    void (*close)(struct jdts_backend_t *backend);
+    // reads one TECHART_MS_JDTS_FRAME_SIZE frame, returns 0 or -errno
+    int (*read_frame)(struct jdts_backend_t *backend, uint8_t *frame);
+    // optional, reads up to 'max_count' frames in one go, waiting for the first one only.
+    // Returns the number of frames read or -errno
+    int (*read_frames)(struct jdts_backend_t *backend, uint8_t *frames, size_t max_count);
+    // returns 0 or -errno
+    int (*write_command)(struct jdts_backend_t *backend, uint8_t type, uint8_t arg);
+};
+
+struct jdts_backend_t {
+    const struct jdts_backend_ops_t *ops;
+    int fd;     // descriptor the frames come from, -1 if there is none
+    int cancel_fd;  // eventfd, readable while the reads are cancelled, see jdts_backend_wait()
+    void *priv;
+
+    // set by backends replaying data that was calibrated differently from this device
+    int has_calibration;
+    struct jdts_cal_model_t calibration[TECHART_MS_JDTS_CHANNEL_COUNT];
+};
+
+extern const struct jdts_backend_ops_t jdts_backend_device_ops;
+extern const struct jdts_backend_ops_t jdts_backend_sim_ops;
+extern const struct jdts_backend_ops_t jdts_backend_replay_ops;
+
+// picks the backend by the 'spec' prefix and opens it, returns 0 or -errno
+int jdts_backend_open(struct jdts_backend_t *backend, const char *spec);
+void jdts_backend_close(struct jdts_backend_t *backend);
+
+// waits up to 'timeout_ms' (-1 for ever) for backend->fd to be readable, returns 1 when
+// it is, 0 on timeout, -ECANCELED while jdts_backend_cancel() is set or -errno
+int jdts_backend_wait(struct jdts_backend_t *backend, int timeout_ms);
+// sets or clears the cancellation of the waits, returns 0 or -errno
+int jdts_backend_cancel(struct jdts_backend_t *backend, int cancel);
+
+// looks 'key' up in "key=value,key=value" options, returns 'value' or NULL if not there
+const char *jdts_backend_option(const char *args, const char *key, char *value, size_t size);
+
+// backends with a generator thread pass samples over a SOCK_SEQPACKET socketpair:
+// a frame-sized packet is a sample, a one byte packet is the errno of a failed read.
+// Both return 0 or -errno, recv returns the errno carried by an error packet
+int jdts_backend_stream_send(int fd, int status, const uint8_t *frame, int flags);
+int jdts_backend_stream_recv(int fd, uint8_t *frame);
+// receives the frames already queued, up to 'max_count', without waiting. Stops before
+// an error packet, which is left for the next recv. Returns the number of frames
+int jdts_backend_stream_drain(int fd, uint8_t *frames, size_t max_count);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_BACKEND_H
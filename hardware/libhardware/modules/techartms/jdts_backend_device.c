@@ -0,0 +1,100 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cutils/log.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_backend.h"
+
+#define     LOG_TAG  "TECHARTMS_JDTS"
+
+#define     DEVICE_NAME "/dev/jdts_temperature"
+
+// set at open when the driver predates the FIFO
+static int fifo_unsupported = 0;
+
+static int device_open(struct jdts_backend_t *backend, const char *args)
+{
+    struct pollfd pfd;
+
+    backend->fd = open(DEVICE_NAME, O_RDWR);
+    if (backend->fd < 0) {
+        return -errno;
+    }
+
+    // the FIFO driver implements poll() and never reports its file writable, a legacy
+    // driver without poll() reports it readable and writable at once
+    pfd.fd = backend->fd;
+    pfd.events = POLLIN | POLLOUT;
+    pfd.revents = 0;
+    fifo_unsupported = poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLOUT) != 0;
+    if (fifo_unsupported) {
+        ALOGI("HAL - the driver has no FIFO, reading single frames");
+    }
+    return 0;
+}
+
+static void device_close(struct jdts_backend_t *backend)
+{
+    if (backend->fd >= 0) {
+        close(backend->fd);
+        backend->fd = -1;
+    }
+}
+
+static int device_read_frame(struct jdts_backend_t *backend, uint8_t *frame)
+{
+    // the driver hands out exactly one frame per read() call
+    if (read(backend->fd, (char*)frame, TECHART_MS_JDTS_FRAME_SIZE) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+static int device_read_frames(struct jdts_backend_t *backend, uint8_t *frames, size_t max_count)
+{
+    ssize_t ret;
+
+    if (max_count < 2 || fifo_unsupported) {
+        ret = device_read_frame(backend, frames);
+        return ret < 0 ? (int)ret : 1;
+    }
+
+    // a read of more than one frame drains the driver FIFO, see jdts_temperature.c.
+    // It waits in poll() first, where jdts_backend_cancel() can end the wait. The driver
+    // blocks rather than return nothing, an empty read is waited for again all the same
+    for (;;) {
+        ret = jdts_backend_wait(backend, -1);
+        if (ret < 0) {
+            return (int)ret;
+        }
+        ret = read(backend->fd, (char*)frames, max_count * TECHART_MS_JDTS_FRAME_SIZE);
+        if (ret > 0) {
+            return (int)(ret / TECHART_MS_JDTS_FRAME_SIZE);
+        }
+        if (ret < 0) {
+            return -errno;
+        }
+    }
+}
+
+static int device_write_command(struct jdts_backend_t *backend, uint8_t type, uint8_t arg)
+{
+    uint8_t control_buffer[2] = { type, arg };
+
+    if (write(backend->fd, (char*)control_buffer, sizeof(control_buffer)) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+const struct jdts_backend_ops_t jdts_backend_device_ops = {
+    .name = "dev",
+    .open = device_open,
+    .close = device_close,
+    .read_frame = device_read_frame,
+    .read_frames = device_read_frames,
+    .write_command = device_write_command,
+};
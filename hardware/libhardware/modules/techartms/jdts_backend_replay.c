@@ -0,0 +1,204 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <cutils/log.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_backend.h"
+#include "jdts_capture.h"
+
+#define     LOG_TAG  "TECHARTMS_JDTS"
+
+/*
+Replays a capture written by the HAL recorder (see jdts_capture.h) through the same
+socketpair path the simulated sensor uses. Frames keep their recorded order, failed
+reads are reproduced as failed reads and the HAL switches to the calibration the
+capture was recorded with. Options:
+
+file=<path>         capture to replay, required
+speed=<x>           time scale, 1 - original timing, 4 - four times faster,
+                    0 - as fast as the reader takes them (default 1)
+loop=<0|1>          start over at the end of the capture instead of reporting
+                    -ENODATA (default 0)
+*/
+
+#define     REPLAY_PATH_MAX     256
+// long pauses in a capture are slept through in steps, so that close() is not held up
+#define     REPLAY_SLEEP_STEP_NS    100000000LL
+
+struct replay_state_t {
+    pthread_t thread;
+    int peer;
+    volatile int running;
+
+    struct jdts_capture_reader_t reader;
+    double speed;
+    int loop;
+};
+
+static void *replay_thread(void *arg)
+{
+    struct replay_state_t *replay = (struct replay_state_t *)arg;
+    struct jdts_capture_record_t record;
+    struct timespec due;
+    int64_t start = jdts_monotonic_ns();
+    int64_t offset = 0;     // capture time of the current pass start when looping
+    int64_t last = 0;
+    int64_t t;
+    int ret;
+
+    while (replay->running) {
+        ret = jdts_capture_read(&replay->reader, &record);
+        if (ret == 0 && replay->loop && last > offset) {
+            offset = last;
+            jdts_capture_rewind(&replay->reader);
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        last = offset + record.timestamp_ns;
+
+        // paced against the start of the replay, so the error does not accumulate
+        if (replay->speed > 0) {
+            t = start + (int64_t)(last / replay->speed);
+            while (replay->running && t - jdts_monotonic_ns() > REPLAY_SLEEP_STEP_NS) {
+                usleep(REPLAY_SLEEP_STEP_NS / 1000);
+            }
+            due.tv_sec = (time_t)(t / 1000000000LL);
+            due.tv_nsec = (long)(t % 1000000000LL);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+        }
+
+        // blocking: a replay must not lose samples to a slow reader
+        if (jdts_backend_stream_send(replay->peer, record.status, record.frame, 0) < 0) {
+            break;
+        }
+    }
+
+    // the reader gets -ENODATA once everything sent has been read
+    shutdown(replay->peer, SHUT_WR);
+    return NULL;
+}
+
+static int replay_open(struct jdts_backend_t *backend, const char *args)
+{
+    struct replay_state_t *replay;
+    char path[REPLAY_PATH_MAX];
+    char value[16];
+    int sv[2];
+    int ret;
+
+    if (jdts_backend_option(args, "file", path, sizeof(path)) == NULL) {
+        ALOGE("HAL - replay backend needs a file=<capture> option");
+        return -EINVAL;
+    }
+
+    replay = calloc(1, sizeof(*replay));
+    if (replay == NULL) {
+        return -ENOMEM;
+    }
+
+    replay->speed = 1.0;
+    if (jdts_backend_option(args, "speed", value, sizeof(value)) != NULL) {
+        replay->speed = strtod(value, NULL);
+    }
+    if (jdts_backend_option(args, "loop", value, sizeof(value)) != NULL) {
+        replay->loop = atoi(value);
+    }
+
+    ret = jdts_capture_reader_open(&replay->reader, path);
+    if (ret < 0) {
+        ALOGE("HAL - cannot open capture %s: %d", path, ret);
+        free(replay);
+        return ret;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        ret = -errno;
+        jdts_capture_reader_close(&replay->reader);
+        free(replay);
+        return ret;
+    }
+
+    backend->fd = sv[0];
+    backend->priv = replay;
+    backend->has_calibration = 1;
+    memcpy(backend->calibration, replay->reader.header.calibration, sizeof(backend->calibration));
+    replay->peer = sv[1];
+    replay->running = 1;
+
+    if (pthread_create(&replay->thread, NULL, replay_thread, replay) != 0) {
+        close(sv[0]);
+        close(sv[1]);
+        jdts_capture_reader_close(&replay->reader);
+        free(replay);
+        backend->fd = -1;
+        backend->priv = NULL;
+        return -EAGAIN;
+    }
+
+    ALOGI("HAL - replaying %s recorded on '%s' at speed %.1f", path,
+            replay->reader.header.device, replay->speed);
+    return 0;
+}
+
+static void replay_close(struct jdts_backend_t *backend)
+{
+    struct replay_state_t *replay = (struct replay_state_t *)backend->priv;
+
+    replay->running = 0;
+    shutdown(backend->fd, SHUT_RDWR);
+    pthread_join(replay->thread, NULL);
+
+    close(backend->fd);
+    close(replay->peer);
+    jdts_capture_reader_close(&replay->reader);
+    free(replay);
+
+    backend->fd = -1;
+    backend->priv = NULL;
+}
+
+static int replay_read_frame(struct jdts_backend_t *backend, uint8_t *frame)
+{
+    int ret = jdts_backend_wait(backend, -1);
+
+    if (ret < 0) {
+        return ret;
+    }
+    return jdts_backend_stream_recv(backend->fd, frame);
+}
+
+static int replay_read_frames(struct jdts_backend_t *backend, uint8_t *frames, size_t max_count)
+{
+    int ret = replay_read_frame(backend, frames);
+
+    if (ret < 0) {
+        return ret;
+    }
+    return 1 + jdts_backend_stream_drain(backend->fd, frames + TECHART_MS_JDTS_FRAME_SIZE, max_count - 1);
+}
+
+static int replay_write_command(struct jdts_backend_t *backend, uint8_t type, uint8_t arg)
+{
+    // the recorded stream is what it is, commands are accepted and ignored
+    if (type != JDTS_CMD_TYPE_POWER && type != JDTS_CMD_TYPE_MEAS_MODE) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+const struct jdts_backend_ops_t jdts_backend_replay_ops = {
+    .name = "replay",
+    .open = replay_open,
+    .close = replay_close,
+    .read_frame = replay_read_frame,
+    .read_frames = replay_read_frames,
+    .write_command = replay_write_command,
+};
@@ -0,0 +1,362 @@
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <cutils/log.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_backend.h"
+
+#define     LOG_TAG  "TECHARTMS_JDTS"
+
+/*
+Simulated sensor: a generator thread writes frames into one end of a SOCK_SEQPACKET
+socketpair at the requested rate, the HAL reads them from the other end, so reads go
+through a real blocking syscall just as with the driver. Options:
+
+rate=<Hz>           samples per second, 0 - as fast as the reader takes them (default 10)
+wave=<shape>        sine, ramp, square or const (default sine)
+period=<s>          waveform period (default 60)
+obj=<C>             object temperature the waveform swings around (default 36.6)
+amp=<C>             object waveform amplitude, NTCs swing a tenth of it (default 5)
+noise=<C>           peak uniform noise added to every channel (default 0.05)
+errors=<p>          probability of a failed I2C read instead of a sample (default 0)
+gaps=<p>            probability of the synchro counter skipping samples (default 0)
+seed=<n>            random generator seed, runs with the same seed are identical
+burst=<ms>          time a burst mode measurement takes (default 0, the sensor takes 250)
+
+The reads are modelled as the driver has them. The socket is the driver FIFO: a read of
+several frames waits for the generator, which only measures while the sensor is powered
+and in continuous mode. A single frame read returns the latest sample at once, in burst
+mode it makes a measurement first, whatever the power, and returns that one.
+*/
+
+#define     SIM_NTC_BASE            25.0
+#define     SIM_MAX_GAP             16
+// an unpaced generator rechecks the power this often while the sensor does not measure
+#define     SIM_POWER_POLL_MS       100
+
+enum {
+    SIM_WAVE_SINE = 0,
+    SIM_WAVE_RAMP,
+    SIM_WAVE_SQUARE,
+    SIM_WAVE_CONST
+};
+
+struct sim_state_t {
+    pthread_t thread;
+    int peer;
+    volatile int running;
+    volatile int powered;
+    volatile int burst;
+
+    double rate;
+    int wave;
+    double period;
+    double obj;
+    double amp;
+    double noise;
+    double error_probability;
+    double gap_probability;
+    int burst_ms;
+
+    pthread_mutex_t lock;   // guards the rest, written by the generator and burst reads
+    uint32_t rng;
+    uint16_t synchro;
+    uint64_t index;
+    uint8_t last_frame[TECHART_MS_JDTS_FRAME_SIZE];
+};
+
+static double option_double(const char *args, const char *key, double def)
+{
+    char value[32];
+
+    if (jdts_backend_option(args, key, value, sizeof(value)) == NULL) {
+        return def;
+    }
+    return strtod(value, NULL);
+}
+
+// xorshift32, keeps runs reproducible for a given seed
+static double next_random(struct sim_state_t *sim)
+{
+    uint32_t x = sim->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->rng = x;
+    return (x >> 8) / (double)(1 << 24);
+}
+
+static double waveform(const struct sim_state_t *sim, double t)
+{
+    double phase = fmod(t, sim->period) / sim->period;
+
+    switch (sim->wave) {
+    case SIM_WAVE_RAMP:
+        return 2.0 * phase - 1.0;
+    case SIM_WAVE_SQUARE:
+        return phase < 0.5 ? 1.0 : -1.0;
+    case SIM_WAVE_CONST:
+        return 0.0;
+    default:
+        return sin(2.0 * M_PI * phase);
+    }
+}
+
+static void put_le16(uint8_t *p, int value)
+{
+    p[0] = (uint8_t)(value & 0xff);
+    p[1] = (uint8_t)((value >> 8) & 0xff);
+}
+
+static int to_raw(double celsius)
+{
+    double v = floor(celsius * 100.0 + 0.5);
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int)v;
+}
+
+static void make_frame(struct sim_state_t *sim, uint8_t *frame)
+{
+    // unpaced runs are laid out on a nominal 10 Hz time axis
+    double t = sim->index / (sim->rate > 0 ? sim->rate : 10.0);
+    double w = waveform(sim, t);
+
+    put_le16(frame + 0, to_raw(sim->obj + sim->amp * w + sim->noise * (2.0 * next_random(sim) - 1.0)));
+    put_le16(frame + 2, sim->synchro);
+    put_le16(frame + 4, to_raw(SIM_NTC_BASE + 0.1 * sim->amp * w + sim->noise * (2.0 * next_random(sim) - 1.0)));
+    put_le16(frame + 6, to_raw(SIM_NTC_BASE + 0.2 + 0.1 * sim->amp * w + sim->noise * (2.0 * next_random(sim) - 1.0)));
+    put_le16(frame + 8, to_raw(SIM_NTC_BASE - 0.2 + 0.1 * sim->amp * w + sim->noise * (2.0 * next_random(sim) - 1.0)));
+}
+
+// the next sample into 'frame', or -EIO for a failed I2C read. Called with the lock held
+static int next_measurement(struct sim_state_t *sim, uint8_t *frame)
+{
+    int status = 0;
+
+    if (sim->gap_probability > 0 && next_random(sim) < sim->gap_probability) {
+        int skipped = 1 + (int)(next_random(sim) * SIM_MAX_GAP);
+        sim->synchro += skipped;
+        sim->index += skipped;
+    }
+
+    if (sim->error_probability > 0 && next_random(sim) < sim->error_probability) {
+        status = -EIO;
+    } else {
+        make_frame(sim, frame);
+    }
+
+    sim->synchro++;
+    sim->index++;
+    return status;
+}
+
+static void advance_deadline(struct timespec *deadline, double rate)
+{
+    long period_ns = (long)(1e9 / rate);
+
+    deadline->tv_nsec += period_ns;
+    while (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_nsec -= 1000000000L;
+        deadline->tv_sec++;
+    }
+}
+
+static void *generator_thread(void *arg)
+{
+    struct sim_state_t *sim = (struct sim_state_t *)arg;
+    uint8_t frame[TECHART_MS_JDTS_FRAME_SIZE];
+    struct timespec deadline;
+    int flags = sim->rate > 0 ? MSG_DONTWAIT : 0;
+    int status;
+    int ret;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    while (sim->running) {
+        if (sim->rate > 0) {
+            advance_deadline(&deadline, sim->rate);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        }
+
+        // a sleeping sensor does not measure, in burst mode only the reads do
+        if (!sim->powered || sim->burst) {
+            if (sim->rate <= 0) {
+                usleep(SIM_POWER_POLL_MS * 1000);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&sim->lock);
+        status = next_measurement(sim, frame);
+        if (status == 0) {
+            memcpy(sim->last_frame, frame, TECHART_MS_JDTS_FRAME_SIZE);
+        }
+        pthread_mutex_unlock(&sim->lock);
+
+        // with a fixed rate a slow reader loses samples, the counter shows the gap
+        ret = jdts_backend_stream_send(sim->peer, status, status < 0 ? NULL : frame, flags);
+        if (ret < 0 && ret != -EAGAIN && ret != -EWOULDBLOCK) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static int sim_open(struct jdts_backend_t *backend, const char *args)
+{
+    struct sim_state_t *sim;
+    char value[16];
+    int sv[2];
+
+    sim = calloc(1, sizeof(*sim));
+    if (sim == NULL) {
+        return -ENOMEM;
+    }
+
+    sim->rate = option_double(args, "rate", 10.0);
+    sim->period = option_double(args, "period", 60.0);
+    sim->obj = option_double(args, "obj", 36.6);
+    sim->amp = option_double(args, "amp", 5.0);
+    sim->noise = option_double(args, "noise", 0.05);
+    sim->error_probability = option_double(args, "errors", 0.0);
+    sim->gap_probability = option_double(args, "gaps", 0.0);
+    sim->burst_ms = (int)option_double(args, "burst", 0.0);
+    sim->rng = (uint32_t)option_double(args, "seed", 1.0);
+    if (sim->rng == 0) {
+        sim->rng = 1;
+    }
+    if (sim->period <= 0) {
+        sim->period = 60.0;
+    }
+
+    sim->wave = SIM_WAVE_SINE;
+    if (jdts_backend_option(args, "wave", value, sizeof(value)) != NULL) {
+        if (strcmp(value, "ramp") == 0) sim->wave = SIM_WAVE_RAMP;
+        else if (strcmp(value, "square") == 0) sim->wave = SIM_WAVE_SQUARE;
+        else if (strcmp(value, "const") == 0) sim->wave = SIM_WAVE_CONST;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        free(sim);
+        return -errno;
+    }
+
+    backend->fd = sv[0];
+    sim->peer = sv[1];
+    sim->running = 1;
+    sim->powered = 1;
+    pthread_mutex_init(&sim->lock, NULL);
+    make_frame(sim, sim->last_frame);
+    backend->priv = sim;
+
+    if (pthread_create(&sim->thread, NULL, generator_thread, sim) != 0) {
+        close(sv[0]);
+        close(sv[1]);
+        pthread_mutex_destroy(&sim->lock);
+        free(sim);
+        backend->fd = -1;
+        backend->priv = NULL;
+        return -EAGAIN;
+    }
+
+    ALOGI("HAL - simulated sensor at %.1f Hz started", sim->rate);
+    return 0;
+}
+
+static void sim_close(struct jdts_backend_t *backend)
+{
+    struct sim_state_t *sim = (struct sim_state_t *)backend->priv;
+
+    sim->running = 0;
+    // unblocks both a generator waiting for room and a reader waiting for data
+    shutdown(backend->fd, SHUT_RDWR);
+    pthread_join(sim->thread, NULL);
+
+    close(backend->fd);
+    close(sim->peer);
+    pthread_mutex_destroy(&sim->lock);
+    free(sim);
+
+    backend->fd = -1;
+    backend->priv = NULL;
+}
+
+static int sim_read_frame(struct jdts_backend_t *backend, uint8_t *frame)
+{
+    struct sim_state_t *sim = (struct sim_state_t *)backend->priv;
+    int burst = sim->burst;
+    int ret = 0;
+
+    // a burst mode measurement, it goes to the caller only and not through the socket,
+    // as the driver does not queue it in its FIFO
+    if (burst && sim->burst_ms > 0) {
+        usleep(sim->burst_ms * 1000);
+    }
+    pthread_mutex_lock(&sim->lock);
+    if (burst) {
+        ret = next_measurement(sim, frame);
+        if (ret == 0) {
+            memcpy(sim->last_frame, frame, TECHART_MS_JDTS_FRAME_SIZE);
+        }
+    } else {
+        memcpy(frame, sim->last_frame, TECHART_MS_JDTS_FRAME_SIZE);
+    }
+    pthread_mutex_unlock(&sim->lock);
+    return ret;
+}
+
+static int sim_read_frames(struct jdts_backend_t *backend, uint8_t *frames, size_t max_count)
+{
+    int ret;
+
+    // waits for the generator however long the sensor sleeps, like a read of the FIFO
+    ret = jdts_backend_wait(backend, -1);
+    if (ret < 0) {
+        return ret;
+    }
+    ret = jdts_backend_stream_recv(backend->fd, frames);
+    if (ret < 0) {
+        return ret;
+    }
+
+    return 1 + jdts_backend_stream_drain(backend->fd, frames + TECHART_MS_JDTS_FRAME_SIZE, max_count - 1);
+}
+
+static int sim_write_command(struct jdts_backend_t *backend, uint8_t type, uint8_t arg)
+{
+    struct sim_state_t *sim = (struct sim_state_t *)backend->priv;
+
+    if (type == JDTS_CMD_TYPE_POWER) {
+        if (arg != JDTS_CMD_POWER_SLEEP && arg != JDTS_CMD_POWER_WAKEUP) {
+            return -EINVAL;
+        }
+        sim->powered = (arg == JDTS_CMD_POWER_WAKEUP);
+    } else if (type == JDTS_CMD_TYPE_MEAS_MODE) {
+        if (arg != JDTS_CMD_MEAS_MODE_CONT && arg != JDTS_CMD_MEAS_MODE_BURST) {
+            return -EINVAL;
+        }
+        sim->burst = (arg == JDTS_CMD_MEAS_MODE_BURST);
+    } else {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+const struct jdts_backend_ops_t jdts_backend_sim_ops = {
+    .name = "sim",
+    .open = sim_open,
+    .close = sim_close,
+    .read_frame = sim_read_frame,
+    .read_frames = sim_read_frames,
+    .write_command = sim_write_command,
+};
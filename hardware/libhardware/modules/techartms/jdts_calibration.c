@@ -0,0 +1,194 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/log.h>
+
+#include "jdts_calibration.h"
+
+#define     LOG_TAG  "TECHARTMS_JDTS"
+
+#define     KELVIN_OFFSET   273.15
+#define     KELVIN_25C      298.15
+
+// knots are kept within this range, so that the interpolation never overflows int32
+#define     LUT_VALUE_LIMIT 65535
+
+static const char *channel_names[TECHART_MS_JDTS_CHANNEL_COUNT] = {
+    "obj", "ntc1", "ntc2", "ntc3"
+};
+
+void jdts_calibration_reset(struct jdts_calibration_t *cal)
+{
+    int ch;
+
+    memset(cal, 0, sizeof(*cal));
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        jdts_calibration_build(cal, ch);
+    }
+}
+
+static double evaluate_model(const struct jdts_cal_model_t *model, double t)
+{
+    const double *c = model->coeffs;
+    double r, ln_r;
+
+    switch (model->type) {
+    case JDTS_CAL_MODEL_POLY:
+        return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+
+    case JDTS_CAL_MODEL_STEINHART_HART:
+        // the beta model the sensor applied, solved for the resistance
+        r = c[3] * exp(c[4] * (1.0 / (t + KELVIN_OFFSET) - 1.0 / KELVIN_25C));
+        if (!(r > 0.0) || isinf(r)) {
+            return t;
+        }
+        ln_r = log(r);
+        return 1.0 / (c[0] + c[1] * ln_r + c[2] * ln_r * ln_r * ln_r) - KELVIN_OFFSET;
+
+    default:
+        return t;
+    }
+}
+
+void jdts_calibration_build(struct jdts_calibration_t *cal, int channel)
+{
+    const struct jdts_cal_model_t *model = &cal->models[channel];
+    int32_t *lut = cal->lut[channel];
+    double v;
+    int k;
+
+    for (k = 0; k < JDTS_CAL_LUT_SIZE; k++) {
+        int32_t raw = (k << JDTS_CAL_LUT_SHIFT) - 32768;
+
+        v = floor(evaluate_model(model, raw / 100.0) * 100.0 + 0.5);
+        if (isnan(v)) {
+            v = raw;
+        } else if (v > LUT_VALUE_LIMIT) {
+            v = LUT_VALUE_LIMIT;
+        } else if (v < -LUT_VALUE_LIMIT) {
+            v = -LUT_VALUE_LIMIT;
+        }
+        lut[k] = (int32_t)v;
+    }
+}
+
+static int parse_line(struct jdts_cal_model_t *models, char *line)
+{
+    struct jdts_cal_model_t model;
+    char *save = NULL;
+    char *token;
+    char *end;
+    int channel;
+    int count = 0;
+    int expected_min, expected_max;
+
+    token = strtok_r(line, " \t\r\n", &save);
+    if (token == NULL || token[0] == '#') {
+        return 0;
+    }
+
+    for (channel = 0; channel < TECHART_MS_JDTS_CHANNEL_COUNT; channel++) {
+        if (strcmp(token, channel_names[channel]) == 0) {
+            break;
+        }
+    }
+    if (channel == TECHART_MS_JDTS_CHANNEL_COUNT) {
+        ALOGE("HAL - calibration: unknown channel '%s'", token);
+        return -EINVAL;
+    }
+
+    memset(&model, 0, sizeof(model));
+    token = strtok_r(NULL, " \t\r\n", &save);
+    if (token != NULL && strcmp(token, "poly") == 0) {
+        model.type = JDTS_CAL_MODEL_POLY;
+        // a lone c0 would map every temperature to one value
+        expected_min = 2;
+        expected_max = 4;
+    } else if (token != NULL && strcmp(token, "sh") == 0) {
+        model.type = JDTS_CAL_MODEL_STEINHART_HART;
+        expected_min = expected_max = 5;
+    } else {
+        ALOGE("HAL - calibration: unknown model for channel '%s'", channel_names[channel]);
+        return -EINVAL;
+    }
+
+    while ((token = strtok_r(NULL, " \t\r\n", &save)) != NULL && token[0] != '#') {
+        if (count == expected_max) {
+            ALOGE("HAL - calibration: too many coefficients for channel '%s'", channel_names[channel]);
+            return -EINVAL;
+        }
+        model.coeffs[count++] = strtod(token, &end);
+        if (*end != '\0') {
+            ALOGE("HAL - calibration: bad coefficient '%s'", token);
+            return -EINVAL;
+        }
+    }
+
+    if (count < expected_min) {
+        ALOGE("HAL - calibration: not enough coefficients for channel '%s'", channel_names[channel]);
+        return -EINVAL;
+    }
+
+    models[channel] = model;
+    return 0;
+}
+
+int jdts_calibration_load(struct jdts_calibration_t *cal, const char *path)
+{
+    struct jdts_cal_model_t models[TECHART_MS_JDTS_CHANNEL_COUNT];
+    char line[256];
+    int number = 0;
+    int ret = 0;
+    int ch;
+    FILE *file;
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        jdts_calibration_reset(cal);
+        return -ENOENT;
+    }
+
+    // parsed aside, never run with a half-applied calibration
+    memset(models, 0, sizeof(models));
+    while (fgets(line, sizeof(line), file) != NULL) {
+        number++;
+        ret = parse_line(models, line);
+        if (ret < 0) {
+            break;
+        }
+    }
+    fclose(file);
+
+    if (ret < 0) {
+        ALOGE("HAL - calibration: %s is malformed at line %d, the previous calibration is kept",
+                path, number);
+        return ret;
+    }
+
+    // all the floating point work is done here, once
+    memcpy(cal->models, models, sizeof(cal->models));
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        jdts_calibration_build(cal, ch);
+    }
+
+    return 0;
+}
+
+void jdts_calibration_apply(const struct jdts_calibration_t *cal, int channel,
+        const int16_t *in, int16_t *out, size_t count)
+{
+    size_t i;
+
+    if (cal->models[channel].type == JDTS_CAL_MODEL_NONE) {
+        if (in != out) {
+            memcpy(out, in, count * sizeof(*out));
+        }
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        out[i] = jdts_calibration_correct(cal, channel, in[i]);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef ANDROID_TECHART_MS_JDTS_CALIBRATION_H
+#define ANDROID_TECHART_MS_JDTS_CALIBRATION_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+__BEGIN_DECLS
+
+#define JDTS_CALIBRATION_FILE "/data/calibration/jdts.conf"
+
+/*
+The calibration file has one line per corrected channel, '#' starts a comment:
+
+<channel> poly <c0> <c1> [c2] [c3]
+    T = c0 + c1*t + c2*t^2 + c3*t^3, where t is the reported temperature in C
+<channel> sh <A> <B> <C> <R25> <beta>
+    the sensor converts NTC resistance with the nominal beta model (R25, beta),
+    the resistance is recovered from it and converted back with Steinhart-Hart:
+    1/T = A + B*ln(R) + C*ln(R)^3, T in K
+
+<channel> is one of obj, ntc1, ntc2, ntc3
+*/
+
+enum {
+    JDTS_CAL_MODEL_NONE = 0,
+    JDTS_CAL_MODEL_POLY,
+    JDTS_CAL_MODEL_STEINHART_HART
+};
+
+#define JDTS_CAL_MAX_COEFFS     5
+
+// the correction is tabulated over the whole int16 range of raw values with a knot every
+// (1 << JDTS_CAL_LUT_SHIFT) raw units (0.16C), values between knots are interpolated.
+// The interpolation is off by at most h^2/8 * |T''| for a knot spacing h, under the
+// 0.01C resolution wherever the curvature of a model stays below 3 per C
+#define JDTS_CAL_LUT_SHIFT      4
+#define JDTS_CAL_LUT_SIZE       ((65536 >> JDTS_CAL_LUT_SHIFT) + 1)
+
+struct jdts_cal_model_t {
+    int type;
+    double coeffs[JDTS_CAL_MAX_COEFFS];
+};
+
+struct jdts_calibration_t {
+    struct jdts_cal_model_t models[TECHART_MS_JDTS_CHANNEL_COUNT];
+    // corrected temperatures in 0.01C at every knot
+    int32_t lut[TECHART_MS_JDTS_CHANNEL_COUNT][JDTS_CAL_LUT_SIZE];
+};
+
+// sets every channel to pass raw values through
+void jdts_calibration_reset(struct jdts_calibration_t *cal);
+
+// parses the coefficients and builds the tables, channels not mentioned in the file
+// are left uncorrected. Returns 0, -ENOENT if there is no file, every channel is then
+// uncorrected, or -EINVAL on a bad line, the calibration in 'cal' is then kept as it was
+int jdts_calibration_load(struct jdts_calibration_t *cal, const char *path);
+
+// builds the table of one channel from its model
+void jdts_calibration_build(struct jdts_calibration_t *cal, int channel);
+
+static inline int16_t jdts_calibration_correct(const struct jdts_calibration_t *cal, int channel, int16_t raw)
+{
+    const int32_t *lut = cal->lut[channel];
+    uint32_t u = (uint32_t)(raw + 32768);
+    uint32_t idx = u >> JDTS_CAL_LUT_SHIFT;
+    int32_t frac = (int32_t)(u & ((1 << JDTS_CAL_LUT_SHIFT) - 1));
+    int32_t v = lut[idx] + (((lut[idx + 1] - lut[idx]) * frac + (1 << (JDTS_CAL_LUT_SHIFT - 1))) >>
+            JDTS_CAL_LUT_SHIFT);
+
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+// corrects 'count' values of a channel, 'in' and 'out' may be the same array
+void jdts_calibration_apply(const struct jdts_calibration_t *cal, int channel,
+        const int16_t *in, int16_t *out, size_t count);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_CALIBRATION_H
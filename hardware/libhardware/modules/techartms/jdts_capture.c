@@ -0,0 +1,199 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jdts_capture.h"
+
+#define     CAPTURE_CALIBRATION_OFFSET  64
+#define     CAPTURE_CALIBRATION_SIZE    48
+// records are written through a stdio buffer, the flash sees large writes only
+#define     CAPTURE_BUFFER_SIZE         (64 * 1024)
+
+int64_t jdts_monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void put_le(uint8_t *p, uint64_t value, int size)
+{
+    int i;
+    for (i = 0; i < size; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t *p, int size)
+{
+    uint64_t value = 0;
+    int i;
+    for (i = 0; i < size; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+static void put_double(uint8_t *p, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    put_le(p, bits, 8);
+}
+
+static double get_double(const uint8_t *p)
+{
+    uint64_t bits = get_le(p, 8);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+int jdts_capture_writer_open(struct jdts_capture_writer_t *writer, const char *path,
+        const char *device, const struct jdts_calibration_t *cal)
+{
+    uint8_t header[JDTS_CAPTURE_HEADER_SIZE];
+    struct timespec now;
+    uint8_t *p;
+    int ch, i;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, JDTS_CAPTURE_MAGIC, 8);
+    put_le(header + 8, JDTS_CAPTURE_VERSION, 2);
+    put_le(header + 10, JDTS_CAPTURE_HEADER_SIZE, 2);
+    put_le(header + 12, JDTS_CAPTURE_RECORD_SIZE, 2);
+    put_le(header + 14, TECHART_MS_JDTS_FRAME_SIZE, 2);
+    clock_gettime(CLOCK_REALTIME, &now);
+    put_le(header + 16, (uint64_t)((int64_t)now.tv_sec * 1000000000LL + now.tv_nsec), 8);
+    if (device != NULL) {
+        strncpy((char *)header + 24, device, JDTS_CAPTURE_DEVICE_SIZE - 1);
+    }
+
+    for (ch = 0; cal != NULL && ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        p = header + CAPTURE_CALIBRATION_OFFSET + ch * CAPTURE_CALIBRATION_SIZE;
+        put_le(p, (uint32_t)cal->models[ch].type, 4);
+        for (i = 0; i < JDTS_CAL_MAX_COEFFS; i++) {
+            put_double(p + 8 + i * 8, cal->models[ch].coeffs[i]);
+        }
+    }
+
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        return -errno;
+    }
+    setvbuf(writer->file, NULL, _IOFBF, CAPTURE_BUFFER_SIZE);
+
+    if (fwrite(header, sizeof(header), 1, writer->file) != 1) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return -EIO;
+    }
+
+    writer->start_ns = jdts_monotonic_ns();
+    return 0;
+}
+
+int jdts_capture_write(struct jdts_capture_writer_t *writer, int64_t timestamp_ns,
+        int status, const uint8_t *frame)
+{
+    uint8_t record[JDTS_CAPTURE_RECORD_SIZE];
+
+    put_le(record, (uint64_t)(timestamp_ns - writer->start_ns), 8);
+    put_le(record + 8, (uint16_t)(int16_t)status, 2);
+    if (status == 0 && frame != NULL) {
+        memcpy(record + 10, frame, TECHART_MS_JDTS_FRAME_SIZE);
+    } else {
+        memset(record + 10, 0, TECHART_MS_JDTS_FRAME_SIZE);
+    }
+
+    if (fwrite(record, sizeof(record), 1, writer->file) != 1) {
+        return -EIO;
+    }
+    return 0;
+}
+
+int jdts_capture_writer_close(struct jdts_capture_writer_t *writer)
+{
+    int ret = 0;
+
+    if (writer->file != NULL) {
+        if (fclose(writer->file) != 0) {
+            ret = -errno;
+        }
+        writer->file = NULL;
+    }
+    return ret;
+}
+
+int jdts_capture_reader_open(struct jdts_capture_reader_t *reader, const char *path)
+{
+    uint8_t header[JDTS_CAPTURE_HEADER_SIZE];
+    const uint8_t *p;
+    int ch, i;
+
+    memset(reader, 0, sizeof(*reader));
+
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) {
+        return -errno;
+    }
+    setvbuf(reader->file, NULL, _IOFBF, CAPTURE_BUFFER_SIZE);
+
+    if (fread(header, sizeof(header), 1, reader->file) != 1 ||
+            memcmp(header, JDTS_CAPTURE_MAGIC, 8) != 0 ||
+            get_le(header + 8, 2) != JDTS_CAPTURE_VERSION ||
+            get_le(header + 10, 2) != JDTS_CAPTURE_HEADER_SIZE ||
+            get_le(header + 12, 2) != JDTS_CAPTURE_RECORD_SIZE ||
+            get_le(header + 14, 2) != TECHART_MS_JDTS_FRAME_SIZE) {
+        fclose(reader->file);
+        reader->file = NULL;
+        return -EINVAL;
+    }
+
+    reader->header.version = (uint16_t)get_le(header + 8, 2);
+    reader->header.start_realtime_ns = (int64_t)get_le(header + 16, 8);
+    memcpy(reader->header.device, header + 24, JDTS_CAPTURE_DEVICE_SIZE);
+    reader->header.device[JDTS_CAPTURE_DEVICE_SIZE - 1] = '\0';
+
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        p = header + CAPTURE_CALIBRATION_OFFSET + ch * CAPTURE_CALIBRATION_SIZE;
+        reader->header.calibration[ch].type = (int)get_le(p, 4);
+        for (i = 0; i < JDTS_CAL_MAX_COEFFS; i++) {
+            reader->header.calibration[ch].coeffs[i] = get_double(p + 8 + i * 8);
+        }
+    }
+
+    return 0;
+}
+
+int jdts_capture_read(struct jdts_capture_reader_t *reader, struct jdts_capture_record_t *record)
+{
+    uint8_t raw[JDTS_CAPTURE_RECORD_SIZE];
+
+    if (fread(raw, sizeof(raw), 1, reader->file) != 1) {
+        // a truncated last record of an interrupted capture is just dropped
+        return ferror(reader->file) ? -EIO : 0;
+    }
+
+    record->timestamp_ns = (int64_t)get_le(raw, 8);
+    record->status = (int16_t)get_le(raw + 8, 2);
+    memcpy(record->frame, raw + 10, TECHART_MS_JDTS_FRAME_SIZE);
+    return 1;
+}
+
+int jdts_capture_rewind(struct jdts_capture_reader_t *reader)
+{
+    if (fseek(reader->file, JDTS_CAPTURE_HEADER_SIZE, SEEK_SET) != 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+void jdts_capture_reader_close(struct jdts_capture_reader_t *reader)
+{
+    if (reader->file != NULL) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
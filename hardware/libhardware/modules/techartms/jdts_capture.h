@@ -0,0 +1,83 @@
+#ifndef ANDROID_TECHART_MS_JDTS_CAPTURE_H
+#define ANDROID_TECHART_MS_JDTS_CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_calibration.h"
+
+__BEGIN_DECLS
+
+/*
+Capture file: a fixed header followed by fixed-size records, all little-endian.
+
+header, JDTS_CAPTURE_HEADER_SIZE bytes:
+[0..7]      magic "JDTSCAP1"
+[8,9]       (uint16_t) format version
+[10,11]     (uint16_t) header size
+[12,13]     (uint16_t) record size
+[14,15]     (uint16_t) frame size
+[16..23]    (int64_t) wall clock time of the start of the capture, ns since the epoch
+[24..63]    device description, zero padded
+[64..255]   calibration in effect while recording, 4 channels of 48 bytes:
+            (uint32_t) model type, 4 bytes reserved, 5 x (double) coefficients
+
+record, JDTS_CAPTURE_RECORD_SIZE bytes:
+[0..7]      (int64_t) monotonic time of the read, ns since the start of the capture
+[8,9]       (int16_t) 0 or -errno of a failed read
+[10..19]    raw frame as read from the driver, zeroes for a failed read
+*/
+
+#define JDTS_CAPTURE_MAGIC          "JDTSCAP1"
+#define JDTS_CAPTURE_VERSION        1
+#define JDTS_CAPTURE_HEADER_SIZE    256
+#define JDTS_CAPTURE_RECORD_SIZE    (10 + TECHART_MS_JDTS_FRAME_SIZE)
+#define JDTS_CAPTURE_DEVICE_SIZE    40
+
+struct jdts_capture_header_t {
+    uint16_t version;
+    int64_t start_realtime_ns;
+    char device[JDTS_CAPTURE_DEVICE_SIZE];
+    struct jdts_cal_model_t calibration[TECHART_MS_JDTS_CHANNEL_COUNT];
+};
+
+struct jdts_capture_record_t {
+    int64_t timestamp_ns;
+    int16_t status;
+    uint8_t frame[TECHART_MS_JDTS_FRAME_SIZE];
+};
+
+struct jdts_capture_writer_t {
+    FILE *file;
+    int64_t start_ns;
+};
+
+struct jdts_capture_reader_t {
+    FILE *file;
+    struct jdts_capture_header_t header;
+};
+
+// returns 0 or -errno
+int jdts_capture_writer_open(struct jdts_capture_writer_t *writer, const char *path,
+        const char *device, const struct jdts_calibration_t *cal);
+// 'timestamp_ns' is CLOCK_MONOTONIC, 'frame' is ignored for a failed read
+int jdts_capture_write(struct jdts_capture_writer_t *writer, int64_t timestamp_ns,
+        int status, const uint8_t *frame);
+int jdts_capture_writer_close(struct jdts_capture_writer_t *writer);
+
+// returns 0, -errno or -EINVAL if the file is not a capture
+int jdts_capture_reader_open(struct jdts_capture_reader_t *reader, const char *path);
+// returns 1 for a record, 0 at the end of the file or -errno
+int jdts_capture_read(struct jdts_capture_reader_t *reader, struct jdts_capture_record_t *record);
+int jdts_capture_rewind(struct jdts_capture_reader_t *reader);
+void jdts_capture_reader_close(struct jdts_capture_reader_t *reader);
+
+int64_t jdts_monotonic_ns(void);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_CAPTURE_H
@@ -0,0 +1,132 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cutils/log.h>
+
+#include "jdts_compensation.h"
+
+#define     LOG_TAG  "TECHARTMS_JDTS"
+
+static void build(struct jdts_compensation_t *comp)
+{
+    int ch;
+
+    // the offset is in C, the values in 0.01C
+    comp->offset_q = (int64_t)floor(comp->offset * 100.0 * (1 << JDTS_COMP_WEIGHT_BITS) + 0.5);
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        comp->weights_q[ch] = (int32_t)floor(comp->weights[ch] * (1 << JDTS_COMP_WEIGHT_BITS) + 0.5);
+    }
+}
+
+void jdts_compensation_reset(struct jdts_compensation_t *comp)
+{
+    memset(comp, 0, sizeof(*comp));
+    comp->weights[TECHART_MS_JDTS_CHANNEL_OBJ] = 1.0;
+    build(comp);
+}
+
+static int parse_line(struct jdts_compensation_t *comp, char *line, int *has_model)
+{
+    double coeffs[1 + TECHART_MS_JDTS_CHANNEL_COUNT];
+    char *save = NULL;
+    char *token;
+    char *end;
+    int count = 0;
+    int ch;
+
+    token = strtok_r(line, " \t\r\n", &save);
+    if (token == NULL || token[0] == '#') {
+        return 0;
+    }
+    if (strcmp(token, "linear") != 0) {
+        ALOGE("HAL - compensation: unknown model '%s'", token);
+        return -EINVAL;
+    }
+    if (*has_model) {
+        ALOGE("HAL - compensation: more than one model");
+        return -EINVAL;
+    }
+
+    while ((token = strtok_r(NULL, " \t\r\n", &save)) != NULL && token[0] != '#') {
+        if (count == 1 + TECHART_MS_JDTS_CHANNEL_COUNT) {
+            ALOGE("HAL - compensation: too many coefficients");
+            return -EINVAL;
+        }
+        coeffs[count] = strtod(token, &end);
+        if (*end != '\0' || !isfinite(coeffs[count]) ||
+                (count > 0 && fabs(coeffs[count]) >= JDTS_COMP_MAX_WEIGHT)) {
+            ALOGE("HAL - compensation: bad coefficient '%s'", token);
+            return -EINVAL;
+        }
+        count++;
+    }
+    if (count != 1 + TECHART_MS_JDTS_CHANNEL_COUNT) {
+        ALOGE("HAL - compensation: 'linear' takes an offset and %d weights", TECHART_MS_JDTS_CHANNEL_COUNT);
+        return -EINVAL;
+    }
+
+    comp->offset = coeffs[0];
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        comp->weights[ch] = coeffs[1 + ch];
+    }
+    *has_model = 1;
+    return 0;
+}
+
+int jdts_compensation_load(struct jdts_compensation_t *comp, const char *path)
+{
+    char line[256];
+    int has_model = 0;
+    int ret = 0;
+    FILE *file;
+
+    jdts_compensation_reset(comp);
+
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return -ENOENT;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        ret = parse_line(comp, line, &has_model);
+        if (ret < 0) {
+            break;
+        }
+    }
+    fclose(file);
+
+    if (ret < 0) {
+        jdts_compensation_reset(comp);
+        return ret;
+    }
+
+    build(comp);
+    return 0;
+}
+
+void jdts_compensate_samples(const struct jdts_compensation_t *comp, struct techartms_jdts_batch_t *batch,
+        size_t first, size_t count)
+{
+    const int16_t *obj = batch->value[TECHART_MS_JDTS_CHANNEL_OBJ];
+    const int16_t *ntc1 = batch->value[TECHART_MS_JDTS_CHANNEL_NTC1];
+    const int16_t *ntc2 = batch->value[TECHART_MS_JDTS_CHANNEL_NTC2];
+    const int16_t *ntc3 = batch->value[TECHART_MS_JDTS_CHANNEL_NTC3];
+    const int32_t *w = comp->weights_q;
+    int16_t *out = batch->compensated;
+    size_t i;
+
+    if (out == NULL) {
+        return;
+    }
+
+    // a straight loop of multiply-adds on contiguous arrays, left to the vectorizer
+    for (i = first; i < first + count; i++) {
+        int64_t v = comp->offset_q + (int64_t)w[0] * obj[i] + (int64_t)w[1] * ntc1[i] +
+                (int64_t)w[2] * ntc2[i] + (int64_t)w[3] * ntc3[i];
+
+        v = (v + (1 << (JDTS_COMP_WEIGHT_BITS - 1))) >> JDTS_COMP_WEIGHT_BITS;
+        out[i] = v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef ANDROID_TECHART_MS_JDTS_COMPENSATION_H
+#define ANDROID_TECHART_MS_JDTS_COMPENSATION_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+__BEGIN_DECLS
+
+#define JDTS_COMPENSATION_FILE "/data/calibration/jdts_compensation.conf"
+
+/*
+The object channel reads the target through the sensor's own body, whose temperature the
+NTCs measure. The compensated object temperature removes that contribution with a linear
+model over the calibrated channels. The file has one line, '#' starts a comment:
+
+linear <offset> <w_obj> <w_ntc1> <w_ntc2> <w_ntc3>
+    T = offset + w_obj*obj + w_ntc1*ntc1 + w_ntc2*ntc2 + w_ntc3*ntc3, temperatures in C
+
+A body correction proportional to the gap between the object and the mean NTC reading,
+T = obj + k*(obj - (ntc1 + ntc2 + ntc3)/3), is "linear 0 1+k -k/3 -k/3 -k/3".
+Without a file the compensated temperature is the object temperature.
+
+The weights are turned into fixed point at load, a sample costs four multiply-adds.
+*/
+
+#define JDTS_COMP_WEIGHT_BITS   14
+// |weight| must stay below this
+#define JDTS_COMP_MAX_WEIGHT    64.0
+
+struct jdts_compensation_t {
+    double offset;
+    double weights[TECHART_MS_JDTS_CHANNEL_COUNT];
+
+    // the same in fixed point, the offset in 0.01C << JDTS_COMP_WEIGHT_BITS
+    int64_t offset_q;
+    int32_t weights_q[TECHART_MS_JDTS_CHANNEL_COUNT];
+};
+
+// the identity: the object temperature
+void jdts_compensation_reset(struct jdts_compensation_t *comp);
+
+// returns 0, -ENOENT if there is no file or -EINVAL on a bad line, the model is
+// left to the identity on failure
+int jdts_compensation_load(struct jdts_compensation_t *comp, const char *path);
+
+// computes batch->compensated for samples [first, first + count) from batch->value
+void jdts_compensate_samples(const struct jdts_compensation_t *comp, struct techartms_jdts_batch_t *batch,
+        size_t first, size_t count);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_COMPENSATION_H
@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define JDTS_DECODE_NEON
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define JDTS_DECODE_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define JDTS_DECODE_SSE2
+#endif
+
+#include "jdts_decode.h"
+
+// frames are decoded by blocks of 8: one 128-bit vector of int16 per channel
+#define JDTS_DECODE_BLOCK   8
+#define JDTS_BATCH_ALIGN    32
+
+#define JDTS_CELSIUS_SCALE  0.01f
+
+static size_t align_up(size_t size)
+{
+    return (size + JDTS_BATCH_ALIGN - 1) & ~(size_t)(JDTS_BATCH_ALIGN - 1);
+}
+
+struct techartms_jdts_batch_t *jdts_batch_alloc(size_t capacity)
+{
+    struct techartms_jdts_batch_t *batch;
+    size_t header_size = align_up(sizeof(*batch));
+    size_t synchro_size = align_up(capacity * sizeof(uint16_t));
+    size_t sequence_size = align_up(capacity * sizeof(uint64_t));
+    size_t raw_size = align_up(capacity * sizeof(int16_t));
+    size_t celsius_size = align_up(capacity * sizeof(float));
+    uint8_t *p;
+    void *block;
+    int ch;
+
+    if (posix_memalign(&block, JDTS_BATCH_ALIGN, header_size + 2 * synchro_size + 2 * sequence_size +
+            TECHART_MS_JDTS_CHANNEL_COUNT * (3 * raw_size + celsius_size) + raw_size) != 0) {
+        return NULL;
+    }
+
+    batch = (struct techartms_jdts_batch_t *)block;
+    memset(batch, 0, sizeof(*batch));
+    batch->capacity = capacity;
+
+    p = (uint8_t *)block + header_size;
+    batch->synchro = (uint16_t *)p;
+    p += synchro_size;
+    batch->sequence = (uint64_t *)p;
+    p += sequence_size;
+    batch->timestamp_ns = (int64_t *)p;
+    p += sequence_size;
+    batch->flags = (uint16_t *)p;
+    p += synchro_size;
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        batch->raw[ch] = (int16_t *)p;
+        p += raw_size;
+    }
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        batch->value[ch] = (int16_t *)p;
+        p += raw_size;
+    }
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        batch->celsius[ch] = (float *)p;
+        p += celsius_size;
+    }
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        batch->filtered[ch] = (int16_t *)p;
+        p += raw_size;
+    }
+    batch->compensated = (int16_t *)p;
+
+    return batch;
+}
+
+void jdts_batch_free(struct techartms_jdts_batch_t *batch)
+{
+    free(batch);
+}
+
+void jdts_decoder_init(struct jdts_decoder_t *decoder, const struct jdts_calibration_t *cal)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->cal = cal;
+}
+
+static inline int16_t read_le16(const uint8_t *p)
+{
+    return (int16_t)(p[1] << 8 | p[0]);
+}
+
+static inline void decode_frame(const uint8_t *frame, struct techartms_jdts_batch_t *batch, size_t i)
+{
+    batch->synchro[i] = (uint16_t)read_le16(frame + 2);
+    batch->raw[TECHART_MS_JDTS_CHANNEL_OBJ][i] = read_le16(frame + 0);
+    batch->raw[TECHART_MS_JDTS_CHANNEL_NTC1][i] = read_le16(frame + 4);
+    batch->raw[TECHART_MS_JDTS_CHANNEL_NTC2][i] = read_le16(frame + 6);
+    batch->raw[TECHART_MS_JDTS_CHANNEL_NTC3][i] = read_le16(frame + 8);
+}
+
+// converts 8 values of 0.01C into Celsius
+static inline void block_to_celsius(const int16_t *in, float *out)
+{
+#if defined(JDTS_DECODE_NEON)
+    int16x8_t v = vld1q_s16(in);
+    float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+    float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+    vst1q_f32(out, vmulq_n_f32(lo, JDTS_CELSIUS_SCALE));
+    vst1q_f32(out + 4, vmulq_n_f32(hi, JDTS_CELSIUS_SCALE));
+#elif defined(JDTS_DECODE_AVX2)
+    __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)in));
+    _mm256_storeu_ps(out, _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(JDTS_CELSIUS_SCALE)));
+#elif defined(JDTS_DECODE_SSE2)
+    __m128i v = _mm_loadu_si128((const __m128i *)in);
+    // sign extension: duplicate every int16 into an int32 and shift the copy out
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    __m128 scale = _mm_set1_ps(JDTS_CELSIUS_SCALE);
+    _mm_storeu_ps(out, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(out + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+#else
+    int i;
+    for (i = 0; i < JDTS_DECODE_BLOCK; i++) {
+        out[i] = in[i] * JDTS_CELSIUS_SCALE;
+    }
+#endif
+}
+
+static inline void calibrate(const struct jdts_calibration_t *cal, struct techartms_jdts_batch_t *batch,
+        int ch, size_t i, size_t n)
+{
+    if (cal != NULL) {
+        jdts_calibration_apply(cal, ch, batch->raw[ch] + i, batch->value[ch] + i, n);
+    } else {
+        memcpy(batch->value[ch] + i, batch->raw[ch] + i, n * sizeof(int16_t));
+    }
+}
+
+// the same synchro read twice (the driver keeps returning the last sample until a new one
+// is measured) gives the same sequence, so consumers can drop repeated samples
+static void unwrap_sequence(struct jdts_decoder_t *decoder, const int64_t *timestamps,
+        struct techartms_jdts_batch_t *batch, size_t first, size_t count)
+{
+    size_t i;
+
+    for (i = first; i < first + count; i++) {
+        if (!decoder->started) {
+            decoder->sequence = batch->synchro[i];
+            decoder->started = 1;
+        } else {
+            decoder->sequence += (uint16_t)(batch->synchro[i] - decoder->last_synchro);
+        }
+        decoder->last_synchro = batch->synchro[i];
+        batch->sequence[i] = decoder->sequence;
+        batch->timestamp_ns[i] = timestamps != NULL ? timestamps[i - first] : 0;
+    }
+}
+
+size_t jdts_decode_frames(struct jdts_decoder_t *decoder, const uint8_t *frames,
+        const int64_t *timestamps, size_t count, struct techartms_jdts_batch_t *batch)
+{
+    const struct jdts_calibration_t *cal = decoder->cal;
+    size_t first = batch->count;
+    size_t i, j;
+    int ch;
+
+    if (count > batch->capacity - batch->count) {
+        count = batch->capacity - batch->count;
+    }
+
+    // the frames are 5 interleaved int16 words, which does not map onto any vector
+    // de-interleaving load, so splitting into channels is scalar; the freshly written
+    // block is still in L1 when it is calibrated and converted to Celsius with the vector unit
+    for (i = 0; i + JDTS_DECODE_BLOCK <= count; i += JDTS_DECODE_BLOCK) {
+        for (j = 0; j < JDTS_DECODE_BLOCK; j++) {
+            decode_frame(frames + (i + j) * TECHART_MS_JDTS_FRAME_SIZE, batch, first + i + j);
+        }
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            calibrate(cal, batch, ch, first + i, JDTS_DECODE_BLOCK);
+            block_to_celsius(batch->value[ch] + first + i, batch->celsius[ch] + first + i);
+        }
+    }
+
+    for (; i < count; i++) {
+        decode_frame(frames + i * TECHART_MS_JDTS_FRAME_SIZE, batch, first + i);
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            calibrate(cal, batch, ch, first + i, 1);
+            batch->celsius[ch][first + i] = batch->value[ch][first + i] * JDTS_CELSIUS_SCALE;
+        }
+    }
+
+    unwrap_sequence(decoder, timestamps, batch, first, count);
+
+    batch->count += count;
+    return count;
+}
+
+size_t jdts_decode_raw_frames(struct jdts_decoder_t *decoder, const uint8_t *frames,
+        const int64_t *timestamps, size_t count, struct techartms_jdts_batch_t *batch)
+{
+    size_t first = batch->count;
+    size_t i;
+
+    if (count > batch->capacity - batch->count) {
+        count = batch->capacity - batch->count;
+    }
+
+    for (i = 0; i < count; i++) {
+        decode_frame(frames + i * TECHART_MS_JDTS_FRAME_SIZE, batch, first + i);
+    }
+    unwrap_sequence(decoder, timestamps, batch, first, count);
+
+    batch->count += count;
+    return count;
+}
+
+void jdts_calibrate_samples(const struct jdts_calibration_t *cal, struct techartms_jdts_batch_t *batch,
+        size_t first, size_t count)
+{
+    size_t end = first + count;
+    size_t i;
+    int ch;
+
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        calibrate(cal, batch, ch, first, count);
+        for (i = first; i + JDTS_DECODE_BLOCK <= end; i += JDTS_DECODE_BLOCK) {
+            block_to_celsius(batch->value[ch] + i, batch->celsius[ch] + i);
+        }
+        for (; i < end; i++) {
+            batch->celsius[ch][i] = batch->value[ch][i] * JDTS_CELSIUS_SCALE;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef ANDROID_TECHART_MS_JDTS_DECODE_H
+#define ANDROID_TECHART_MS_JDTS_DECODE_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_calibration.h"
+
+__BEGIN_DECLS
+
+// per-stream decoding state
+struct jdts_decoder_t {
+    const struct jdts_calibration_t *cal;   // may be NULL
+    int started;
+    uint16_t last_synchro;
+    uint64_t sequence;
+};
+
+void jdts_decoder_init(struct jdts_decoder_t *decoder, const struct jdts_calibration_t *cal);
+
+// allocates a batch with all channel arrays in one block, aligned for SIMD loads/stores
+struct techartms_jdts_batch_t *jdts_batch_alloc(size_t capacity);
+void jdts_batch_free(struct techartms_jdts_batch_t *batch);
+
+// decodes 'count' packed frames (TECHART_MS_JDTS_FRAME_SIZE bytes each) and appends them
+// to the batch, calibrating and converting to Celsius in the same pass.
+// 'timestamps' holds the read time of every frame and may be NULL.
+// Returns the number of frames decoded, which is less than 'count' when the batch is full
+size_t jdts_decode_frames(struct jdts_decoder_t *decoder, const uint8_t *frames,
+        const int64_t *timestamps, size_t count, struct techartms_jdts_batch_t *batch);
+
+// the two halves of jdts_decode_frames() for a staged pipeline: splitting the frames
+// into raw values, sequences and timestamps, then calibrating samples
+// [first, first + count) of the batch into value and celsius, in place
+size_t jdts_decode_raw_frames(struct jdts_decoder_t *decoder, const uint8_t *frames,
+        const int64_t *timestamps, size_t count, struct techartms_jdts_batch_t *batch);
+void jdts_calibrate_samples(const struct jdts_calibration_t *cal, struct techartms_jdts_batch_t *batch,
+        size_t first, size_t count);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_DECODE_H
@@ -0,0 +1,148 @@
+#include <math.h>
+#include <string.h>
+
+#include "jdts_detect.h"
+
+// the sensor only moves by hundredths of a degree, below this the values are identical
+#define     DETECT_MIN_STDDEV       5.0f
+
+void jdts_detect_config_default(struct jdts_detect_config_t *config)
+{
+    config->ewma_alpha = 0.05f;
+    config->z_limit = 4.0f;
+    config->min_stddev = DETECT_MIN_STDDEV;
+    config->warmup = 32;
+    config->slope_alpha = 0.2f;
+    config->rise_limit = 100.0f;
+    config->stuck_ns = 5000000000LL;
+    config->stuck_count = 64;
+    config->ntc_spread = 500;
+}
+
+void jdts_detect_init(struct jdts_detect_t *detect, const struct jdts_detect_config_t *config)
+{
+    memset(detect, 0, sizeof(*detect));
+    if (config != NULL) {
+        detect->config = *config;
+    } else {
+        jdts_detect_config_default(&detect->config);
+    }
+}
+
+static uint16_t detect_one(struct jdts_detect_t *detect, const struct techartms_jdts_batch_t *batch, size_t i)
+{
+    const struct jdts_detect_config_t *config = &detect->config;
+    int64_t ts = batch->timestamp_ns[i];
+    uint16_t flags = 0;
+    int16_t ntc_min, ntc_max;
+    int unchanged = 1;
+    int ch;
+
+    if (!detect->started) {
+        detect->started = 1;
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            detect->channels[ch].mean = batch->value[ch][i];
+            detect->channels[ch].variance = 0;
+            detect->last_value[ch] = batch->value[ch][i];
+        }
+        detect->slope_ts = ts;
+        detect->slope_value = batch->value[TECHART_MS_JDTS_CHANNEL_OBJ][i];
+        detect->last_synchro = batch->synchro[i];
+        detect->synchro_since_ns = ts;
+        detect->count = 1;
+        return 0;
+    }
+
+    // z-score against the mean and variance before this sample, then the update
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        struct jdts_detect_channel_t *c = &detect->channels[ch];
+        float x = batch->value[ch][i];
+        float delta = x - c->mean;
+        float stddev = sqrtf(c->variance);
+
+        if (stddev < config->min_stddev) {
+            stddev = config->min_stddev;
+        }
+        if (detect->count >= config->warmup && fabsf(delta) > config->z_limit * stddev) {
+            flags |= TECHART_MS_JDTS_FLAG_OUTLIER;
+        }
+        c->mean += config->ewma_alpha * delta;
+        c->variance = (1.0f - config->ewma_alpha) * (c->variance + config->ewma_alpha * delta * delta);
+
+        if (batch->value[ch][i] != detect->last_value[ch]) {
+            unchanged = 0;
+        }
+        detect->last_value[ch] = batch->value[ch][i];
+    }
+    if (detect->count < config->warmup) {
+        detect->count++;
+    }
+
+    // frames of one read share its timestamp, the derivative moves between reads only
+    if (ts > detect->slope_ts) {
+        int16_t obj = batch->value[TECHART_MS_JDTS_CHANNEL_OBJ][i];
+        float slope = (obj - detect->slope_value) * 1e9f / (float)(ts - detect->slope_ts);
+
+        if (detect->has_slope) {
+            detect->slope += config->slope_alpha * (slope - detect->slope);
+        } else {
+            detect->slope = slope;
+            detect->has_slope = 1;
+        }
+        detect->slope_ts = ts;
+        detect->slope_value = obj;
+    }
+    if (detect->has_slope && detect->slope > config->rise_limit) {
+        flags |= TECHART_MS_JDTS_FLAG_RISE;
+    } else if (detect->has_slope && detect->slope < -config->rise_limit) {
+        flags |= TECHART_MS_JDTS_FLAG_FALL;
+    }
+
+    if (batch->synchro[i] != detect->last_synchro) {
+        detect->last_synchro = batch->synchro[i];
+        detect->synchro_since_ns = ts;
+    }
+    detect->unchanged = unchanged ? detect->unchanged + 1 : 0;
+    if (config->stuck_count > 0 && detect->unchanged >= config->stuck_count) {
+        flags |= TECHART_MS_JDTS_FLAG_STUCK;
+    }
+
+    ntc_min = ntc_max = batch->value[TECHART_MS_JDTS_CHANNEL_NTC1][i];
+    for (ch = TECHART_MS_JDTS_CHANNEL_NTC2; ch <= TECHART_MS_JDTS_CHANNEL_NTC3; ch++) {
+        if (batch->value[ch][i] < ntc_min) {
+            ntc_min = batch->value[ch][i];
+        }
+        if (batch->value[ch][i] > ntc_max) {
+            ntc_max = batch->value[ch][i];
+        }
+    }
+    if (ntc_max - ntc_min > config->ntc_spread) {
+        flags |= TECHART_MS_JDTS_FLAG_NTC_MISMATCH;
+    }
+
+    return flags;
+}
+
+uint16_t jdts_detect_samples(struct jdts_detect_t *detect, struct techartms_jdts_batch_t *batch,
+        size_t first, size_t count)
+{
+    size_t i;
+
+    for (i = first; i < first + count; i++) {
+        uint64_t sequence = batch->sequence[i];
+
+        if (!detect->started || sequence != detect->last_sequence) {
+            detect->last_flags = detect_one(detect, batch, i);
+            detect->last_sequence = sequence;
+        }
+        // a synchro that stopped moving only shows as the same sequence coming back
+        if (batch->timestamp_ns[i] - detect->synchro_since_ns >= detect->config.stuck_ns) {
+            detect->last_flags |= TECHART_MS_JDTS_FLAG_STUCK;
+        }
+        if (batch->flags != NULL) {
+            batch->flags[i] = detect->last_flags;
+        }
+    }
+
+    return detect->last_flags;
+}
@@ -0,0 +1,77 @@
+#ifndef ANDROID_TECHART_MS_JDTS_DETECT_H
+#define ANDROID_TECHART_MS_JDTS_DETECT_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+__BEGIN_DECLS
+
+/*
+Streaming anomaly detector, run on every decoded sample. It keeps a few numbers per
+channel and raises TECHART_MS_JDTS_FLAG_* on the sample that triggers them, so the
+cost per sample is constant and an alert comes with the sample that caused it:
+
+RISE/FALL       EWMA-smoothed derivative of the object channel past +/- rise_limit
+OUTLIER         a channel more than z_limit EWMA standard deviations from its EWMA mean
+STUCK           synchro has not moved for stuck_ns, or stuck_count new samples in a row
+                came with every channel unchanged
+NTC_MISMATCH    the NTCs are more than ntc_spread apart
+
+A sample repeated by the driver (same sequence) is not a new observation: it gets the
+flags of the previous one, plus STUCK once the repeats have lasted stuck_ns.
+*/
+
+struct jdts_detect_config_t {
+    float ewma_alpha;       // weight of a new sample in the mean and variance
+    float z_limit;
+    float min_stddev;       // 0.01C, floor under the EWMA deviation of a quiet channel
+    uint32_t warmup;        // samples before z-scores are trusted
+    float slope_alpha;      // weight of a new derivative in the smoothed one
+    float rise_limit;       // 0.01C per second
+    int64_t stuck_ns;
+    uint32_t stuck_count;
+    int32_t ntc_spread;     // 0.01C
+};
+
+struct jdts_detect_channel_t {
+    float mean;
+    float variance;
+};
+
+struct jdts_detect_t {
+    struct jdts_detect_config_t config;
+
+    int started;
+    uint64_t last_sequence;
+    uint16_t last_flags;
+    uint32_t count;
+    struct jdts_detect_channel_t channels[TECHART_MS_JDTS_CHANNEL_COUNT];
+
+    // the object value at the last distinct read time, frames of one read share it
+    int64_t slope_ts;
+    int16_t slope_value;
+    int has_slope;
+    float slope;            // 0.01C per second
+
+    uint16_t last_synchro;
+    int64_t synchro_since_ns;
+    int16_t last_value[TECHART_MS_JDTS_CHANNEL_COUNT];
+    uint32_t unchanged;
+};
+
+void jdts_detect_config_default(struct jdts_detect_config_t *config);
+
+// 'config' may be NULL for the defaults
+void jdts_detect_init(struct jdts_detect_t *detect, const struct jdts_detect_config_t *config);
+
+// evaluates samples [first, first + count) of 'batch' in order and stores their flags
+// in batch->flags when it is there. Returns the flags of the last one
+uint16_t jdts_detect_samples(struct jdts_detect_t *detect, struct techartms_jdts_batch_t *batch,
+        size_t first, size_t count);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_DETECT_H
@@ -0,0 +1,113 @@
+#include <errno.h>
+#include <string.h>
+
+#include "jdts_filter.h"
+
+#define     GAIN_ONE    (1 << JDTS_FILTER_GAIN_BITS)
+
+static int32_t to_gain(float k)
+{
+    int32_t gain = (int32_t)(k * GAIN_ONE + 0.5f);
+
+    // a zero gain would freeze the estimate
+    if (gain < 1) {
+        return 1;
+    }
+    return gain > GAIN_ONE ? GAIN_ONE : gain;
+}
+
+void jdts_filter_init(struct jdts_filter_t *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+int jdts_filter_configure(struct jdts_filter_t *filter, int channel, const struct techartms_jdts_filter_t *config)
+{
+    struct jdts_filter_channel_t *c;
+
+    if (channel < 0 || channel >= TECHART_MS_JDTS_CHANNEL_COUNT || config == NULL) {
+        return -EINVAL;
+    }
+    switch (config->type) {
+    case TECHART_MS_JDTS_FILTER_NONE:
+        break;
+    case TECHART_MS_JDTS_FILTER_EWMA:
+        if (!(config->alpha > 0.0f && config->alpha <= 1.0f)) {
+            return -EINVAL;
+        }
+        break;
+    case TECHART_MS_JDTS_FILTER_KALMAN:
+        if (!(config->process_noise > 0.0f && config->measurement_noise > 0.0f)) {
+            return -EINVAL;
+        }
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    c = &filter->channels[channel];
+    memset(c, 0, sizeof(*c));
+    c->config = *config;
+    if (config->type == TECHART_MS_JDTS_FILTER_EWMA) {
+        c->gain = to_gain(config->alpha);
+        c->settled = 1;
+    }
+    return 0;
+}
+
+static int16_t output(int32_t estimate)
+{
+    return (int16_t)((estimate + (1 << (JDTS_FILTER_FRAC_BITS - 1))) >> JDTS_FILTER_FRAC_BITS);
+}
+
+static void kalman_gain(struct jdts_filter_channel_t *c)
+{
+    float predicted = c->variance + c->config.process_noise;
+    float k = predicted / (predicted + c->config.measurement_noise);
+    int32_t gain = to_gain(k);
+
+    c->variance = (1.0f - k) * predicted;
+    if (gain == c->gain) {
+        c->settled = 1;
+    }
+    c->gain = gain;
+}
+
+void jdts_filter_samples(struct jdts_filter_t *filter, struct techartms_jdts_batch_t *batch,
+        size_t first, size_t count)
+{
+    int ch;
+    size_t i;
+
+    for (i = first; i < first + count; i++) {
+        int repeated = filter->has_last && batch->sequence[i] == filter->last_sequence;
+
+        filter->has_last = 1;
+        filter->last_sequence = batch->sequence[i];
+
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            struct jdts_filter_channel_t *c = &filter->channels[ch];
+            int32_t x = (int32_t)batch->value[ch][i] << JDTS_FILTER_FRAC_BITS;
+
+            if (c->config.type == TECHART_MS_JDTS_FILTER_NONE) {
+                c->estimate = x;
+            } else if (!c->started) {
+                // the first sample is the estimate, the Kalman variance starts at the noise
+                c->estimate = x;
+                c->variance = c->config.measurement_noise;
+                c->started = 1;
+            } else if (!repeated) {
+                if (!c->settled) {
+                    kalman_gain(c);
+                }
+                // rounded, a plain shift would let the estimate creep downward
+                c->estimate += (int32_t)(((int64_t)(x - c->estimate) * c->gain + GAIN_ONE / 2)
+                        >> JDTS_FILTER_GAIN_BITS);
+            }
+
+            if (batch->filtered[ch] != NULL) {
+                batch->filtered[ch][i] = output(c->estimate);
+            }
+        }
+    }
+}
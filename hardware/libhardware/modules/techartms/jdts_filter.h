@@ -0,0 +1,57 @@
+#ifndef ANDROID_TECHART_MS_JDTS_FILTER_H
+#define ANDROID_TECHART_MS_JDTS_FILTER_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+__BEGIN_DECLS
+
+/*
+The filter stage, one filter per channel, run once at the source so consumers do not
+each smooth the same data their own way. Both filters run in fixed point: the estimate
+is kept in 1/256 of the 0.01C unit and moved toward a new value by a Q15 gain.
+
+EWMA    the gain is alpha
+Kalman  1-D, constant temperature model: the gain comes from the error variance, which
+        grows by process_noise per sample and shrinks with each measurement. It settles
+        within a few dozen samples, from then on the filter is an EWMA at the settled gain
+        and the float update stops
+
+A sample repeated by the driver (same sequence) does not move the estimate.
+*/
+
+#define JDTS_FILTER_FRAC_BITS   8
+#define JDTS_FILTER_GAIN_BITS   15
+
+struct jdts_filter_channel_t {
+    struct techartms_jdts_filter_t config;
+    int started;
+    int32_t estimate;       // 0.01C << JDTS_FILTER_FRAC_BITS
+    int32_t gain;           // Q15
+    float variance;         // Kalman error variance, (0.01C)^2
+    int settled;
+};
+
+struct jdts_filter_t {
+    struct jdts_filter_channel_t channels[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int has_last;
+    uint64_t last_sequence;
+};
+
+// every channel unfiltered
+void jdts_filter_init(struct jdts_filter_t *filter);
+
+// returns 0 or -EINVAL
+int jdts_filter_configure(struct jdts_filter_t *filter, int channel, const struct techartms_jdts_filter_t *config);
+
+// filters samples [first, first + count) of 'batch' into batch->filtered, the channels
+// whose output array is NULL still follow the samples
+void jdts_filter_samples(struct jdts_filter_t *filter, struct techartms_jdts_batch_t *batch,
+        size_t first, size_t count);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_FILTER_H
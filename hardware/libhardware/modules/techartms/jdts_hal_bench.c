@@ -0,0 +1,369 @@
+/*
+ * Throughput and latency benchmark of the HAL user space path and of the reader of
+ * JdtsService, runs on the host against the simulated sensor or on the device against
+ * any backend:
+ *
+ * jdts_hal_bench [-b backend] [-n samples] [-c batch]
+ *
+ * -b  backend passed to the module's open(), "sim:rate=0" by default (unpaced)
+ * -n  number of samples for every test, 100000 by default
+ * -c  batch size of the read_samples() test, 64 by default
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/hardware.h>
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_decode.h"
+#include "jdts_reader.h"
+
+extern struct hw_module_t HAL_MODULE_INFO_SYM;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void print_latencies(const char *title, int64_t *latencies, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+    qsort(latencies, count, sizeof(*latencies), compare_int64);
+    printf("%-14s p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", title,
+            latencies[count / 2] / 1000.0,
+            latencies[count * 99 / 100] / 1000.0,
+            latencies[count - 1] / 1000.0);
+}
+
+// counts the samples the synchro counter says were skipped
+static size_t count_gaps(int *has_previous, uint16_t *previous, const uint16_t *synchro, size_t count)
+{
+    size_t gaps = 0;
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (*has_previous && synchro[i] != (uint16_t)(*previous + 1)) {
+            gaps += (uint16_t)(synchro[i] - *previous - 1);
+        }
+        *previous = synchro[i];
+        *has_previous = 1;
+    }
+    return gaps;
+}
+
+static void bench_single(struct techartms_jdts_device_t *dev, size_t samples)
+{
+    int64_t *latencies = malloc(samples * sizeof(int64_t));
+    unsigned short synchro;
+    short obj, ntc1, ntc2, ntc3;
+    size_t errors = 0;
+    size_t gaps = 0;
+    size_t repeats = 0;
+    size_t done = 0;
+    int has_previous = 0;
+    uint16_t previous = 0;
+    int64_t start, t;
+    size_t i;
+
+    start = now_ns();
+    for (i = 0; i < samples; i++) {
+        t = now_ns();
+        if (dev->read_sample(&synchro, &obj, &ntc1, &ntc2, &ntc3) < 0) {
+            errors++;
+            continue;
+        }
+        latencies[done++] = now_ns() - t;
+        // a single read returns the latest sample, read again until the next one comes
+        if (has_previous && synchro == previous) {
+            repeats++;
+            continue;
+        }
+        gaps += count_gaps(&has_previous, &previous, &synchro, 1);
+    }
+    t = now_ns() - start;
+
+    printf("read_sample:   %zu samples in %.3f s, %.0f samples/s, %zu repeated, %zu errors, %zu lost\n",
+            done, t / 1e9, done / (t / 1e9), repeats, errors, gaps);
+    print_latencies("  per call", latencies, done);
+    free(latencies);
+}
+
+static void bench_batch(struct techartms_jdts_device_t *dev, size_t samples, size_t batch_size)
+{
+    struct techartms_jdts_batch_t *batch = jdts_batch_alloc(batch_size);
+    int64_t *latencies = malloc(samples * sizeof(int64_t));
+    size_t short_reads = 0;
+    size_t errors = 0;
+    size_t gaps = 0;
+    size_t done = 0;
+    size_t calls = 0;
+    int has_previous = 0;
+    uint16_t previous = 0;
+    int64_t start, t;
+    int ret;
+
+    if (batch == NULL || latencies == NULL) {
+        fprintf(stderr, "cannot allocate a batch of %zu\n", batch_size);
+        exit(1);
+    }
+
+    start = now_ns();
+    // a paced backend returns as soon as its queue is drained, up to a call per sample,
+    // as many as 'latencies' holds
+    while (done < samples && calls < samples) {
+        batch->count = 0;
+        t = now_ns();
+        ret = dev->read_samples(batch, batch_size < samples - done ? batch_size : samples - done);
+        latencies[calls++] = now_ns() - t;
+        if (ret < 0) {
+            errors++;
+            continue;
+        }
+        if (ret < (int)batch_size) {
+            short_reads++;
+        }
+        done += ret;
+        gaps += count_gaps(&has_previous, &previous, batch->synchro, batch->count);
+    }
+    t = now_ns() - start;
+
+    printf("read_samples:  %zu samples in %zu calls, %.3f s, %.0f samples/s, %zu short reads, %zu errors, %zu lost\n",
+            done, calls, t / 1e9, done / (t / 1e9), short_reads, errors, gaps);
+    print_latencies("  per batch", latencies, calls);
+    free(latencies);
+    jdts_batch_free(batch);
+}
+
+// the reader runs for at most this long
+#define READER_TIMEOUT_NS   (10 * 1000000000LL)
+// and this long paced at READER_PACE_US
+#define READER_PACE_NS      (500 * 1000000LL)
+#define READER_PACE_US      10000
+
+struct reader_sink_t {
+    pthread_mutex_t lock;
+    size_t samples;
+    size_t batches;
+    size_t gaps;
+    int has_previous;
+    uint64_t previous;
+    struct techartms_jdts_record_t records[JDTS_READER_CHUNK];
+};
+
+static void reader_samples(void *cookie, size_t count)
+{
+    struct reader_sink_t *sink = (struct reader_sink_t *)cookie;
+    size_t i;
+
+    pthread_mutex_lock(&sink->lock);
+    for (i = 0; i < count; i++) {
+        if (sink->has_previous && sink->records[i].sequence != sink->previous + 1) {
+            sink->gaps += sink->records[i].sequence - sink->previous - 1;
+        }
+        sink->previous = sink->records[i].sequence;
+        sink->has_previous = 1;
+    }
+    sink->samples += count;
+    sink->batches++;
+    pthread_mutex_unlock(&sink->lock);
+}
+
+static size_t sink_samples(struct reader_sink_t *sink)
+{
+    size_t samples;
+
+    pthread_mutex_lock(&sink->lock);
+    samples = sink->samples;
+    pthread_mutex_unlock(&sink->lock);
+    return samples;
+}
+
+// reads what the stream has, returns the number of records
+static size_t drain_stream(int fd, int timeout_ms)
+{
+    struct techartms_jdts_record_t records[JDTS_READER_CHUNK];
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    size_t count = 0;
+    ssize_t ret;
+
+    while (poll(&pfd, 1, timeout_ms) > 0) {
+        ret = read(fd, records, sizeof(records));
+        if (ret <= 0) {
+            break;
+        }
+        count += ret / sizeof(records[0]);
+        timeout_ms = 0;
+    }
+    return count;
+}
+
+// the reader thread of JdtsService with a stream and the shared memory region attached,
+// the callback standing for onSamples(). Then the same paced in burst mode, and closed
+static void bench_reader(struct techartms_jdts_device_t *dev, size_t samples)
+{
+    static const struct jdts_reader_callbacks_t callbacks = { NULL, NULL, reader_samples };
+    struct reader_sink_t sink;
+    struct jdts_reader_stats_t before, after;
+    struct techartms_jdts_shm_t *shm = calloc(1, TECHART_MS_JDTS_SHM_SIZE);
+    int64_t stream_stats[3];
+    size_t streamed = 0;
+    size_t paced;
+    int64_t start, t;
+    int fds[2];
+
+    if (shm == NULL || pipe(fds) < 0) {
+        fprintf(stderr, "cannot set up the reader sinks\n");
+        exit(1);
+    }
+    shm->magic = TECHART_MS_JDTS_SHM_MAGIC;
+    shm->version = TECHART_MS_JDTS_SHM_VERSION;
+    shm->record_size = TECHART_MS_JDTS_RECORD_SIZE;
+    shm->ring_size = TECHART_MS_JDTS_SHM_RING_SIZE;
+
+    memset(&sink, 0, sizeof(sink));
+    pthread_mutex_init(&sink.lock, NULL);
+    jdts_reader_set_shared(shm);
+    jdts_reader_set_period(0);
+    if (jdts_reader_add_stream(fds[1], 0) < 0) {
+        fprintf(stderr, "cannot add the stream\n");
+        exit(1);
+    }
+
+    jdts_reader_get_stats(&before);
+    start = now_ns();
+    if (jdts_reader_start(dev, &callbacks, &sink, sink.records) != 0) {
+        fprintf(stderr, "cannot start the reader\n");
+        exit(1);
+    }
+    while (sink_samples(&sink) < samples && now_ns() - start < READER_TIMEOUT_NS) {
+        streamed += drain_stream(fds[0], 10);
+    }
+    jdts_reader_stop();
+    t = now_ns() - start;
+    streamed += drain_stream(fds[0], 100);
+    jdts_reader_get_stats(&after);
+    jdts_reader_get_stream_stats(stream_stats, 1);
+
+    printf("reader:        %zu samples in %zu batches, %.3f s, %.0f samples/s, %zu lost\n",
+            sink.samples, sink.batches, t / 1e9, sink.samples / (t / 1e9), sink.gaps);
+    printf("  stream       %zu records, %lld batches dropped\n", streamed, (long long)stream_stats[2]);
+    printf("  shared       %lld records published\n", (long long)shm->count);
+    printf("  reads        %llu, %llu errors, max %llu us\n",
+            (unsigned long long)(after.reads - before.reads),
+            (unsigned long long)(after.errors - before.errors), (unsigned long long)after.max_us);
+
+    // resumes the stopped thread, whose read was cancelled, then switches to burst mode
+    // under it the way JdtsService does: the FIFO read it is blocked in then gets nothing
+    // until the new period cancels it
+    if (jdts_reader_start(dev, &callbacks, &sink, sink.records) != -EALREADY) {
+        fprintf(stderr, "cannot resume the reader\n");
+        exit(1);
+    }
+    drain_stream(fds[0], 10);
+    if (dev->set_mode(0) != 0) {
+        fprintf(stderr, "cannot switch to burst mode\n");
+        exit(1);
+    }
+    drain_stream(fds[0], 10);
+    jdts_reader_get_stats(&before);
+    samples = sink_samples(&sink);
+    start = now_ns();
+    jdts_reader_set_period(READER_PACE_US);
+    while (now_ns() - start < READER_PACE_NS) {
+        drain_stream(fds[0], 10);
+    }
+    jdts_reader_stop();
+    t = now_ns() - start;
+    jdts_reader_get_stats(&after);
+    paced = (size_t)(after.reads - before.reads);
+    printf("reader paced:  %zu reads in %.3f s, %.1f ms apart for a period of %.1f ms, %zu samples\n",
+            paced, t / 1e9, paced > 0 ? t / 1e6 / paced : 0.0, READER_PACE_US / 1e3,
+            sink_samples(&sink) - samples);
+
+    start = now_ns();
+    jdts_reader_close();
+    printf("reader closed: %.3f ms\n", (now_ns() - start) / 1e6);
+    jdts_reader_set_period(0);
+    dev->set_mode(1);
+    jdts_reader_set_shared(NULL);
+    close(fds[0]);
+    free(shm);
+}
+
+// the time spent in each pipeline stage over both runs
+static void print_stages(struct techartms_jdts_device_t *dev)
+{
+    struct techartms_jdts_stage_stats_t stats[16];
+    int count = dev->get_stage_stats(stats, 16);
+    int i;
+
+    for (i = 0; i < count && i < 16; i++) {
+        printf("stage %-10s %10llu batches  %8.1f ns/sample  max %8.1f us/batch  %llu errors\n",
+                stats[i].name, (unsigned long long)stats[i].batches,
+                stats[i].samples > 0 ? (double)stats[i].total_ns / stats[i].samples : 0.0,
+                stats[i].max_ns / 1e3, (unsigned long long)stats[i].errors);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *backend = "sim:rate=0";
+    size_t samples = 100000;
+    size_t batch_size = 64;
+    struct techartms_jdts_device_t *dev = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:n:c:")) != -1) {
+        switch (opt) {
+        case 'b':
+            backend = optarg;
+            break;
+        case 'n':
+            samples = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            batch_size = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-b backend] [-n samples] [-c batch]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (samples == 0 || batch_size == 0) {
+        fprintf(stderr, "samples and batch size must be positive\n");
+        return 1;
+    }
+
+    if (HAL_MODULE_INFO_SYM.methods->open(&HAL_MODULE_INFO_SYM, backend, (struct hw_device_t **)&dev) != 0) {
+        fprintf(stderr, "cannot open the HAL with backend '%s'\n", backend);
+        return 1;
+    }
+
+    printf("backend '%s'\n", backend);
+    bench_single(dev, samples);
+    bench_batch(dev, samples, batch_size);
+    bench_reader(dev, samples);
+    print_stages(dev);
+
+    dev->common.close(&dev->common);
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jdts_capture.h"
+#include "jdts_pipeline.h"
+
+// every allocation of the arena starts on a cache line
+#define     ARENA_ALIGN     64
+
+static void set_name(struct techartms_jdts_stage_stats_t *stats, const char *name)
+{
+    strncpy(stats->name, name, sizeof(stats->name) - 1);
+    stats->name[sizeof(stats->name) - 1] = '\0';
+}
+
+static void account(struct techartms_jdts_stage_stats_t *stats, size_t count, int64_t elapsed_ns)
+{
+    stats->batches++;
+    stats->samples += count;
+    stats->total_ns += (uint64_t)elapsed_ns;
+    if ((uint64_t)elapsed_ns > stats->max_ns) {
+        stats->max_ns = (uint64_t)elapsed_ns;
+    }
+}
+
+int jdts_pipeline_init(struct jdts_pipeline_t *pipeline)
+{
+    void *arena;
+
+    memset(pipeline, 0, sizeof(*pipeline));
+    if (posix_memalign(&arena, ARENA_ALIGN, JDTS_PIPELINE_ARENA_SIZE) != 0) {
+        return -ENOMEM;
+    }
+    memset(arena, 0, JDTS_PIPELINE_ARENA_SIZE);
+    pipeline->arena = arena;
+    // calibration is a stage of its own
+    jdts_decoder_init(&pipeline->decoder, NULL);
+    set_name(&pipeline->stats[0], "decode");
+    return 0;
+}
+
+void jdts_pipeline_release(struct jdts_pipeline_t *pipeline)
+{
+    free(pipeline->arena);
+    memset(pipeline, 0, sizeof(*pipeline));
+}
+
+void *jdts_pipeline_alloc(struct jdts_pipeline_t *pipeline, size_t size)
+{
+    size_t offset = pipeline->arena_used;
+
+    if (pipeline->arena == NULL || size > JDTS_PIPELINE_ARENA_SIZE - offset) {
+        return NULL;
+    }
+    pipeline->arena_used = (offset + size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (pipeline->arena_used > JDTS_PIPELINE_ARENA_SIZE) {
+        pipeline->arena_used = JDTS_PIPELINE_ARENA_SIZE;
+    }
+    return pipeline->arena + offset;
+}
+
+int jdts_pipeline_add(struct jdts_pipeline_t *pipeline, const char *name, jdts_stage_fn_t process, void *state)
+{
+    struct jdts_stage_t *stage;
+
+    if (pipeline->stage_count == JDTS_PIPELINE_MAX_STAGES) {
+        return -ENOSPC;
+    }
+    stage = &pipeline->stages[pipeline->stage_count];
+    stage->process = process;
+    stage->state = state;
+    memset(&pipeline->stats[pipeline->stage_count + 1], 0, sizeof(pipeline->stats[0]));
+    set_name(&pipeline->stats[pipeline->stage_count + 1], name);
+    pipeline->stage_count++;
+    return 0;
+}
+
+size_t jdts_pipeline_run(struct jdts_pipeline_t *pipeline, const uint8_t *frames,
+        const int64_t *timestamps, size_t count, struct techartms_jdts_batch_t *batch)
+{
+    size_t first = batch->count;
+    int64_t start = jdts_monotonic_ns();
+    int64_t end;
+    size_t decoded;
+    int i;
+
+    decoded = jdts_decode_raw_frames(&pipeline->decoder, frames, timestamps, count, batch);
+    end = jdts_monotonic_ns();
+    account(&pipeline->stats[0], decoded, end - start);
+    if (decoded == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < pipeline->stage_count; i++) {
+        struct jdts_stage_t *stage = &pipeline->stages[i];
+
+        start = end;
+        if (stage->process(stage->state, batch, first, decoded) < 0) {
+            pipeline->stats[i + 1].errors++;
+        }
+        end = jdts_monotonic_ns();
+        account(&pipeline->stats[i + 1], decoded, end - start);
+    }
+
+    return decoded;
+}
+
+int jdts_pipeline_get_stats(const struct jdts_pipeline_t *pipeline,
+        struct techartms_jdts_stage_stats_t *out, size_t max_count)
+{
+    size_t count = (size_t)pipeline->stage_count + 1;
+
+    memcpy(out, pipeline->stats, (count < max_count ? count : max_count) * sizeof(*out));
+    return (int)count;
+}
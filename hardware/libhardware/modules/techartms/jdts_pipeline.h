@@ -0,0 +1,70 @@
+#ifndef ANDROID_TECHART_MS_JDTS_PIPELINE_H
+#define ANDROID_TECHART_MS_JDTS_PIPELINE_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_decode.h"
+
+__BEGIN_DECLS
+
+/*
+The processing of decoded samples as a list of stages run in registration order. The
+source splits the frames into the caller's batch, every stage then works in place on
+the new samples [first, first + count) of that same batch: adding a stage adds a call,
+never a copy of the data. The stages' state is allocated at setup from one arena owned
+by the pipeline, so running a batch allocates nothing.
+
+Each stage is timed, one clock read per stage per batch: the end of a stage is the
+start of the next one.
+*/
+
+#define JDTS_PIPELINE_MAX_STAGES    8
+#define JDTS_PIPELINE_ARENA_SIZE    4096
+
+// works on samples [first, first + count) of 'batch', returns 0 or -errno. A failing
+// stage is counted, the following ones still run
+typedef int (*jdts_stage_fn_t)(void *state, struct techartms_jdts_batch_t *batch, size_t first, size_t count);
+
+struct jdts_stage_t {
+    jdts_stage_fn_t process;
+    void *state;
+};
+
+struct jdts_pipeline_t {
+    struct jdts_decoder_t decoder;
+
+    // stats[0] is the source, stats[i + 1] is stages[i]
+    struct jdts_stage_t stages[JDTS_PIPELINE_MAX_STAGES];
+    struct techartms_jdts_stage_stats_t stats[JDTS_PIPELINE_MAX_STAGES + 1];
+    int stage_count;
+
+    uint8_t *arena;
+    size_t arena_used;
+};
+
+// returns 0 or -ENOMEM
+int jdts_pipeline_init(struct jdts_pipeline_t *pipeline);
+void jdts_pipeline_release(struct jdts_pipeline_t *pipeline);
+
+// 'size' bytes of the arena, aligned for any type, or NULL once it is exhausted
+void *jdts_pipeline_alloc(struct jdts_pipeline_t *pipeline, size_t size);
+
+// appends a stage, returns 0 or -ENOSPC
+int jdts_pipeline_add(struct jdts_pipeline_t *pipeline, const char *name, jdts_stage_fn_t process, void *state);
+
+// decodes 'count' frames into 'batch' and runs every stage over them,
+// returns the number of samples appended as jdts_decode_raw_frames()
+size_t jdts_pipeline_run(struct jdts_pipeline_t *pipeline, const uint8_t *frames,
+        const int64_t *timestamps, size_t count, struct techartms_jdts_batch_t *batch);
+
+// copies the counters of the source and the stages, returns how many there are
+int jdts_pipeline_get_stats(const struct jdts_pipeline_t *pipeline,
+        struct techartms_jdts_stage_stats_t *out, size_t max_count);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_PIPELINE_H
@@ -0,0 +1,505 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cutils/log.h>
+
+#include "jdts_decode.h"
+#include "jdts_reader.h"
+
+#define     LOG_TAG  "TECHARTMS_JDTS"
+
+// when a read brings no new sample (a single frame read in continuous mode returns the
+// frame the sensor delivered last, the same one until it measures again, and a cancelled
+// read none) the reader backs off for this long
+#define     READER_IDLE_US          20000
+// and for this long after a failed read
+#define     READER_ERROR_US         100000
+// a paced reader sleeps by slices of this, to notice a new period or a stop quickly
+#define     READER_PACE_SLICE_US    50000
+// reads at most of what the driver queued while the reader was paused, see
+// jdts_reader_set_drop_stale()
+#define     READER_DRAIN_MAX_READS  16
+
+// the thread outlives jdts_reader_stop(), which only pauses it: a stop does not wait
+// for the read in progress, and a start right after it cannot race a second thread
+// against the first. jdts_reader_close() ends and joins it
+struct reader_t {
+    struct techartms_jdts_device_t *dev;
+    struct jdts_reader_callbacks_t callbacks;
+    void *cookie;
+    struct techartms_jdts_record_t *records;
+    struct techartms_jdts_batch_t *batch;
+    pthread_t thread;
+    // all under reader_lock, the thread reads the flags without it between reads
+    volatile int running;
+    int closing;
+    // set when a new period cancelled the read, which the thread then resumes
+    volatile int repaced;
+};
+
+// a pipe of jdts_reader_add_stream(), fed with the records due at its period
+struct stream_t {
+    int fd;
+    struct jdts_decimator_t decimator;
+    // batches lost to a full pipe, the client sees them as sequence gaps
+    uint64_t dropped;
+    uint64_t written;
+    struct stream_t *next;
+};
+
+// counters of jdts_reader_read(), updated with relaxed atomics by whichever thread reads
+static struct jdts_reader_stats_t read_stats;
+
+static pthread_mutex_t reader_lock = PTHREAD_MUTEX_INITIALIZER;
+// signalled when the reader is resumed or closed
+static pthread_cond_t reader_cond = PTHREAD_COND_INITIALIZER;
+static struct reader_t *current_reader = NULL;
+
+static int32_t reader_period_us = 0;
+static int drop_stale = 0;
+
+// only the reader thread writes the region
+static struct techartms_jdts_shm_t *shared = NULL;
+
+static pthread_mutex_t stream_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct stream_t *streams = NULL;
+static int stream_count = 0;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int latency_bucket(uint64_t us)
+{
+    int msb;
+    int index;
+
+    if (us < 4) {
+        return (int)us;
+    }
+    msb = 63 - __builtin_clzll(us);
+    index = (msb - 1) * 4 + (int)((us >> (msb - 2)) & 3);
+    return index < JDTS_READER_LATENCY_BUCKETS ? index : JDTS_READER_LATENCY_BUCKETS - 1;
+}
+
+static void record_read(int64_t started_ns, int ret)
+{
+    uint64_t us = (uint64_t)(now_ns() - started_ns) / 1000;
+    uint64_t max = __atomic_load_n(&read_stats.max_us, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&read_stats.reads, 1, __ATOMIC_RELAXED);
+    if (ret >= 0) {
+        __atomic_fetch_add(&read_stats.samples, (uint64_t)ret, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&read_stats.errors, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&read_stats.latency[latency_bucket(us)], 1, __ATOMIC_RELAXED);
+    while (us > max && !__atomic_compare_exchange_n(&read_stats.max_us, &max, us,
+            1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+int jdts_reader_read(struct techartms_jdts_device_t *dev, struct techartms_jdts_batch_t *batch,
+        size_t max_count)
+{
+    int64_t started_ns = now_ns();
+    int ret;
+
+    batch->count = 0;
+    ret = dev->read_samples(batch, max_count < JDTS_READER_CHUNK ? max_count : JDTS_READER_CHUNK);
+    record_read(started_ns, ret);
+    return ret >= 0 ? ret : -1;
+}
+
+void jdts_reader_get_stats(struct jdts_reader_stats_t *stats)
+{
+    int i;
+
+    stats->reads = __atomic_load_n(&read_stats.reads, __ATOMIC_RELAXED);
+    stats->errors = __atomic_load_n(&read_stats.errors, __ATOMIC_RELAXED);
+    stats->samples = __atomic_load_n(&read_stats.samples, __ATOMIC_RELAXED);
+    stats->max_us = __atomic_load_n(&read_stats.max_us, __ATOMIC_RELAXED);
+    for (i = 0; i < JDTS_READER_LATENCY_BUCKETS; i++) {
+        stats->latency[i] = __atomic_load_n(&read_stats.latency[i], __ATOMIC_RELAXED);
+    }
+}
+
+void jdts_decimator_reset(struct jdts_decimator_t *decimator, int64_t period_ns)
+{
+    decimator->period_ns = period_ns > 0 ? period_ns : 0;
+    decimator->next_due_ns = 0;
+    decimator->started = 0;
+}
+
+int jdts_decimator_take(struct jdts_decimator_t *decimator, int64_t timestamp_ns)
+{
+    if (decimator->period_ns == 0) {
+        return 1;
+    }
+    if (!decimator->started) {
+        decimator->started = 1;
+        decimator->next_due_ns = timestamp_ns + decimator->period_ns;
+        return 1;
+    }
+    if (timestamp_ns < decimator->next_due_ns - decimator->period_ns / 4) {
+        return 0;
+    }
+    decimator->next_due_ns += decimator->period_ns;
+    if (decimator->next_due_ns < timestamp_ns) {
+        decimator->next_due_ns = timestamp_ns;
+    }
+    return 1;
+}
+
+// writes the new records to every stream without ever blocking the reader: a batch
+// is at most JDTS_READER_CHUNK records, below PIPE_BUF, so it goes into the pipe whole
+// or not at all. Streams whose reader has gone are closed and dropped
+static void write_streams(const struct techartms_jdts_record_t *records, int count)
+{
+    struct techartms_jdts_record_t taken[JDTS_READER_CHUNK];
+    struct stream_t **link;
+    struct stream_t *stream;
+    ssize_t ret;
+    int n;
+    int i;
+
+    pthread_mutex_lock(&stream_lock);
+    link = &streams;
+    while (*link != NULL) {
+        stream = *link;
+        n = 0;
+
+        for (i = 0; i < count; i++) {
+            if (jdts_decimator_take(&stream->decimator, records[i].timestamp_ns)) {
+                taken[n++] = records[i];
+            }
+        }
+
+        ret = n > 0 ? write(stream->fd, taken, n * sizeof(taken[0])) : 0;
+        if (ret > 0) {
+            stream->written += n;
+        } else if (ret < 0 && errno == EAGAIN) {
+            stream->dropped++;
+        } else if (ret < 0 && errno != EINTR) {
+            ALOGD("write_streams: stream closed, %llu batches dropped",
+                    (unsigned long long)stream->dropped);
+            close(stream->fd);
+            *link = stream->next;
+            free(stream);
+            stream_count--;
+            continue;
+        }
+        link = &stream->next;
+    }
+    pthread_mutex_unlock(&stream_lock);
+}
+
+// waits until the period set by jdts_reader_set_period() has passed since 'last_ns'
+static void pace_reader(struct reader_t *reader, int64_t last_ns)
+{
+    int64_t period_ns;
+    int64_t remaining_ns;
+
+    while (reader->running) {
+        period_ns = (int64_t)__atomic_load_n(&reader_period_us, __ATOMIC_RELAXED) * 1000;
+        remaining_ns = last_ns + period_ns - now_ns();
+        if (remaining_ns <= 0) {
+            return;
+        }
+        usleep(remaining_ns / 1000 < READER_PACE_SLICE_US ?
+                (useconds_t)(remaining_ns / 1000) : READER_PACE_SLICE_US);
+    }
+}
+
+// parks a stopped reader until it is resumed or closed, returns 0 once it is to exit.
+// '*resumed' is set if it was stopped
+static int wait_running(struct reader_t *reader, int *resumed)
+{
+    int parked = 0;
+
+    pthread_mutex_lock(&reader_lock);
+    while (!reader->running && !reader->closing) {
+        if (!parked) {
+            // the reads of the other callers wait for the sensor again
+            reader->dev->cancel_reads(0);
+            parked = 1;
+            ALOGD("reader_thread: paused");
+        }
+        pthread_cond_wait(&reader_cond, &reader_lock);
+    }
+    pthread_mutex_unlock(&reader_lock);
+
+    *resumed |= parked;
+    return !reader->closing;
+}
+
+static void *reader_thread(void *arg)
+{
+    struct reader_t *reader = (struct reader_t *)arg;
+    struct techartms_jdts_batch_t *batch = reader->batch;
+    struct techartms_jdts_record_t *records = reader->records;
+    uint64_t last_sequence = 0;
+    int has_last = 0;
+    int64_t last_read_ns = 0;
+    sigset_t sigpipe;
+    int resumed = 0;
+    // the driver queues from the open of the device, and keeps queueing while the reader
+    // is paused or paced
+    int stale = 1;
+    int reads;
+    int paced;
+    int count;
+    int ret;
+    int i;
+
+    // a stream whose client has gone fails with EPIPE instead of killing the process
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, NULL);
+
+    if (reader->callbacks.thread_start != NULL) {
+        reader->callbacks.thread_start(reader->cookie);
+    }
+
+    while (wait_running(reader, &resumed)) {
+        pace_reader(reader, last_read_ns);
+        if (!reader->running) {
+            continue;
+        }
+        paced = __atomic_load_n(&reader_period_us, __ATOMIC_RELAXED) > 0;
+
+        // a drain read returns once the FIFO is empty, at worst with one fresh sample
+        stale |= resumed || paced;
+        resumed = 0;
+        if (stale && !paced) {
+            reads = 0;
+            while (__atomic_load_n(&drop_stale, __ATOMIC_RELAXED) && reader->running &&
+                    ++reads <= READER_DRAIN_MAX_READS &&
+                    jdts_reader_read(reader->dev, batch, JDTS_READER_CHUNK) == JDTS_READER_CHUNK) {
+            }
+            stale = 0;
+        }
+        last_read_ns = now_ns();
+
+        // paced, as for burst mode, a read is of one frame: the driver then powers the
+        // sensor up for a measurement, which a FIFO read never does. Otherwise it blocks
+        // in the driver FIFO until samples arrive and returns with all of them, or with
+        // none once jdts_reader_stop() or a new period cancels the wait
+        ret = jdts_reader_read(reader->dev, batch, paced ? 1 : JDTS_READER_CHUNK);
+        if (reader->repaced) {
+            pthread_mutex_lock(&reader_lock);
+            reader->repaced = 0;
+            if (reader->running) {
+                reader->dev->cancel_reads(0);
+            }
+            pthread_mutex_unlock(&reader_lock);
+        }
+        if (ret < 0) {
+            ALOGE("reader_thread: cannot read the samples");
+            usleep(READER_ERROR_US);
+            continue;
+        }
+
+        count = 0;
+        for (i = 0; i < ret; i++) {
+            if (has_last && batch->sequence[i] <= last_sequence) {
+                continue;
+            }
+            techartms_jdts_pack_record(&records[count++], batch, i);
+            last_sequence = batch->sequence[i];
+            has_last = 1;
+        }
+
+        if (count == 0) {
+            if (reader->running) {
+                usleep(READER_IDLE_US);
+            }
+            continue;
+        }
+
+        // passed on even when the reader was stopped during the read: the samples are
+        // out of the driver FIFO and nobody else would see them
+        if (shared != NULL) {
+            techartms_jdts_shm_publish(shared, records, count);
+        }
+        write_streams(records, count);
+        reader->callbacks.samples(reader->cookie, count);
+    }
+
+    if (reader->callbacks.thread_stop != NULL) {
+        reader->callbacks.thread_stop(reader->cookie);
+    }
+    ALOGD("reader_thread: closed");
+    return NULL;
+}
+
+int jdts_reader_start(struct techartms_jdts_device_t *dev, const struct jdts_reader_callbacks_t *callbacks,
+        void *cookie, struct techartms_jdts_record_t *records)
+{
+    struct reader_t *reader;
+    int ret = -EALREADY;
+
+    pthread_mutex_lock(&reader_lock);
+    if (current_reader != NULL) {
+        if (!current_reader->running) {
+            current_reader->running = 1;
+            dev->cancel_reads(0);
+            pthread_cond_broadcast(&reader_cond);
+            ALOGD("jdts_reader_start: reader resumed");
+        }
+        pthread_mutex_unlock(&reader_lock);
+        return ret;
+    }
+
+    reader = calloc(1, sizeof(*reader));
+    if (reader != NULL) {
+        reader->batch = jdts_batch_alloc(JDTS_READER_CHUNK);
+    }
+    if (reader == NULL || reader->batch == NULL) {
+        pthread_mutex_unlock(&reader_lock);
+        free(reader);
+        return -ENOMEM;
+    }
+    reader->dev = dev;
+    reader->callbacks = *callbacks;
+    reader->cookie = cookie;
+    reader->records = records;
+    reader->running = 1;
+
+    // a previous reader may have been closed with the reads still cancelled
+    dev->cancel_reads(0);
+    ret = -pthread_create(&reader->thread, NULL, reader_thread, reader);
+    if (ret == 0) {
+        current_reader = reader;
+        ALOGD("jdts_reader_start: reader started");
+    } else {
+        ALOGE("jdts_reader_start: cannot start the reader thread");
+        jdts_batch_free(reader->batch);
+        free(reader);
+    }
+    pthread_mutex_unlock(&reader_lock);
+
+    return ret;
+}
+
+void jdts_reader_stop(void)
+{
+    pthread_mutex_lock(&reader_lock);
+    if (current_reader != NULL && current_reader->running) {
+        current_reader->running = 0;
+        // the thread clears it again once it is parked
+        current_reader->dev->cancel_reads(1);
+    }
+    pthread_mutex_unlock(&reader_lock);
+}
+
+void jdts_reader_close(void)
+{
+    struct reader_t *reader;
+
+    pthread_mutex_lock(&reader_lock);
+    reader = current_reader;
+    current_reader = NULL;
+    if (reader != NULL) {
+        reader->running = 0;
+        reader->closing = 1;
+        reader->dev->cancel_reads(1);
+        pthread_cond_broadcast(&reader_cond);
+    }
+    pthread_mutex_unlock(&reader_lock);
+
+    if (reader == NULL) {
+        return;
+    }
+    pthread_join(reader->thread, NULL);
+    reader->dev->cancel_reads(0);
+    jdts_batch_free(reader->batch);
+    free(reader);
+}
+
+void jdts_reader_set_period(int32_t period_us)
+{
+    int32_t previous;
+
+    pthread_mutex_lock(&reader_lock);
+    previous = __atomic_exchange_n(&reader_period_us, period_us > 0 ? period_us : 0, __ATOMIC_RELAXED);
+    // the FIFO read the reader may be blocked in gets no samples in burst mode
+    if (previous == 0 && period_us > 0 && current_reader != NULL && current_reader->running) {
+        current_reader->repaced = 1;
+        current_reader->dev->cancel_reads(1);
+    }
+    pthread_mutex_unlock(&reader_lock);
+}
+
+void jdts_reader_set_drop_stale(int drop)
+{
+    __atomic_store_n(&drop_stale, drop, __ATOMIC_RELAXED);
+}
+
+void jdts_reader_set_shared(struct techartms_jdts_shm_t *shm)
+{
+    shared = shm;
+}
+
+int jdts_reader_add_stream(int fd, int64_t period_ns)
+{
+    struct stream_t *stream;
+    int flags = fcntl(fd, F_GETFL);
+    int err;
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        err = errno;
+        ALOGE("jdts_reader_add_stream: cannot make the stream non-blocking");
+        close(fd);
+        return -err;
+    }
+
+    stream = calloc(1, sizeof(*stream));
+    if (stream == NULL) {
+        close(fd);
+        return -ENOMEM;
+    }
+    stream->fd = fd;
+    jdts_decimator_reset(&stream->decimator, period_ns);
+
+    pthread_mutex_lock(&stream_lock);
+    stream->next = streams;
+    streams = stream;
+    stream_count++;
+    pthread_mutex_unlock(&stream_lock);
+    return 0;
+}
+
+int jdts_reader_get_stream_count(void)
+{
+    int count;
+
+    pthread_mutex_lock(&stream_lock);
+    count = stream_count;
+    pthread_mutex_unlock(&stream_lock);
+    return count;
+}
+
+int jdts_reader_get_stream_stats(int64_t *out, size_t max_count)
+{
+    struct stream_t *stream;
+    size_t count = 0;
+
+    pthread_mutex_lock(&stream_lock);
+    for (stream = streams; stream != NULL && count < max_count; stream = stream->next) {
+        out[count * 3] = stream->decimator.period_ns;
+        out[count * 3 + 1] = (int64_t)stream->written;
+        out[count * 3 + 2] = (int64_t)stream->dropped;
+        count++;
+    }
+    pthread_mutex_unlock(&stream_lock);
+    return (int)count;
+}
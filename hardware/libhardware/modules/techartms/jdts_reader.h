@@ -0,0 +1,97 @@
+#ifndef ANDROID_TECHART_MS_JDTS_READER_H
+#define ANDROID_TECHART_MS_JDTS_READER_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+__BEGIN_DECLS
+
+/*
+The reader of JdtsService without the JNI around it, so that it builds and runs on the host
+against the simulated sensor (see jdts_hal_bench). A thread reads the HAL, drops the samples
+it has passed on already and hands every batch of new ones, packed, to the shared memory
+region, to the streams and last to a callback. Like the HAL, the state is per process.
+*/
+
+// samples are read by chunks of this size, a batch passed on is never larger
+#define JDTS_READER_CHUNK           64
+
+// latency buckets of jdts_reader_read(): exact below 4 us, then four per power of two,
+// the same as LatencyHistogram.java
+#define JDTS_READER_LATENCY_BUCKETS 100
+
+struct jdts_reader_callbacks_t {
+    // optional, called on the reader thread before its first read and after its last one
+    void (*thread_start)(void *cookie);
+    void (*thread_stop)(void *cookie);
+    // 'count' new samples are at the start of the records of jdts_reader_start()
+    void (*samples)(void *cookie, size_t count);
+};
+
+struct jdts_reader_stats_t {
+    uint64_t reads;
+    uint64_t errors;
+    uint64_t samples;
+    uint64_t max_us;
+    uint64_t latency[JDTS_READER_LATENCY_BUCKETS];
+};
+
+// a read_samples() of up to 'max_count' samples, at most JDTS_READER_CHUNK, counted in the
+// read statistics whichever thread calls it. Returns the number of samples, 0 when the wait
+// was cancelled by jdts_reader_stop(), or -1
+int jdts_reader_read(struct techartms_jdts_device_t *dev, struct techartms_jdts_batch_t *batch,
+        size_t max_count);
+void jdts_reader_get_stats(struct jdts_reader_stats_t *stats);
+
+// starts the reader thread, or resumes it after jdts_reader_stop(). 'records' holds
+// JDTS_READER_CHUNK records and belongs to the thread until jdts_reader_close(). Returns 0,
+// -EALREADY if the thread exists already, which keeps its callbacks and records, or -errno
+int jdts_reader_start(struct techartms_jdts_device_t *dev, const struct jdts_reader_callbacks_t *callbacks,
+        void *cookie, struct techartms_jdts_record_t *records);
+// pauses the thread without waiting for it: the read it is blocked in is cancelled, the
+// samples it has read already are still passed on. Safe to call from the callbacks
+void jdts_reader_stop(void);
+// ends the thread and waits for it, after which the device can be closed. Not to be called
+// from the callbacks
+void jdts_reader_close(void);
+
+// when set, a reader going back to draining the FIFO, once started, resumed or no longer
+// paced, first reads and drops what the driver queued meanwhile, so that the samples passed on start from now rather than
+// with a burst of old ones followed by a gap. The HAL stages still see the dropped ones
+void jdts_reader_set_drop_stale(int drop);
+
+// the reader starts a read no sooner than this after the previous one, 0 for back to back.
+// A paced reader reads one sample at a time, which in burst mode is a measurement: the
+// driver FIFO it drains otherwise is only filled in continuous mode
+void jdts_reader_set_period(int32_t period_us);
+
+// the region every batch is published to, NULL for none
+void jdts_reader_set_shared(struct techartms_jdts_shm_t *shm);
+
+// takes over the write end of a pipe, which gets the records due every 'period_ns', all of
+// them for 0. Returns 0 or -errno, the fd is closed on failure
+int jdts_reader_add_stream(int fd, int64_t period_ns);
+int jdts_reader_get_stream_count(void);
+// fills 'out' with a (period_ns, written, dropped) triple per stream, returns their count
+int jdts_reader_get_stream_stats(int64_t *out, size_t max_count);
+
+// takes the samples of a sensor stream due at 'period_ns', every one for 0. A quarter of
+// the period of slack absorbs the jitter of the sensor timestamps, and a late sample moves
+// the next one due rather than letting the later ones catch up
+struct jdts_decimator_t {
+    int64_t period_ns;
+    int64_t next_due_ns;
+    int started;
+};
+
+// restarts the decimation at a new period, the next sample is taken
+void jdts_decimator_reset(struct jdts_decimator_t *decimator, int64_t period_ns);
+// returns 1 if the sample taken at 'timestamp_ns' is due, else 0
+int jdts_decimator_take(struct jdts_decimator_t *decimator, int64_t timestamp_ns);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_READER_H
@@ -0,0 +1,252 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cutils/log.h>
+
+#include "jdts_rollup.h"
+
+#define     LOG_TAG  "TECHARTMS_JDTS"
+
+// a day of seconds, a month of minutes, two years of hours
+static const struct {
+    int64_t width_ms;
+    uint32_t capacity;
+    const char *name;
+} tier_config[JDTS_ROLLUP_TIER_COUNT] = {
+    { 1000LL,       24 * 3600,      "1s" },
+    { 60000LL,      30 * 24 * 60,   "1m" },
+    { 3600000LL,    2 * 365 * 24,   "1h" },
+};
+
+static int open_tier(struct jdts_rollup_tier_t *tier, const char *dir)
+{
+    char path[PATH_MAX];
+    uint8_t *header;
+    struct stat st;
+    uint32_t bucket_size, capacity;
+    int64_t width_ms;
+    int fresh;
+
+    snprintf(path, sizeof(path), "%s/rollup-%s.jtr", dir, tier->name);
+    tier->map_size = JDTS_ROLLUP_HEADER_SIZE + (size_t)tier->capacity * sizeof(struct jdts_rollup_bucket_t);
+
+    tier->fd = open(path, O_RDWR | O_CREAT, 0640);
+    if (tier->fd < 0 || fstat(tier->fd, &st) < 0) {
+        return -errno;
+    }
+    fresh = (st.st_size != (off_t)tier->map_size);
+    if (fresh && ftruncate(tier->fd, (off_t)tier->map_size) < 0) {
+        return -errno;
+    }
+
+    tier->map = mmap(NULL, tier->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, tier->fd, 0);
+    if (tier->map == MAP_FAILED) {
+        tier->map = NULL;
+        return -errno;
+    }
+    header = tier->map;
+    tier->newest = (int64_t *)(header + 24);
+    tier->buckets = (struct jdts_rollup_bucket_t *)(header + JDTS_ROLLUP_HEADER_SIZE);
+
+    memcpy(&bucket_size, header + 8, sizeof(bucket_size));
+    memcpy(&capacity, header + 12, sizeof(capacity));
+    memcpy(&width_ms, header + 16, sizeof(width_ms));
+    if (fresh || memcmp(header, JDTS_ROLLUP_MAGIC, 8) != 0 || bucket_size != sizeof(struct jdts_rollup_bucket_t) ||
+            capacity != tier->capacity || width_ms != tier->width_ms) {
+        // unknown layout, start over; index -1 marks an empty slot
+        memset(tier->map, 0, tier->map_size);
+        memset(tier->buckets, 0xff, (size_t)tier->capacity * sizeof(struct jdts_rollup_bucket_t));
+        bucket_size = sizeof(struct jdts_rollup_bucket_t);
+        memcpy(header + 8, &bucket_size, sizeof(bucket_size));
+        memcpy(header + 12, &tier->capacity, sizeof(tier->capacity));
+        memcpy(header + 16, &tier->width_ms, sizeof(tier->width_ms));
+        *tier->newest = -1;
+        memcpy(header, JDTS_ROLLUP_MAGIC, 8);
+        ALOGI("HAL - rollups: %s created", path);
+    }
+
+    return 0;
+}
+
+int jdts_rollup_open(struct jdts_rollup_t *rollup, const char *dir)
+{
+    int ret = 0;
+    int t;
+
+    memset(rollup, 0, sizeof(*rollup));
+    for (t = 0; t < JDTS_ROLLUP_TIER_COUNT; t++) {
+        rollup->tiers[t].width_ms = tier_config[t].width_ms;
+        rollup->tiers[t].capacity = tier_config[t].capacity;
+        rollup->tiers[t].name = tier_config[t].name;
+        rollup->tiers[t].fd = -1;
+    }
+
+    for (t = 0; t < JDTS_ROLLUP_TIER_COUNT && ret == 0; t++) {
+        ret = open_tier(&rollup->tiers[t], dir);
+    }
+    if (ret < 0) {
+        ALOGE("HAL - rollups: cannot open the %s tier in %s: %d", rollup->tiers[t - 1].name, dir, ret);
+        jdts_rollup_close(rollup);
+    }
+    return ret;
+}
+
+void jdts_rollup_close(struct jdts_rollup_t *rollup)
+{
+    struct jdts_rollup_tier_t *tier;
+    int t;
+
+    for (t = 0; t < JDTS_ROLLUP_TIER_COUNT; t++) {
+        tier = &rollup->tiers[t];
+        if (tier->map != NULL) {
+            msync(tier->map, tier->map_size, MS_ASYNC);
+            munmap(tier->map, tier->map_size);
+            tier->map = NULL;
+        }
+        if (tier->fd >= 0) {
+            close(tier->fd);
+            tier->fd = -1;
+        }
+    }
+}
+
+void jdts_rollup_add(struct jdts_rollup_t *rollup, const struct techartms_jdts_history_sample_t *sample)
+{
+    struct jdts_rollup_tier_t *tier;
+    struct jdts_rollup_bucket_t *bucket;
+    int64_t index;
+    int t, ch;
+
+    if (sample->time_ms < 0) {
+        return;
+    }
+
+    for (t = 0; t < JDTS_ROLLUP_TIER_COUNT; t++) {
+        tier = &rollup->tiers[t];
+        if (tier->map == NULL) {
+            continue;
+        }
+
+        index = sample->time_ms / tier->width_ms;
+        bucket = &tier->buckets[index % tier->capacity];
+
+        if (bucket->index != index) {
+            // the slot is newer than the sample when the clock was set back
+            if (bucket->index > index) {
+                continue;
+            }
+            bucket->index = index;
+            bucket->count = 0;
+            for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+                bucket->min[ch] = INT16_MAX;
+                bucket->max[ch] = INT16_MIN;
+                bucket->sum[ch] = 0;
+            }
+        }
+
+        bucket->count++;
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            if (sample->value[ch] < bucket->min[ch]) bucket->min[ch] = sample->value[ch];
+            if (sample->value[ch] > bucket->max[ch]) bucket->max[ch] = sample->value[ch];
+            bucket->sum[ch] += sample->value[ch];
+        }
+
+        if (index > *tier->newest) {
+            *tier->newest = index;
+        }
+    }
+}
+
+static void finish_point(struct techartms_jdts_rollup_t *point, const int64_t *sum)
+{
+    int ch;
+
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        point->mean[ch] = (float)((double)sum[ch] / point->count);
+    }
+}
+
+int jdts_rollup_query(const struct jdts_rollup_t *rollup, int64_t from_ms, int64_t to_ms,
+        int64_t resolution_ms, struct techartms_jdts_rollup_t *out, size_t max_count)
+{
+    const struct jdts_rollup_tier_t *tier = &rollup->tiers[0];
+    const struct jdts_rollup_bucket_t *bucket;
+    struct techartms_jdts_rollup_t *point = NULL;
+    int64_t sum[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int64_t step, first, last, index, group;
+    size_t count = 0;
+    int t, ch;
+
+    if (from_ms < 0 || to_ms <= from_ms || max_count == 0) {
+        return 0;
+    }
+
+    // the coarsest tier still fine enough, it also reaches furthest back
+    for (t = 1; t < JDTS_ROLLUP_TIER_COUNT; t++) {
+        if (rollup->tiers[t].width_ms <= resolution_ms) {
+            tier = &rollup->tiers[t];
+        }
+    }
+    if (tier->map == NULL || *tier->newest < 0) {
+        return tier->map == NULL ? -ENODEV : 0;
+    }
+
+    step = resolution_ms / tier->width_ms;
+    if (step < 1) {
+        step = 1;
+    }
+
+    // only the buckets still held by the ring
+    first = from_ms / tier->width_ms;
+    last = (to_ms - 1) / tier->width_ms;
+    if (first < *tier->newest - (int64_t)tier->capacity + 1) {
+        first = *tier->newest - (int64_t)tier->capacity + 1;
+    }
+    if (last > *tier->newest) {
+        last = *tier->newest;
+    }
+
+    for (index = first; index <= last; index++) {
+        bucket = &tier->buckets[index % tier->capacity];
+        if (bucket->index != index || bucket->count == 0) {
+            continue;
+        }
+
+        group = index / step;
+        if (point == NULL || point->start_ms != group * step * tier->width_ms) {
+            if (point != NULL) {
+                finish_point(point, sum);
+            }
+            if (count == max_count) {
+                point = NULL;
+                break;
+            }
+            point = &out[count++];
+            point->start_ms = group * step * tier->width_ms;
+            point->duration_ms = step * tier->width_ms;
+            point->count = 0;
+            for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+                point->min[ch] = bucket->min[ch];
+                point->max[ch] = bucket->max[ch];
+                sum[ch] = 0;
+            }
+        }
+
+        point->count += bucket->count;
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            if (bucket->min[ch] < point->min[ch]) point->min[ch] = bucket->min[ch];
+            if (bucket->max[ch] > point->max[ch]) point->max[ch] = bucket->max[ch];
+            sum[ch] += bucket->sum[ch];
+        }
+    }
+
+    if (point != NULL) {
+        finish_point(point, sum);
+    }
+    return (int)count;
+}
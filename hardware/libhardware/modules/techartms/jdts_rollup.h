@@ -0,0 +1,70 @@
+#ifndef ANDROID_TECHART_MS_JDTS_ROLLUP_H
+#define ANDROID_TECHART_MS_JDTS_ROLLUP_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+__BEGIN_DECLS
+
+/*
+Aggregates of the history at 1s, 1min and 1h. Every tier is a ring of fixed-size buckets
+in a file mapped into memory, "rollup-<width>.jtr" next to the history segments:
+
+header, 64 bytes:
+[0..7]      magic "JDTSRUP1"
+[8..11]     (uint32_t) bucket size
+[12..15]    (uint32_t) bucket count
+[16..23]    (int64_t) bucket width, ms
+[24..31]    (int64_t) newest bucket index
+
+bucket, 64 bytes: index (time_ms / width), sample count, per channel min/max and sum.
+
+A sample goes to slot index % count of every tier. A slot still holding an older index
+is reset first, so an update is a few compares and adds whatever the tier size.
+*/
+
+#define JDTS_ROLLUP_MAGIC           "JDTSRUP1"
+#define JDTS_ROLLUP_HEADER_SIZE     64
+#define JDTS_ROLLUP_TIER_COUNT      3
+
+struct jdts_rollup_bucket_t {
+    int64_t index;
+    uint32_t count;
+    uint32_t reserved;
+    int16_t min[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int16_t max[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int64_t sum[TECHART_MS_JDTS_CHANNEL_COUNT];
+};
+
+struct jdts_rollup_tier_t {
+    int64_t width_ms;
+    uint32_t capacity;
+    const char *name;
+
+    int fd;
+    void *map;
+    size_t map_size;
+    int64_t *newest;
+    struct jdts_rollup_bucket_t *buckets;
+};
+
+struct jdts_rollup_t {
+    struct jdts_rollup_tier_t tiers[JDTS_ROLLUP_TIER_COUNT];
+};
+
+// maps the tier files in 'dir', creating them as needed. Returns 0 or -errno
+int jdts_rollup_open(struct jdts_rollup_t *rollup, const char *dir);
+void jdts_rollup_close(struct jdts_rollup_t *rollup);
+
+void jdts_rollup_add(struct jdts_rollup_t *rollup, const struct techartms_jdts_history_sample_t *sample);
+
+// see query_rollups() in sensor_jdts_temperature.h
+int jdts_rollup_query(const struct jdts_rollup_t *rollup, int64_t from_ms, int64_t to_ms,
+        int64_t resolution_ms, struct techartms_jdts_rollup_t *out, size_t max_count);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_ROLLUP_H
@@ -0,0 +1,859 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cutils/log.h>
+
+#include "jdts_store.h"
+
+#define     LOG_TAG  "TECHARTMS_JDTS"
+
+#define     SEGMENT_NAME_FORMAT     "seg-%016llx.jts"
+// the widest varint encoding of a sample: sequence and time 10 bytes, int16 deltas 3 bytes
+#define     MAX_SAMPLE_BYTES        (10 + 10 + 3 * TECHART_MS_JDTS_CHANNEL_COUNT)
+#define     MAX_PAYLOAD_SIZE        (JDTS_STORE_BLOCK_SAMPLES * MAX_SAMPLE_BYTES)
+
+typedef struct techartms_jdts_history_sample_t history_sample_t;
+
+struct store_segment_t {
+    uint64_t first_sequence;
+    off_t size;
+};
+
+// in-memory copy of a block header
+struct store_block_t {
+    uint64_t first_sequence;
+    uint64_t last_sequence;
+    int64_t min_ms;
+    int64_t max_ms;
+    int16_t min[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int16_t max[TECHART_MS_JDTS_CHANNEL_COUNT];
+    uint32_t count;
+    uint32_t payload_size;
+    uint32_t crc;
+    size_t segment;
+    off_t payload_offset;
+};
+
+struct jdts_store_t {
+    char dir[PATH_MAX];
+
+    // guards the index and the pending samples: appends hold it, scans only while they
+    // pick the next block, so a slow visitor never holds the writer up
+    pthread_mutex_t lock;
+
+    struct store_segment_t *segments;
+    size_t segment_count;
+    size_t segment_capacity;
+    uint64_t total_bytes;
+    int fd;     // last segment, opened on the first write
+
+    struct store_block_t *blocks;
+    size_t block_count;
+    size_t block_capacity;
+
+    // samples waiting to fill a block
+    history_sample_t pending[JDTS_STORE_BLOCK_SAMPLES];
+    size_t pending_count;
+
+    int has_last;
+    uint64_t last_sequence;     // stored
+    // the HAL's sequence of the last appended sample, and what shifts it past the stored ones
+    int has_input;
+    uint64_t last_input;
+    uint64_t base;
+    // set while blocks fail to be written, the samples coming meanwhile are counted in
+    // 'dropped' once a block is full
+    int failing;
+    uint64_t dropped;
+
+    techartms_jdts_history_visitor_t observer;
+    void *observer_cookie;
+
+    // the block being written
+    uint8_t buffer[JDTS_STORE_BLOCK_HEADER_SIZE + MAX_PAYLOAD_SIZE];
+};
+
+// the state of one scan, on the heap of the scanning thread
+struct store_scan_t {
+    int fd;
+    uint64_t fd_segment;    // first sequence of the segment 'fd' is open on
+    uint8_t payload[MAX_PAYLOAD_SIZE];
+    history_sample_t decoded[JDTS_STORE_BLOCK_SAMPLES];
+    history_sample_t pending[JDTS_STORE_BLOCK_SAMPLES];
+    size_t pending_count;
+};
+
+static uint32_t crc_table[256];
+
+static uint32_t crc32(const uint8_t *data, size_t size)
+{
+    uint32_t crc = 0xffffffff;
+    size_t i;
+    int k;
+
+    if (crc_table[1] == 0) {
+        for (i = 0; i < 256; i++) {
+            uint32_t c = (uint32_t)i;
+            for (k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            crc_table[i] = c;
+        }
+    }
+
+    for (i = 0; i < size; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+static void put_le(uint8_t *p, uint64_t value, int size)
+{
+    int i;
+    for (i = 0; i < size; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t *p, int size)
+{
+    uint64_t value = 0;
+    int i;
+    for (i = 0; i < size; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+static uint8_t *put_varint(uint8_t *p, uint64_t value)
+{
+    while (value >= 0x80) {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *value)
+{
+    uint64_t v = 0;
+    int shift = 0;
+
+    while (p < end && shift < 64) {
+        v |= (uint64_t)(*p & 0x7f) << shift;
+        if ((*p++ & 0x80) == 0) {
+            *value = v;
+            return p;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static void segment_path(const struct jdts_store_t *store, uint64_t first_sequence, char *path, size_t size)
+{
+    char name[32];
+    snprintf(name, sizeof(name), SEGMENT_NAME_FORMAT, (unsigned long long)first_sequence);
+    snprintf(path, size, "%s/%s", store->dir, name);
+}
+
+static int grow(void **array, size_t *capacity, size_t count, size_t item_size)
+{
+    void *grown;
+    size_t new_capacity;
+
+    if (count < *capacity) {
+        return 0;
+    }
+    new_capacity = *capacity ? *capacity * 2 : 64;
+    grown = realloc(*array, new_capacity * item_size);
+    if (grown == NULL) {
+        return -ENOMEM;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+static void parse_block_header(const uint8_t *h, struct store_block_t *block)
+{
+    int ch;
+
+    block->count = (uint32_t)get_le(h + 4, 2);
+    block->payload_size = (uint32_t)get_le(h + 8, 4);
+    block->crc = (uint32_t)get_le(h + 12, 4);
+    block->first_sequence = get_le(h + 16, 8);
+    block->last_sequence = get_le(h + 24, 8);
+    block->min_ms = (int64_t)get_le(h + 32, 8);
+    block->max_ms = (int64_t)get_le(h + 40, 8);
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        block->min[ch] = (int16_t)get_le(h + 48 + 2 * ch, 2);
+        block->max[ch] = (int16_t)get_le(h + 56 + 2 * ch, 2);
+    }
+}
+
+// indexes the blocks of a segment, a block cut short by a crash ends the segment
+static int load_segment(struct jdts_store_t *store, size_t segment, int is_last)
+{
+    uint8_t header[JDTS_STORE_BLOCK_HEADER_SIZE];
+    struct store_block_t block;
+    char path[PATH_MAX];
+    struct stat st;
+    off_t offset = 0;
+    int fd;
+
+    segment_path(store, store->segments[segment].first_sequence, path, sizeof(path));
+    fd = open(path, is_last ? O_RDWR : O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        if (fd >= 0) close(fd);
+        return -errno;
+    }
+
+    while (offset + JDTS_STORE_BLOCK_HEADER_SIZE <= st.st_size) {
+        if (pread(fd, header, sizeof(header), offset) != sizeof(header) ||
+                get_le(header, 4) != JDTS_STORE_BLOCK_MAGIC) {
+            break;
+        }
+        parse_block_header(header, &block);
+        if (block.count == 0 || block.count > JDTS_STORE_BLOCK_SAMPLES ||
+                block.payload_size > MAX_PAYLOAD_SIZE ||
+                offset + JDTS_STORE_BLOCK_HEADER_SIZE + (off_t)block.payload_size > st.st_size) {
+            break;
+        }
+        block.segment = segment;
+        block.payload_offset = offset + JDTS_STORE_BLOCK_HEADER_SIZE;
+
+        if (grow((void **)&store->blocks, &store->block_capacity, store->block_count, sizeof(block)) < 0) {
+            close(fd);
+            return -ENOMEM;
+        }
+        store->blocks[store->block_count++] = block;
+        offset = block.payload_offset + block.payload_size;
+    }
+
+    if (offset < st.st_size) {
+        ALOGW("HAL - history: %s is damaged after %lld bytes", path, (long long)offset);
+        if (is_last && ftruncate(fd, offset) < 0) {
+            ALOGE("HAL - history: cannot truncate %s", path);
+        }
+    }
+
+    close(fd);
+    store->segments[segment].size = offset;
+    store->total_bytes += offset;
+    return 0;
+}
+
+static int compare_segments(const void *a, const void *b)
+{
+    uint64_t x = ((const struct store_segment_t *)a)->first_sequence;
+    uint64_t y = ((const struct store_segment_t *)b)->first_sequence;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+struct jdts_store_t *jdts_store_open(const char *dir)
+{
+    struct jdts_store_t *store;
+    struct dirent *entry;
+    unsigned long long first;
+    DIR *d;
+    size_t i;
+
+    if (mkdir(dir, 0750) < 0 && errno != EEXIST) {
+        ALOGE("HAL - history: cannot create %s: %d", dir, errno);
+        return NULL;
+    }
+
+    store = calloc(1, sizeof(*store));
+    if (store == NULL) {
+        return NULL;
+    }
+    strncpy(store->dir, dir, sizeof(store->dir) - 1);
+    store->fd = -1;
+    pthread_mutex_init(&store->lock, NULL);
+
+    d = opendir(dir);
+    if (d == NULL) {
+        pthread_mutex_destroy(&store->lock);
+        free(store);
+        return NULL;
+    }
+    while ((entry = readdir(d)) != NULL) {
+        if (sscanf(entry->d_name, "seg-%16llx.jts", &first) != 1) {
+            continue;
+        }
+        if (grow((void **)&store->segments, &store->segment_capacity, store->segment_count,
+                sizeof(struct store_segment_t)) < 0) {
+            break;
+        }
+        store->segments[store->segment_count].first_sequence = first;
+        store->segments[store->segment_count].size = 0;
+        store->segment_count++;
+    }
+    closedir(d);
+
+    if (store->segment_count > 1) {
+        qsort(store->segments, store->segment_count, sizeof(struct store_segment_t), compare_segments);
+    }
+    for (i = 0; i < store->segment_count; i++) {
+        load_segment(store, i, i + 1 == store->segment_count);
+    }
+
+    if (store->block_count > 0) {
+        store->has_last = 1;
+        store->last_sequence = store->blocks[store->block_count - 1].last_sequence;
+    }
+
+    ALOGI("HAL - history: %zu blocks in %zu segments, %llu bytes", store->block_count,
+            store->segment_count, (unsigned long long)store->total_bytes);
+    return store;
+}
+
+// removes the oldest segments while the store is over its size limit
+static void apply_retention(struct jdts_store_t *store)
+{
+    char path[PATH_MAX];
+    size_t dropped;
+    size_t i;
+
+    while (store->total_bytes > JDTS_STORE_MAX_BYTES && store->segment_count > 1) {
+        segment_path(store, store->segments[0].first_sequence, path, sizeof(path));
+        unlink(path);
+        store->total_bytes -= store->segments[0].size;
+
+        for (dropped = 0; dropped < store->block_count && store->blocks[dropped].segment == 0; dropped++) {
+        }
+        memmove(store->blocks, store->blocks + dropped, (store->block_count - dropped) * sizeof(struct store_block_t));
+        store->block_count -= dropped;
+        for (i = 0; i < store->block_count; i++) {
+            store->blocks[i].segment--;
+        }
+
+        memmove(store->segments, store->segments + 1, (store->segment_count - 1) * sizeof(struct store_segment_t));
+        store->segment_count--;
+    }
+}
+
+static size_t encode_block(const history_sample_t *samples, size_t count, struct store_block_t *block, uint8_t *payload)
+{
+    uint8_t *p = payload;
+    int64_t previous, previous_delta, delta;
+    size_t i;
+    int ch;
+
+    block->count = (uint32_t)count;
+    block->first_sequence = samples[0].sequence;
+    block->last_sequence = samples[count - 1].sequence;
+    block->min_ms = block->max_ms = samples[0].time_ms;
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        block->min[ch] = block->max[ch] = samples[0].value[ch];
+    }
+    for (i = 1; i < count; i++) {
+        if (samples[i].time_ms < block->min_ms) block->min_ms = samples[i].time_ms;
+        if (samples[i].time_ms > block->max_ms) block->max_ms = samples[i].time_ms;
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            if (samples[i].value[ch] < block->min[ch]) block->min[ch] = samples[i].value[ch];
+            if (samples[i].value[ch] > block->max[ch]) block->max[ch] = samples[i].value[ch];
+        }
+    }
+
+    for (i = 1; i < count; i++) {
+        p = put_varint(p, samples[i].sequence - samples[i - 1].sequence);
+    }
+
+    // a steady sampling period makes the deltas of deltas zero: one byte per sample
+    previous = block->min_ms;
+    previous_delta = 0;
+    for (i = 0; i < count; i++) {
+        delta = samples[i].time_ms - previous;
+        p = put_varint(p, zigzag(delta - previous_delta));
+        previous = samples[i].time_ms;
+        previous_delta = delta;
+    }
+
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        p = put_varint(p, zigzag(samples[0].value[ch]));
+        for (i = 1; i < count; i++) {
+            p = put_varint(p, zigzag((int64_t)samples[i].value[ch] - samples[i - 1].value[ch]));
+        }
+    }
+
+    block->payload_size = (uint32_t)(p - payload);
+    block->crc = crc32(payload, block->payload_size);
+    return block->payload_size;
+}
+
+static int decode_block(const struct store_block_t *block, const uint8_t *payload, history_sample_t *samples)
+{
+    const uint8_t *p = payload;
+    const uint8_t *end = payload + block->payload_size;
+    int64_t previous, previous_delta, delta;
+    int64_t value;
+    uint64_t v;
+    size_t i;
+    int ch;
+
+    if (crc32(payload, block->payload_size) != block->crc) {
+        return -EIO;
+    }
+
+    samples[0].sequence = block->first_sequence;
+    for (i = 1; i < block->count; i++) {
+        if ((p = get_varint(p, end, &v)) == NULL) return -EIO;
+        samples[i].sequence = samples[i - 1].sequence + v;
+    }
+
+    previous = block->min_ms;
+    previous_delta = 0;
+    for (i = 0; i < block->count; i++) {
+        if ((p = get_varint(p, end, &v)) == NULL) return -EIO;
+        delta = previous_delta + unzigzag(v);
+        samples[i].time_ms = previous + delta;
+        previous = samples[i].time_ms;
+        previous_delta = delta;
+    }
+
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        value = 0;
+        for (i = 0; i < block->count; i++) {
+            if ((p = get_varint(p, end, &v)) == NULL) return -EIO;
+            value += unzigzag(v);
+            samples[i].value[ch] = (int16_t)value;
+        }
+    }
+
+    return 0;
+}
+
+static int write_pending(struct jdts_store_t *store)
+{
+    struct store_block_t block;
+    struct store_segment_t *segment;
+    char path[PATH_MAX];
+    uint8_t *h = store->buffer;
+    size_t size;
+    size_t i;
+    int ch;
+
+    if (store->pending_count == 0) {
+        return 0;
+    }
+
+    size = encode_block(store->pending, store->pending_count, &block,
+            store->buffer + JDTS_STORE_BLOCK_HEADER_SIZE) + JDTS_STORE_BLOCK_HEADER_SIZE;
+
+    memset(h, 0, JDTS_STORE_BLOCK_HEADER_SIZE);
+    put_le(h, JDTS_STORE_BLOCK_MAGIC, 4);
+    put_le(h + 4, block.count, 2);
+    put_le(h + 8, block.payload_size, 4);
+    put_le(h + 12, block.crc, 4);
+    put_le(h + 16, block.first_sequence, 8);
+    put_le(h + 24, block.last_sequence, 8);
+    put_le(h + 32, (uint64_t)block.min_ms, 8);
+    put_le(h + 40, (uint64_t)block.max_ms, 8);
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        put_le(h + 48 + 2 * ch, (uint16_t)block.min[ch], 2);
+        put_le(h + 56 + 2 * ch, (uint16_t)block.max[ch], 2);
+    }
+
+    if (grow((void **)&store->blocks, &store->block_capacity, store->block_count, sizeof(block)) < 0 ||
+            grow((void **)&store->segments, &store->segment_capacity, store->segment_count,
+                sizeof(struct store_segment_t)) < 0) {
+        return -ENOMEM;
+    }
+
+    // a new segment when there is none yet or the last one is full
+    if (store->segment_count == 0 ||
+            store->segments[store->segment_count - 1].size + (off_t)size > JDTS_STORE_SEGMENT_BYTES) {
+        if (store->fd >= 0) {
+            fdatasync(store->fd);
+            close(store->fd);
+            store->fd = -1;
+        }
+        store->segments[store->segment_count].first_sequence = block.first_sequence;
+        store->segments[store->segment_count].size = 0;
+        store->segment_count++;
+    }
+
+    segment = &store->segments[store->segment_count - 1];
+    if (store->fd < 0) {
+        segment_path(store, segment->first_sequence, path, sizeof(path));
+        store->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0640);
+        if (store->fd < 0) {
+            return -errno;
+        }
+    }
+
+    // one write per block, header and payload together
+    if (write(store->fd, store->buffer, size) != (ssize_t)size) {
+        // drop a partial block so that the segment stays parseable
+        if (ftruncate(store->fd, segment->size) < 0) {
+            ALOGE("HAL - history: cannot roll back a failed write");
+        }
+        return -EIO;
+    }
+
+    block.segment = store->segment_count - 1;
+    block.payload_offset = segment->size + JDTS_STORE_BLOCK_HEADER_SIZE;
+    store->blocks[store->block_count++] = block;
+    segment->size += size;
+    store->total_bytes += size;
+
+    // only what is on disk, the rollups then never hold a sample the history lost
+    if (store->observer != NULL) {
+        for (i = 0; i < store->pending_count; i++) {
+            store->observer(store->observer_cookie, &store->pending[i]);
+        }
+    }
+    store->pending_count = 0;
+
+    apply_retention(store);
+    return 0;
+}
+
+// write_pending() for the appends, which keep the samples of a failed write and log once
+// when the writes start failing and once when they work again
+static int write_block(struct jdts_store_t *store)
+{
+    int ret = write_pending(store);
+
+    if (ret < 0 && !store->failing) {
+        ALOGE("HAL - history: cannot write a block: %d, its samples are kept", ret);
+        store->failing = 1;
+    } else if (ret == 0 && store->failing) {
+        ALOGI("HAL - history: blocks written again, %llu samples dropped since the open",
+                (unsigned long long)store->dropped);
+        store->failing = 0;
+    }
+    return ret;
+}
+
+int jdts_store_append(struct jdts_store_t *store, const struct techartms_jdts_history_sample_t *samples,
+        size_t count)
+{
+    history_sample_t *sample;
+    uint64_t sequence;
+    size_t i;
+    int ret = 0;
+
+    pthread_mutex_lock(&store->lock);
+    for (i = 0; i < count; i++) {
+        if (store->has_input && samples[i].sequence == store->last_input) {
+            continue;
+        }
+        // a new run of the HAL, or the first one on top of what is stored
+        if ((store->has_input && samples[i].sequence < store->last_input) ||
+                (!store->has_input && store->has_last && samples[i].sequence <= store->last_sequence)) {
+            store->base = store->last_sequence + 1 - samples[i].sequence;
+        }
+        store->last_input = samples[i].sequence;
+        store->has_input = 1;
+        sequence = samples[i].sequence + store->base;
+
+        // a block that could not be written is retried before it takes more
+        if (store->pending_count == JDTS_STORE_BLOCK_SAMPLES && write_block(store) < 0) {
+            store->dropped++;
+            store->last_sequence = sequence;
+            store->has_last = 1;
+            continue;
+        }
+
+        sample = &store->pending[store->pending_count++];
+        *sample = samples[i];
+        sample->sequence = sequence;
+        store->last_sequence = sequence;
+        store->has_last = 1;
+
+        if (store->pending_count == JDTS_STORE_BLOCK_SAMPLES ||
+                sample->time_ms - store->pending[0].time_ms >= JDTS_STORE_FLUSH_MS) {
+            ret = write_block(store);
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    return ret;
+}
+
+uint64_t jdts_store_get_dropped(struct jdts_store_t *store)
+{
+    uint64_t dropped;
+
+    pthread_mutex_lock(&store->lock);
+    dropped = store->dropped;
+    pthread_mutex_unlock(&store->lock);
+    return dropped;
+}
+
+void jdts_store_set_observer(struct jdts_store_t *store, techartms_jdts_history_visitor_t observer, void *cookie)
+{
+    store->observer = observer;
+    store->observer_cookie = cookie;
+}
+
+int jdts_store_flush(struct jdts_store_t *store)
+{
+    int ret;
+
+    pthread_mutex_lock(&store->lock);
+    ret = write_pending(store);
+    if (ret == 0 && store->fd >= 0) {
+        fdatasync(store->fd);
+    }
+    pthread_mutex_unlock(&store->lock);
+    return ret;
+}
+
+void jdts_store_close(struct jdts_store_t *store)
+{
+    if (jdts_store_flush(store) < 0) {
+        ALOGE("HAL - history: the last samples were not written");
+    }
+    if (store->fd >= 0) {
+        close(store->fd);
+    }
+    free(store->blocks);
+    free(store->segments);
+    pthread_mutex_destroy(&store->lock);
+    free(store);
+}
+
+// reads and decodes a block into scan->decoded, the segment stays open for the next block
+static int load_block(const struct jdts_store_t *store, const struct store_block_t *block,
+        uint64_t segment, struct store_scan_t *scan)
+{
+    char path[PATH_MAX];
+
+    if (scan->fd < 0 || scan->fd_segment != segment) {
+        if (scan->fd >= 0) close(scan->fd);
+        segment_path(store, segment, path, sizeof(path));
+        scan->fd = open(path, O_RDONLY);
+        scan->fd_segment = segment;
+        if (scan->fd < 0) {
+            return -errno;
+        }
+    }
+
+    if (pread(scan->fd, scan->payload, block->payload_size, block->payload_offset) != (ssize_t)block->payload_size) {
+        return -EIO;
+    }
+    return decode_block(block, scan->payload, scan->decoded);
+}
+
+static struct store_scan_t *scan_begin(void)
+{
+    struct store_scan_t *scan = malloc(sizeof(*scan));
+
+    if (scan != NULL) {
+        scan->fd = -1;
+        scan->pending_count = 0;
+    }
+    return scan;
+}
+
+static void scan_end(struct store_scan_t *scan)
+{
+    if (scan->fd >= 0) {
+        close(scan->fd);
+    }
+    free(scan);
+}
+
+// index of the first block ending at or after 'sequence', under the store lock
+static size_t find_block(const struct jdts_store_t *store, uint64_t sequence)
+{
+    size_t lo = 0;
+    size_t hi = store->block_count;
+    size_t mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (store->blocks[mid].last_sequence < sequence) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+typedef int (*sample_filter_t)(const history_sample_t *sample, uint64_t from, uint64_t to);
+
+static int in_time(const history_sample_t *sample, uint64_t from, uint64_t to)
+{
+    return sample->time_ms >= (int64_t)from && sample->time_ms < (int64_t)to;
+}
+
+static int in_sequence(const history_sample_t *sample, uint64_t from, uint64_t to)
+{
+    return sample->sequence >= from && sample->sequence < to;
+}
+
+// picks the next block to visit after 'next_sequence' under the lock, then reads it and
+// calls the visitor without it. Retention and new blocks move the index in between, so
+// the position is kept as a sequence rather than an index. Once there are no more blocks
+// the pending samples are copied out under the same lock, no sample is seen twice
+static int visit(struct jdts_store_t *store, int by_time, uint64_t from, uint64_t to,
+        techartms_jdts_history_visitor_t visitor, void *cookie)
+{
+    sample_filter_t accept = by_time ? in_time : in_sequence;
+    struct store_scan_t *scan = scan_begin();
+    struct store_block_t block;
+    uint64_t next_sequence = by_time ? 0 : from;
+    uint64_t segment = 0;
+    int found;
+    int visited = 0;
+    int stop = 0;
+    size_t b, i;
+
+    if (scan == NULL) {
+        return -ENOMEM;
+    }
+
+    while (!stop) {
+        found = 0;
+        pthread_mutex_lock(&store->lock);
+        for (b = find_block(store, next_sequence); b < store->block_count; b++) {
+            if (!by_time && store->blocks[b].first_sequence >= to) {
+                break;
+            }
+            // the wall clock may step back, so blocks are not sorted by time
+            if (by_time && (store->blocks[b].max_ms < (int64_t)from || store->blocks[b].min_ms >= (int64_t)to)) {
+                continue;
+            }
+            block = store->blocks[b];
+            segment = store->segments[block.segment].first_sequence;
+            found = 1;
+            break;
+        }
+        if (!found) {
+            memcpy(scan->pending, store->pending, store->pending_count * sizeof(history_sample_t));
+            scan->pending_count = store->pending_count;
+        }
+        pthread_mutex_unlock(&store->lock);
+
+        if (!found) {
+            break;
+        }
+        next_sequence = block.last_sequence + 1;
+
+        if (load_block(store, &block, segment, scan) < 0) {
+            ALOGE("HAL - history: skipping a damaged block at sequence %llu",
+                    (unsigned long long)block.first_sequence);
+            continue;
+        }
+        for (i = 0; i < block.count && !stop; i++) {
+            if (accept(&scan->decoded[i], from, to)) {
+                visited++;
+                stop = visitor(cookie, &scan->decoded[i]);
+            }
+        }
+    }
+
+    for (i = 0; i < scan->pending_count && !stop; i++) {
+        if (scan->pending[i].sequence >= next_sequence && accept(&scan->pending[i], from, to)) {
+            visited++;
+            stop = visitor(cookie, &scan->pending[i]);
+        }
+    }
+
+    scan_end(scan);
+    return visited;
+}
+
+int jdts_store_scan_time(struct jdts_store_t *store, int64_t from_ms, int64_t to_ms,
+        techartms_jdts_history_visitor_t visitor, void *cookie)
+{
+    return visit(store, 1, (uint64_t)from_ms, (uint64_t)to_ms, visitor, cookie);
+}
+
+int jdts_store_scan_sequence(struct jdts_store_t *store, uint64_t from_sequence, uint64_t to_sequence,
+        techartms_jdts_history_visitor_t visitor, void *cookie)
+{
+    return visit(store, 0, from_sequence, to_sequence, visitor, cookie);
+}
+
+struct range_state_t {
+    int count;
+    int16_t *min;
+    int16_t *max;
+};
+
+static void range_add(struct range_state_t *range, const int16_t *min, const int16_t *max, int count)
+{
+    int ch;
+
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        if (range->count == 0 || min[ch] < range->min[ch]) range->min[ch] = min[ch];
+        if (range->count == 0 || max[ch] > range->max[ch]) range->max[ch] = max[ch];
+    }
+    range->count += count;
+}
+
+static int range_visitor(void *cookie, const history_sample_t *sample)
+{
+    range_add((struct range_state_t *)cookie, sample->value, sample->value, 1);
+    return 0;
+}
+
+int jdts_store_range(struct jdts_store_t *store, int64_t from_ms, int64_t to_ms,
+        int16_t *min, int16_t *max)
+{
+    struct range_state_t range = { 0, min, max };
+    struct store_scan_t *scan = scan_begin();
+    const struct store_block_t *block;
+    size_t b, i;
+
+    if (scan == NULL) {
+        return -ENOMEM;
+    }
+
+    // no visitor to wait for, the lock is held throughout
+    pthread_mutex_lock(&store->lock);
+    for (b = 0; b < store->block_count; b++) {
+        block = &store->blocks[b];
+        if (block->max_ms < from_ms || block->min_ms >= to_ms) {
+            continue;
+        }
+        if (block->min_ms >= from_ms && block->max_ms < to_ms) {
+            range_add(&range, block->min, block->max, (int)block->count);
+            continue;
+        }
+
+        if (load_block(store, block, store->segments[block->segment].first_sequence, scan) < 0) {
+            continue;
+        }
+        for (i = 0; i < block->count; i++) {
+            if (in_time(&scan->decoded[i], (uint64_t)from_ms, (uint64_t)to_ms)) {
+                range_visitor(&range, &scan->decoded[i]);
+            }
+        }
+    }
+
+    for (i = 0; i < store->pending_count; i++) {
+        if (in_time(&store->pending[i], (uint64_t)from_ms, (uint64_t)to_ms)) {
+            range_visitor(&range, &store->pending[i]);
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    scan_end(scan);
+    return range.count;
+}
@@ -0,0 +1,94 @@
+#ifndef ANDROID_TECHART_MS_JDTS_STORE_H
+#define ANDROID_TECHART_MS_JDTS_STORE_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+__BEGIN_DECLS
+
+/*
+Long-term sample history: append-only segment files "seg-<first sequence>.jts" in one
+directory. A segment is a run of blocks of up to JDTS_STORE_BLOCK_SAMPLES samples, every
+block is a 64 byte header followed by a column-encoded payload, all little-endian.
+
+block header:
+[0..3]      (uint32_t) magic JDTS_STORE_BLOCK_MAGIC
+[4,5]       (uint16_t) sample count
+[6,7]       reserved
+[8..11]     (uint32_t) payload size
+[12..15]    (uint32_t) CRC32 of the payload
+[16..23]    (uint64_t) first sequence
+[24..31]    (uint64_t) last sequence
+[32..39]    (int64_t) earliest wall clock time, ms
+[40..47]    (int64_t) latest wall clock time, ms
+[48..55]    (int16_t) minimum value of every channel, 0.01C
+[56..63]    (int16_t) maximum value of every channel, 0.01C
+
+payload, every column is a run of varints:
+sequence    count-1 unsigned deltas, the first sequence is in the header
+time        count zigzag deltas of deltas, the first one relative to the earliest time
+channels    per channel: the first value and count-1 deltas, zigzag
+
+The sequence is the one the HAL gives the sample (techartms_jdts_batch_t.sequence). The
+HAL counts again from the synchro counter when it is opened again: a sequence not above
+the last stored one then shifts the rest of the run past it, so the stored sequence keeps
+growing across restarts. Block headers are kept in memory and let range queries skip
+whole blocks.
+*/
+
+#define JDTS_STORE_DIR              "/data/sensors/jdts"
+#define JDTS_STORE_BLOCK_MAGIC      0x3142444a  // "JDB1"
+#define JDTS_STORE_BLOCK_HEADER_SIZE 64
+#define JDTS_STORE_BLOCK_SAMPLES    1024
+// a partly filled block is written out after this long, bounding what a crash loses
+#define JDTS_STORE_FLUSH_MS         (10 * 60 * 1000)
+// both sizes can be lowered at build time, jdts_store_test does to go through the retention
+#ifndef JDTS_STORE_SEGMENT_BYTES
+#define JDTS_STORE_SEGMENT_BYTES    (4 * 1024 * 1024)
+#endif
+// the oldest segments are removed beyond this
+#ifndef JDTS_STORE_MAX_BYTES
+#define JDTS_STORE_MAX_BYTES        (64 * 1024 * 1024)
+#endif
+
+struct jdts_store_t;
+
+struct jdts_store_t *jdts_store_open(const char *dir);
+// writes out the pending block and closes the segment
+void jdts_store_close(struct jdts_store_t *store);
+
+// appends samples in the HAL's sequence order, with their wall clock time. Repeated reads
+// of one sample are stored once. When a block cannot be written its samples are kept for
+// the next attempt, the samples arriving while they fill a block are dropped and counted.
+// Returns 0 or the -errno of a failed block write
+int jdts_store_append(struct jdts_store_t *store, const struct techartms_jdts_history_sample_t *samples,
+        size_t count);
+int jdts_store_flush(struct jdts_store_t *store);
+// samples dropped since the open because the blocks could not be written
+uint64_t jdts_store_get_dropped(struct jdts_store_t *store);
+
+// 'observer' sees every sample once the block holding it is written, with the store lock
+// held. Its return value is ignored
+void jdts_store_set_observer(struct jdts_store_t *store, techartms_jdts_history_visitor_t observer, void *cookie);
+
+// visits stored samples with from_ms <= time < to_ms in sequence order, stops when the
+// visitor returns non-zero. Appends may go on meanwhile, the visitor is called without the
+// store lock. Returns the number of samples visited or -errno
+int jdts_store_scan_time(struct jdts_store_t *store, int64_t from_ms, int64_t to_ms,
+        techartms_jdts_history_visitor_t visitor, void *cookie);
+// the same for from_sequence <= sequence < to_sequence
+int jdts_store_scan_sequence(struct jdts_store_t *store, uint64_t from_sequence, uint64_t to_sequence,
+        techartms_jdts_history_visitor_t visitor, void *cookie);
+
+// minimum and maximum of every channel over from_ms <= time < to_ms. Blocks lying inside
+// the range are answered from their headers, only the edge blocks are decoded.
+// Returns the number of samples covered or -errno
+int jdts_store_range(struct jdts_store_t *store, int64_t from_ms, int64_t to_ms,
+        int16_t *min, int16_t *max);
+
+__END_DECLS
+
+#endif // ANDROID_TECHART_MS_JDTS_STORE_H
@@ -0,0 +1,443 @@
+/*
+ * Round trip test of the long-term history (jdts_store.c) on the host: samples appended
+ * through the store come back from a scan exactly as they went in, across a close and a
+ * reopen, a torn last block, restarts of the HAL's sequence and the removal of the oldest
+ * segments.
+ *
+ * jdts_store_test [dir]
+ *
+ * dir  the store is created under it, $TMPDIR or /tmp by default, and removed at the end
+ *
+ * Built with small JDTS_STORE_SEGMENT_BYTES and JDTS_STORE_MAX_BYTES (see Android.mk)
+ * so that the retention is reached in a few blocks. Exits with 1 on the first mismatch.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <hardware/sensor_jdts_temperature.h>
+
+#include "jdts_store.h"
+
+#define BATCH_SIZE          64
+// samples appended before the reopen, then after it: the second run goes past the retention
+#define FIRST_RUN_SAMPLES   5000
+#define SECOND_RUN_SAMPLES  (40 * JDTS_STORE_BLOCK_SAMPLES)
+// where the HAL's sequence starts again in the second run, below the stored ones
+#define RESTART_SEQUENCE    7
+
+typedef struct techartms_jdts_history_sample_t history_sample_t;
+
+// what the store should hold, in sequence order
+struct model_t {
+    history_sample_t *samples;
+    size_t count;
+    size_t capacity;
+    // the synthetic HAL: its sequence, the time and the values of its samples
+    uint64_t sequence;
+    int64_t time_ms;
+    int16_t value[TECHART_MS_JDTS_CHANNEL_COUNT];
+    uint32_t random;
+    // set when the HAL counts again from RESTART_SEQUENCE, the next stored sample then
+    // follows the last one
+    int restarted;
+};
+
+struct collect_t {
+    history_sample_t *samples;
+    size_t count;
+    size_t capacity;
+};
+
+#define CHECK(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "FAILED %s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            return -1; \
+        } \
+    } while (0)
+
+static uint32_t next_random(struct model_t *model)
+{
+    model->random = model->random * 1103515245 + 12345;
+    return model->random >> 8;
+}
+
+// the next samples of the synthetic HAL into 'samples', and the ones the store should keep
+// into the model: mostly consecutive sequences, some lost, some read twice, a jittery
+// period with the odd long pause, values walking around with jumps to the ends of the
+// int16 range
+static int generate(struct model_t *model, history_sample_t *samples, size_t count)
+{
+    history_sample_t *expected;
+    uint64_t step;
+    uint32_t r;
+    size_t i;
+    int ch;
+
+    for (i = 0; i < count; i++) {
+        r = next_random(model) % 100;
+        if (model->restarted) {
+            model->sequence = RESTART_SEQUENCE;
+            step = 1;
+        } else if (r < 3) {
+            step = 2 + next_random(model) % 5;
+        } else if (r < 6 && model->count > 0) {
+            // a repeated read, the store keeps it once
+            step = 0;
+        } else {
+            step = 1;
+        }
+        if (!model->restarted) {
+            model->sequence += step;
+        }
+
+        r = next_random(model) % 1000;
+        if (r == 0) {
+            model->time_ms += JDTS_STORE_FLUSH_MS + 1000;
+        } else {
+            model->time_ms += 9 + next_random(model) % 3;
+        }
+
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            r = next_random(model) % 500;
+            if (r == 0) {
+                model->value[ch] = 32767;
+            } else if (r == 1) {
+                model->value[ch] = -32768;
+            } else {
+                model->value[ch] = (int16_t)(model->value[ch] + (int)(next_random(model) % 21) - 10);
+            }
+            samples[i].value[ch] = model->value[ch];
+        }
+        samples[i].sequence = model->sequence;
+        samples[i].time_ms = model->time_ms;
+
+        if (step == 0) {
+            continue;
+        }
+        if (model->count == model->capacity) {
+            model->capacity = model->capacity ? model->capacity * 2 : 4096;
+            model->samples = realloc(model->samples, model->capacity * sizeof(*expected));
+            CHECK(model->samples != NULL, "out of memory");
+        }
+        expected = &model->samples[model->count];
+        *expected = samples[i];
+        if (model->count > 0) {
+            expected->sequence = model->samples[model->count - 1].sequence + step;
+        }
+        model->count++;
+        model->restarted = 0;
+    }
+    return 0;
+}
+
+static int append(struct jdts_store_t *store, struct model_t *model, size_t count)
+{
+    history_sample_t samples[BATCH_SIZE];
+    size_t done;
+    size_t n;
+    int ret;
+
+    for (done = 0; done < count; done += n) {
+        n = count - done < BATCH_SIZE ? count - done : BATCH_SIZE;
+        if (generate(model, samples, n) < 0) {
+            return -1;
+        }
+        ret = jdts_store_append(store, samples, n);
+        CHECK(ret == 0, "append failed: %d", ret);
+    }
+    return 0;
+}
+
+static int collect(void *cookie, const history_sample_t *sample)
+{
+    struct collect_t *out = cookie;
+
+    if (out->count == out->capacity) {
+        out->capacity = out->capacity ? out->capacity * 2 : 4096;
+        out->samples = realloc(out->samples, out->capacity * sizeof(*sample));
+        if (out->samples == NULL) {
+            return 1;
+        }
+    }
+    out->samples[out->count++] = *sample;
+    return 0;
+}
+
+static int compare_samples(const char *what, const history_sample_t *got, size_t got_count,
+        const history_sample_t *expected, size_t expected_count)
+{
+    size_t i;
+
+    CHECK(got_count == expected_count, "%s: %zu samples, %zu expected", what, got_count, expected_count);
+    for (i = 0; i < got_count; i++) {
+        CHECK(memcmp(&got[i], &expected[i], sizeof(got[i])) == 0,
+                "%s: sample %zu differs, sequence %llu time %lld, expected sequence %llu time %lld",
+                what, i, (unsigned long long)got[i].sequence, (long long)got[i].time_ms,
+                (unsigned long long)expected[i].sequence, (long long)expected[i].time_ms);
+    }
+    return 0;
+}
+
+// the whole store by sequence, a slice by sequence, a window by time and its min/max
+static int check_store(const char *what, struct jdts_store_t *store, const history_sample_t *expected,
+        size_t count)
+{
+    struct collect_t got;
+    int16_t min[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int16_t max[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int16_t expected_min[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int16_t expected_max[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int64_t from_ms, to_ms;
+    size_t first, last, i;
+    int in_window;
+    int ret;
+    int ch;
+
+    memset(&got, 0, sizeof(got));
+    ret = jdts_store_scan_sequence(store, 0, UINT64_MAX, collect, &got);
+    CHECK(ret == (int)got.count, "%s: scan returned %d for %zu samples", what, ret, got.count);
+    if (compare_samples(what, got.samples, got.count, expected, count) < 0) {
+        free(got.samples);
+        return -1;
+    }
+
+    first = count / 3;
+    last = count * 2 / 3;
+    got.count = 0;
+    jdts_store_scan_sequence(store, expected[first].sequence, expected[last].sequence, collect, &got);
+    if (compare_samples(what, got.samples, got.count, expected + first, last - first) < 0) {
+        free(got.samples);
+        return -1;
+    }
+
+    // the wall clock only moves forward here, a time window is a run of samples
+    from_ms = expected[first].time_ms;
+    to_ms = expected[last].time_ms;
+    got.count = 0;
+    jdts_store_scan_time(store, from_ms, to_ms, collect, &got);
+    for (i = first; i > 0 && expected[i - 1].time_ms >= from_ms; i--) {
+    }
+    first = i;
+    for (i = last; i > first && expected[i - 1].time_ms >= to_ms; i--) {
+    }
+    last = i;
+    if (compare_samples(what, got.samples, got.count, expected + first, last - first) < 0) {
+        free(got.samples);
+        return -1;
+    }
+    free(got.samples);
+
+    for (i = first; i < last; i++) {
+        in_window = i > first;
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            if (!in_window || expected[i].value[ch] < expected_min[ch]) expected_min[ch] = expected[i].value[ch];
+            if (!in_window || expected[i].value[ch] > expected_max[ch]) expected_max[ch] = expected[i].value[ch];
+        }
+    }
+    ret = jdts_store_range(store, from_ms, to_ms, min, max);
+    CHECK(ret == (int)(last - first), "%s: range covered %d samples, %zu expected", what, ret, last - first);
+    for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+        CHECK(min[ch] == expected_min[ch] && max[ch] == expected_max[ch],
+                "%s: range of channel %d is %d..%d, %d..%d expected", what, ch,
+                min[ch], max[ch], expected_min[ch], expected_max[ch]);
+    }
+
+    printf("%-24s %zu samples\n", what, count);
+    return 0;
+}
+
+// the size of the segments on disk, and the name of the last one
+static off_t store_size(const char *dir, char *last, size_t size)
+{
+    char path[PATH_MAX];
+    struct dirent *entry;
+    struct stat st;
+    off_t total = 0;
+    DIR *d;
+
+    last[0] = '\0';
+    d = opendir(dir);
+    if (d == NULL) {
+        return -1;
+    }
+    while ((entry = readdir(d)) != NULL) {
+        if (strncmp(entry->d_name, "seg-", 4) != 0) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if (stat(path, &st) == 0) {
+            total += st.st_size;
+        }
+        if (strcmp(entry->d_name, last) > 0) {
+            snprintf(last, size, "%s", entry->d_name);
+        }
+    }
+    closedir(d);
+    return total;
+}
+
+// the name of the oldest segment
+static const char *first_segment(const char *dir, char *first, size_t size)
+{
+    struct dirent *entry;
+    DIR *d;
+
+    first[0] = '\0';
+    d = opendir(dir);
+    if (d == NULL) {
+        return first;
+    }
+    while ((entry = readdir(d)) != NULL) {
+        if (strncmp(entry->d_name, "seg-", 4) == 0 &&
+                (first[0] == '\0' || strcmp(entry->d_name, first) < 0)) {
+            snprintf(first, size, "%s", entry->d_name);
+        }
+    }
+    closedir(d);
+    return first;
+}
+
+static void remove_store(const char *dir)
+{
+    char path[PATH_MAX];
+    struct dirent *entry;
+    DIR *d;
+
+    d = opendir(dir);
+    if (d != NULL) {
+        while ((entry = readdir(d)) != NULL) {
+            if (entry->d_name[0] != '.') {
+                snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+static int run(const char *dir)
+{
+    static const uint8_t torn[] = { 0x4a, 0x44, 0x42, 0x31, 0x10, 0x00 };
+    struct jdts_store_t *store;
+    struct model_t model;
+    struct collect_t got;
+    char path[PATH_MAX];
+    char last[NAME_MAX + 1];
+    size_t kept;
+    off_t size;
+    int fd;
+
+    memset(&model, 0, sizeof(model));
+    // the HAL's first sequence is the synchro counter, the empty store keeps it as it is
+    model.sequence = 65000;
+    model.time_ms = 1500000000000LL;
+    model.random = 1;
+
+    // encode and decode, the pending block included
+    store = jdts_store_open(dir);
+    CHECK(store != NULL, "cannot open a store in %s", dir);
+    if (append(store, &model, FIRST_RUN_SAMPLES) < 0 ||
+            check_store("written", store, model.samples, model.count) < 0) {
+        return -1;
+    }
+    jdts_store_close(store);
+
+    // the pending block was written out by the close
+    store = jdts_store_open(dir);
+    CHECK(store != NULL, "cannot reopen the store");
+    if (check_store("reopened", store, model.samples, model.count) < 0) {
+        return -1;
+    }
+    jdts_store_close(store);
+
+    // a crash in the middle of a block write: the reopen cuts the segment back
+    store_size(dir, last, sizeof(last));
+    snprintf(path, sizeof(path), "%s/%s", dir, last);
+    fd = open(path, O_WRONLY | O_APPEND);
+    CHECK(fd >= 0, "cannot open %s", path);
+    CHECK(write(fd, torn, sizeof(torn)) == sizeof(torn), "cannot damage %s", path);
+    close(fd);
+
+    // the HAL opened again counts from the start, the sequence goes on from the stored
+    // one. Halfway through the HAL starts over once more, then the oldest segments go
+    store = jdts_store_open(dir);
+    CHECK(store != NULL, "cannot reopen the damaged store");
+    model.restarted = 1;
+    if (check_store("after a torn block", store, model.samples, model.count) < 0 ||
+            append(store, &model, SECOND_RUN_SAMPLES / 2) < 0) {
+        return -1;
+    }
+    model.restarted = 1;
+    if (append(store, &model, SECOND_RUN_SAMPLES / 2) < 0) {
+        return -1;
+    }
+    CHECK(jdts_store_flush(store) == 0, "flush failed");
+
+    size = store_size(dir, last, sizeof(last));
+    CHECK(size > 0 && size <= JDTS_STORE_MAX_BYTES, "%lld bytes on disk, the limit is %d",
+            (long long)size, JDTS_STORE_MAX_BYTES);
+    // what is left is the newest samples, starting with a segment
+    memset(&got, 0, sizeof(got));
+    jdts_store_scan_sequence(store, 0, UINT64_MAX, collect, &got);
+    CHECK(got.count > 0 && got.count < model.count, "%zu samples kept out of %zu",
+            got.count, model.count);
+    kept = got.count;
+    free(got.samples);
+    snprintf(path, sizeof(path), "seg-%016llx.jts",
+            (unsigned long long)model.samples[model.count - kept].sequence);
+    CHECK(strcmp(first_segment(dir, last, sizeof(last)), path) == 0,
+            "the oldest segment left is %s, %s expected", last, path);
+    if (check_store("past the retention", store, model.samples + model.count - kept, kept) < 0) {
+        return -1;
+    }
+    jdts_store_close(store);
+
+    store = jdts_store_open(dir);
+    CHECK(store != NULL, "cannot reopen the store after the retention");
+    if (check_store("reopened after it", store, model.samples + model.count - kept, kept) < 0) {
+        return -1;
+    }
+    jdts_store_close(store);
+
+    printf("%lld bytes on disk for %zu samples, %.2f bytes/sample\n", (long long)size, kept,
+            (double)size / kept);
+    free(model.samples);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *tmp = getenv("TMPDIR");
+    char dir[PATH_MAX];
+    int ret;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [dir]\n", argv[0]);
+        return 1;
+    }
+    snprintf(dir, sizeof(dir), "%s/jdts_store_test.XXXXXX",
+            argc > 1 ? argv[1] : (tmp != NULL ? tmp : "/tmp"));
+    if (mkdtemp(dir) == NULL) {
+        fprintf(stderr, "cannot create a directory in %s\n", dir);
+        return 1;
+    }
+
+    ret = run(dir);
+    remove_store(dir);
+    if (ret < 0) {
+        return 1;
+    }
+    printf("PASSED\n");
+    return 0;
+}
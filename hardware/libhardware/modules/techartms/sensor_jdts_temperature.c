@@ -1,62 +1,380 @@
 #include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <cutils/log.h>
 #include <cutils/sockets.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <fcntl.h>
-#include <linux/i2c.h>
+#include <time.h>
 #include <hardware/sensor_jdts_temperature.h>
 
+#include "jdts_backend.h"
+#include "jdts_calibration.h"
+#include "jdts_capture.h"
+#include "jdts_compensation.h"
+#include "jdts_decode.h"
+#include "jdts_detect.h"
+#include "jdts_filter.h"
+#include "jdts_pipeline.h"
+#include "jdts_rollup.h"
+#include "jdts_store.h"
+
 #define     LOG_TAG  "TECHARTMS_JDTS"
-#define     DEVICE_NAME "/dev/jdts_temperature"
 
-#define     TECHART_MS_JDTS_MODE_CONTINOUS  0
-#define     TECHART_MS_JDTS_MODE_BURST      1
+// frames are collected on the stack and decoded by chunks of this size
+#define     READ_SAMPLES_CHUNK  64
+// samples the history stage queues for the history writer, the ones beyond are dropped
+#define     HISTORY_QUEUE_SIZE  4096
+// and the writer appends them to the store by chunks of this size
+#define     HISTORY_WRITE_CHUNK 256
+
+// the driver or a simulated sensor, see jdts_backend.h
+static struct jdts_backend_t backend;
+
+static char backend_name[JDTS_CAPTURE_DEVICE_SIZE];
+
+// built once at open, the per-sample cost is a table lookup
+static struct jdts_calibration_t calibration;
+// the compensated object temperature, loaded at open as well
+static struct jdts_compensation_t compensation;
+
+// the pipeline and the history are shared by read_sample() and read_samples() callers
+static pthread_mutex_t decode_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct jdts_pipeline_t pipeline;
+// stage state, in the pipeline's arena
+static struct jdts_filter_t *filter;
+static struct jdts_detect_t *detect;
+static struct jdts_store_t *history = NULL;
+// held by query_history() instead of decode_lock, set_history() takes both to swap the store
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+// the history stage only queues the samples, a thread of their own writes them to the
+// store and the rollups: segment writes, syncs and removals stay out of decode_lock
+static pthread_mutex_t history_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t history_queue_cond = PTHREAD_COND_INITIALIZER;
+static struct techartms_jdts_history_sample_t history_queue[HISTORY_QUEUE_SIZE];
+static size_t history_queue_head = 0;
+static size_t history_queue_count = 0;
+static uint64_t history_queue_dropped = 0;
+static int history_writer_stop = 0;
+static pthread_t history_writer;
+// the rollups are added to by the history writer and read by query_rollups()
+static pthread_mutex_t rollup_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct jdts_rollup_t rollup;
+static int has_rollup = 0;
+
+// recorder, see start_capture()
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int capturing = 0;
+static struct jdts_capture_writer_t capture;
+
+static void capture_frames(int status, const uint8_t *frames, size_t count)
+{
+    int64_t now = jdts_monotonic_ns();
+    size_t i;
+
+    pthread_mutex_lock(&capture_lock);
+    for (i = 0; capturing && i < count; i++) {
+        if (jdts_capture_write(&capture, now, status, frames + i * TECHART_MS_JDTS_FRAME_SIZE) < 0) {
+            ALOGE("HAL - cannot write to the capture, recording stopped");
+            jdts_capture_writer_close(&capture);
+            capturing = 0;
+        }
+    }
+    pthread_mutex_unlock(&capture_lock);
+}
+
+static int read_frame(uint8_t *frame)
+{
+    int ret = backend.ops->read_frame(&backend, frame);
+
+    // a cancelled wait is not a read of the sensor, it stays out of the capture
+    if (capturing && ret != -ECANCELED) {
+        capture_frames(ret, frame, 1);
+    }
+
+    return ret;
+}
+
+// returns the number of frames read, at least one, or -errno
+static int read_frames(uint8_t *frames, size_t max_count)
+{
+    int ret;
+
+    if (backend.ops->read_frames == NULL || max_count < 2) {
+        ret = read_frame(frames);
+        return ret < 0 ? ret : 1;
+    }
+
+    ret = backend.ops->read_frames(&backend, frames, max_count);
+    if (capturing && ret != -ECANCELED) {
+        capture_frames(ret < 0 ? ret : 0, frames, ret < 0 ? 1 : (size_t)ret);
+    }
+    return ret;
+}
+
+// CLOCK_REALTIME - CLOCK_MONOTONIC, turns read timestamps into wall clock for the history
+static int64_t realtime_offset_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec - jdts_monotonic_ns();
+}
+
+static int calibrate_stage(void *state, struct techartms_jdts_batch_t *batch, size_t first, size_t count)
+{
+    jdts_calibrate_samples(state, batch, first, count);
+    return 0;
+}
+
+static int compensate_stage(void *state, struct techartms_jdts_batch_t *batch, size_t first, size_t count)
+{
+    jdts_compensate_samples(state, batch, first, count);
+    return 0;
+}
+
+static int filter_stage(void *state, struct techartms_jdts_batch_t *batch, size_t first, size_t count)
+{
+    jdts_filter_samples(state, batch, first, count);
+    return 0;
+}
+
+static int detect_stage(void *state, struct techartms_jdts_batch_t *batch, size_t first, size_t count)
+{
+    jdts_detect_samples(state, batch, first, count);
+    return 0;
+}
+
+static int history_stage(void *state, struct techartms_jdts_batch_t *batch, size_t first, size_t count)
+{
+    struct techartms_jdts_history_sample_t *sample;
+    int64_t offset_ns;
+    size_t i;
+    int ch;
+
+    if (history == NULL) {
+        return 0;
+    }
+    offset_ns = realtime_offset_ns();
+
+    pthread_mutex_lock(&history_queue_lock);
+    for (i = first; i < first + count; i++) {
+        if (history_queue_count == HISTORY_QUEUE_SIZE) {
+            if (history_queue_dropped++ % HISTORY_QUEUE_SIZE == 0) {
+                ALOGE("HAL - the history writer is behind, %llu samples dropped",
+                        (unsigned long long)history_queue_dropped);
+            }
+            continue;
+        }
+        sample = &history_queue[(history_queue_head + history_queue_count++) % HISTORY_QUEUE_SIZE];
+        sample->sequence = batch->sequence[i];
+        sample->time_ms = (batch->timestamp_ns[i] + offset_ns) / 1000000LL;
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            sample->value[ch] = batch->value[ch][i];
+        }
+    }
+    pthread_cond_signal(&history_queue_cond);
+    pthread_mutex_unlock(&history_queue_lock);
+    return 0;
+}
+
+// appends what the history stage queues to 'arg', the store, until stopped and drained
+static void *history_writer_thread(void *arg)
+{
+    struct jdts_store_t *store = arg;
+    struct techartms_jdts_history_sample_t samples[HISTORY_WRITE_CHUNK];
+    size_t count;
+    size_t i;
+
+    pthread_mutex_lock(&history_queue_lock);
+    for (;;) {
+        while (history_queue_count == 0 && !history_writer_stop) {
+            pthread_cond_wait(&history_queue_cond, &history_queue_lock);
+        }
+        if (history_queue_count == 0) {
+            break;
+        }
+
+        count = history_queue_count < HISTORY_WRITE_CHUNK ? history_queue_count : HISTORY_WRITE_CHUNK;
+        for (i = 0; i < count; i++) {
+            samples[i] = history_queue[(history_queue_head + i) % HISTORY_QUEUE_SIZE];
+        }
+        history_queue_head = (history_queue_head + count) % HISTORY_QUEUE_SIZE;
+        history_queue_count -= count;
+        pthread_mutex_unlock(&history_queue_lock);
+
+        // the store logs and counts what it cannot write
+        jdts_store_append(store, samples, count);
+
+        pthread_mutex_lock(&history_queue_lock);
+    }
+    pthread_mutex_unlock(&history_queue_lock);
+
+    return NULL;
+}
+
+// waits for the writer to append what is queued and end
+static void stop_history_writer(void)
+{
+    pthread_mutex_lock(&history_queue_lock);
+    history_writer_stop = 1;
+    pthread_cond_signal(&history_queue_cond);
+    pthread_mutex_unlock(&history_queue_lock);
+
+    pthread_join(history_writer, NULL);
+    history_writer_stop = 0;
+}
+
+// decode -> calibrate -> compensate -> filter -> detect -> history, every stage in place
+// on the batch
+static int setup_pipeline(void)
+{
+    int ret = jdts_pipeline_init(&pipeline);
+
+    if (ret < 0) {
+        return ret;
+    }
+    filter = jdts_pipeline_alloc(&pipeline, sizeof(*filter));
+    detect = jdts_pipeline_alloc(&pipeline, sizeof(*detect));
+    if (filter == NULL || detect == NULL) {
+        jdts_pipeline_release(&pipeline);
+        return -ENOMEM;
+    }
+    jdts_filter_init(filter);
+    jdts_detect_init(detect, NULL);
+
+    if ((ret = jdts_pipeline_add(&pipeline, "calibrate", calibrate_stage, &calibration)) < 0 ||
+            (ret = jdts_pipeline_add(&pipeline, "compensate", compensate_stage, &compensation)) < 0 ||
+            (ret = jdts_pipeline_add(&pipeline, "filter", filter_stage, filter)) < 0 ||
+            (ret = jdts_pipeline_add(&pipeline, "detect", detect_stage, detect)) < 0 ||
+            (ret = jdts_pipeline_add(&pipeline, "history", history_stage, NULL)) < 0) {
+        jdts_pipeline_release(&pipeline);
+        return ret;
+    }
+    return 0;
+}
+
+static size_t decode_frames(const uint8_t *frames, const int64_t *timestamps, size_t count,
+        struct techartms_jdts_batch_t *batch)
+{
+    size_t decoded;
+
+    pthread_mutex_lock(&decode_lock);
+    decoded = jdts_pipeline_run(&pipeline, frames, timestamps, count, batch);
+    pthread_mutex_unlock(&decode_lock);
 
-int fd = 0;
+    return decoded;
+}
 
 int read_sample(unsigned short *psynchro, short *pobj_temp, short *pntc1_temp, short *pntc2_temp, short *pntc3_temp)
 {
     int ret = 0;
     unsigned char buffer[10];
+    int64_t timestamp;
+    uint16_t synchro;
+    uint64_t sequence;
+    uint16_t flags;
+    int16_t raw[TECHART_MS_JDTS_CHANNEL_COUNT];
+    int16_t value[TECHART_MS_JDTS_CHANNEL_COUNT];
+    float celsius[TECHART_MS_JDTS_CHANNEL_COUNT];
+    struct techartms_jdts_batch_t batch = {
+        .capacity = 1, .count = 0,
+        .synchro = &synchro, .sequence = &sequence, .timestamp_ns = &timestamp, .flags = &flags,
+        .raw = { &raw[0], &raw[1], &raw[2], &raw[3] },
+        .value = { &value[0], &value[1], &value[2], &value[3] },
+        .celsius = { &celsius[0], &celsius[1], &celsius[2], &celsius[3] },
+    };
     
     ALOGD("HAL -- read_sample() called");
 
-    ret = read(fd, (char*)buffer, sizeof(buffer));    
+    ret = read_frame(buffer);
     if (ret < 0) {
         ALOGE("HAL -- cannot read raw temperature data");
         return -1;
     }
+    timestamp = jdts_monotonic_ns();
 
-    if (psynchro)   *psynchro   = (unsigned short)(buffer[3] << 8 | buffer[2]);
-    if (pobj_temp)  *pobj_temp  = (short)(buffer[1] << 8 | buffer[0]);
-    if (pntc1_temp) *pntc1_temp = (short)(buffer[5] << 8 | buffer[4]);
-    if (pntc2_temp) *pntc2_temp = (short)(buffer[7] << 8 | buffer[6]);
-    if (pntc3_temp) *pntc3_temp = (short)(buffer[9] << 8 | buffer[8]);
+    decode_frames(buffer, &timestamp, 1, &batch);
+
+    if (psynchro)   *psynchro   = synchro;
+    if (pobj_temp)  *pobj_temp  = value[TECHART_MS_JDTS_CHANNEL_OBJ];
+    if (pntc1_temp) *pntc1_temp = value[TECHART_MS_JDTS_CHANNEL_NTC1];
+    if (pntc2_temp) *pntc2_temp = value[TECHART_MS_JDTS_CHANNEL_NTC2];
+    if (pntc3_temp) *pntc3_temp = value[TECHART_MS_JDTS_CHANNEL_NTC3];
 
     ALOGD("HAL - sample read OK");
     return 0;
 }
 
+int read_samples(struct techartms_jdts_batch_t *batch, size_t max_count)
+{
+    int ret = 0;
+    size_t total = 0;
+    size_t chunk;
+    size_t i, k;
+    int64_t now;
+    int drained = 0;
+    unsigned char frames[READ_SAMPLES_CHUNK * TECHART_MS_JDTS_FRAME_SIZE];
+    int64_t timestamps[READ_SAMPLES_CHUNK];
+
+    if (batch == NULL) {
+        ALOGE("HAL - read_samples() called with NULL batch");
+        return -1;
+    }
+
+    if (max_count > batch->capacity - batch->count) {
+        max_count = batch->capacity - batch->count;
+    }
+
+    while (total < max_count) {
+        chunk = max_count - total;
+        if (chunk > READ_SAMPLES_CHUNK) {
+            chunk = READ_SAMPLES_CHUNK;
+        }
+
+        // the driver FIFO hands out what it has queued in one read, those samples
+        // share the time of the read. Once the queue is drained the call returns
+        // rather than wait for the rest
+        drained = 0;
+        for (i = 0; i < chunk && !drained; i += ret) {
+            ret = read_frames(frames + i * TECHART_MS_JDTS_FRAME_SIZE, chunk - i);
+            if (ret < 0) {
+                break;
+            }
+            drained = (backend.ops->read_frames != NULL && (size_t)ret < chunk - i);
+            now = jdts_monotonic_ns();
+            for (k = i; k < i + ret; k++) {
+                timestamps[k] = now;
+            }
+        }
+
+        total += decode_frames(frames, timestamps, i, batch);
+
+        if (ret == -ECANCELED) {
+            break;
+        }
+        if (ret < 0) {
+            ALOGE("HAL - cannot read raw temperature data, %zu of %zu samples read", total, max_count);
+            return total > 0 ? (int)total : -1;
+        }
+        if (drained) {
+            break;
+        }
+    }
+
+    return (int)total;
+}
+
 int activate(unsigned char enabled)
 {
     int ret = 0;
-    unsigned char control_buffer[2]; 
-
-/* from driver
-[0] - first byte to write is a command type: power control or meas mode control    
-#define CMD_TYPE_POWER        0x00
-[1] - second byte to write is a command of power mode
-#define CMD_POWER_SLEEP       0x00
-#define CMD_POWER_WAKEUP      0x01
-*/
-
-    control_buffer[0] = 0x00; // CMD_TYPE_POWER
-    control_buffer[1] = enabled ? 0x01 /*CMD_POWER_WAKEUP*/ : 0x00 /*CMD_POWER_SLEEP*/;
-    
+
     ALOGD("HAL - activate(%d) called", enabled);
 
-    ret = write(fd, (char*)control_buffer, sizeof(control_buffer));
+    ret = backend.ops->write_command(&backend, JDTS_CMD_TYPE_POWER,
+            enabled ? JDTS_CMD_POWER_WAKEUP : JDTS_CMD_POWER_SLEEP);
     if (ret < 0) {
         ALOGE("HAL - cannot write activation state");
         return -1;
@@ -69,22 +387,11 @@ int activate(unsigned char enabled)
 int set_mode(unsigned char is_continuous)
 {
     int ret;
-    unsigned char control_buffer[2]; 
-
-/* from driver
-[0] - first byte to write is a command type: power control or meas mode control    
-#define CMD_TYPE_MEAS_MODE    0x01
-[1] - second byte to write is a command of measurement mode
-#define CMD_MEAS_MODE_CONT    0x00
-#define CMD_MEAS_MODE_BURST   0x01
-*/
-
-    control_buffer[0] = 0x01; // CMD_TYPE_MEAS_MODE
-    control_buffer[1] = is_continuous ? 0x00 /*CMD_MEAS_MODE_CONT*/ : 0x01 /*CMD_MEAS_MODE_BURST*/;
-    
+
     ALOGD("HAL -- set_mode(%d) called", is_continuous);
 
-    ret = write(fd, (char*)control_buffer, sizeof(control_buffer));
+    ret = backend.ops->write_command(&backend, JDTS_CMD_TYPE_MEAS_MODE,
+            is_continuous ? JDTS_CMD_MEAS_MODE_CONT : JDTS_CMD_MEAS_MODE_BURST);
     if (ret < 0) {
         ALOGE("HAL - cannot write mode state");
         return -1;
@@ -94,6 +401,193 @@ int set_mode(unsigned char is_continuous)
     return 0;
 }
 
+int start_capture(const char *path)
+{
+    int ret;
+
+    pthread_mutex_lock(&capture_lock);
+    if (capturing) {
+        jdts_capture_writer_close(&capture);
+        capturing = 0;
+    }
+    ret = jdts_capture_writer_open(&capture, path, backend_name, &calibration);
+    capturing = (ret == 0);
+    pthread_mutex_unlock(&capture_lock);
+
+    if (ret < 0) {
+        ALOGE("HAL - cannot start capture to %s: %d", path, ret);
+        return -1;
+    }
+
+    ALOGI("HAL - capturing to %s", path);
+    return 0;
+}
+
+int stop_capture(void)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&capture_lock);
+    if (capturing) {
+        ret = jdts_capture_writer_close(&capture);
+        capturing = 0;
+    }
+    pthread_mutex_unlock(&capture_lock);
+
+    if (ret < 0) {
+        ALOGE("HAL - capture was not written completely: %d", ret);
+        return -1;
+    }
+    return 0;
+}
+
+static int rollup_observer(void *cookie, const struct techartms_jdts_history_sample_t *sample)
+{
+    pthread_mutex_lock(&rollup_lock);
+    jdts_rollup_add(cookie, sample);
+    pthread_mutex_unlock(&rollup_lock);
+    return 0;
+}
+
+int set_history(const char *dir)
+{
+    struct jdts_store_t *store;
+    int ret = 0;
+
+    pthread_mutex_lock(&history_lock);
+    // the pipeline stops queueing, then the writer writes out what it had queued
+    pthread_mutex_lock(&decode_lock);
+    store = history;
+    history = NULL;
+    pthread_mutex_unlock(&decode_lock);
+    if (store != NULL) {
+        stop_history_writer();
+        jdts_store_close(store);
+    }
+    pthread_mutex_lock(&rollup_lock);
+    if (has_rollup) {
+        jdts_rollup_close(&rollup);
+        has_rollup = 0;
+    }
+    pthread_mutex_unlock(&rollup_lock);
+
+    if (dir != NULL) {
+        store = jdts_store_open(dir);
+        if (store == NULL) {
+            ALOGE("HAL - cannot open the history in %s", dir);
+            ret = -1;
+        } else {
+            // the history still works without rollups
+            pthread_mutex_lock(&rollup_lock);
+            has_rollup = (jdts_rollup_open(&rollup, dir) == 0);
+            pthread_mutex_unlock(&rollup_lock);
+            if (has_rollup) {
+                jdts_store_set_observer(store, rollup_observer, &rollup);
+            }
+
+            if (pthread_create(&history_writer, NULL, history_writer_thread, store) != 0) {
+                ALOGE("HAL - cannot start the history writer");
+                jdts_store_close(store);
+                pthread_mutex_lock(&rollup_lock);
+                if (has_rollup) {
+                    jdts_rollup_close(&rollup);
+                    has_rollup = 0;
+                }
+                pthread_mutex_unlock(&rollup_lock);
+                ret = -1;
+            } else {
+                pthread_mutex_lock(&decode_lock);
+                history = store;
+                pthread_mutex_unlock(&decode_lock);
+            }
+        }
+    }
+    pthread_mutex_unlock(&history_lock);
+
+    return ret;
+}
+
+int query_history(int64_t from_ms, int64_t to_ms, techartms_jdts_history_visitor_t visitor, void *cookie)
+{
+    int ret = -1;
+
+    // the store lets the history writer append while the visitor runs
+    pthread_mutex_lock(&history_lock);
+    if (history != NULL) {
+        ret = jdts_store_scan_time(history, from_ms, to_ms, visitor, cookie);
+    }
+    pthread_mutex_unlock(&history_lock);
+
+    return ret < 0 ? -1 : ret;
+}
+
+int query_rollups(int64_t from_ms, int64_t to_ms, int64_t resolution_ms,
+        struct techartms_jdts_rollup_t *out, size_t max_count)
+{
+    int ret = -1;
+
+    pthread_mutex_lock(&rollup_lock);
+    if (has_rollup) {
+        ret = jdts_rollup_query(&rollup, from_ms, to_ms, resolution_ms, out, max_count);
+    }
+    pthread_mutex_unlock(&rollup_lock);
+
+    return ret < 0 ? -1 : ret;
+}
+
+int set_filter(int channel, const struct techartms_jdts_filter_t *config)
+{
+    int ret;
+
+    pthread_mutex_lock(&decode_lock);
+    ret = jdts_filter_configure(filter, channel, config);
+    pthread_mutex_unlock(&decode_lock);
+
+    if (ret < 0) {
+        ALOGE("HAL - invalid filter for channel %d", channel);
+        return -1;
+    }
+    ALOGI("HAL - channel %d filter: type %d alpha %f q %f r %f", channel, config->type,
+            config->alpha, config->process_noise, config->measurement_noise);
+    return 0;
+}
+
+int get_stage_stats(struct techartms_jdts_stage_stats_t *out, size_t max_count)
+{
+    int ret;
+
+    pthread_mutex_lock(&decode_lock);
+    ret = jdts_pipeline_get_stats(&pipeline, out, max_count);
+    pthread_mutex_unlock(&decode_lock);
+
+    return ret;
+}
+
+int cancel_reads(int cancel)
+{
+    int ret = jdts_backend_cancel(&backend, cancel);
+
+    if (ret < 0) {
+        ALOGE("HAL - cannot %s the reads: %d", cancel ? "cancel" : "resume", ret);
+        return -1;
+    }
+    return 0;
+}
+
+static int close_techartms_jdts(struct hw_device_t *device)
+{
+    stop_capture();
+    set_history(NULL);
+    jdts_backend_close(&backend);
+    jdts_pipeline_release(&pipeline);
+    free(device);
+
+    ALOGD("HAL - closed");
+    return 0;
+}
+
+// 'name' selects the backend: "" for the driver, "sim:rate=100,errors=0.01" for
+// a simulated sensor and so on, see jdts_backend.h
 static int open_techartms_jdts(const struct hw_module_t* module, char const* name, struct hw_device_t** device)
 {
     int ret = 0;
@@ -112,17 +606,65 @@ static int open_techartms_jdts(const struct hw_module_t* module, char const* nam
     dev->common.tag = HARDWARE_DEVICE_TAG;
     dev->common.version = 0;
     dev->common.module = (struct hw_module_t*)module;
+    dev->common.close = close_techartms_jdts;
     dev->read_sample = read_sample;
     dev->activate = activate;
     dev->set_mode = set_mode;
+    dev->read_samples = read_samples;
+    dev->start_capture = start_capture;
+    dev->stop_capture = stop_capture;
+    dev->set_history = set_history;
+    dev->query_history = query_history;
+    dev->query_rollups = query_rollups;
+    dev->set_filter = set_filter;
+    dev->get_stage_stats = get_stage_stats;
+    dev->cancel_reads = cancel_reads;
 
-    *device = (struct hw_device_t*) dev;
+    ret = jdts_calibration_load(&calibration, JDTS_CALIBRATION_FILE);
+    if (ret == -ENOENT) {
+        ALOGI("HAL - no calibration in %s, raw values are reported", JDTS_CALIBRATION_FILE);
+    } else if (ret < 0) {
+        ALOGE("HAL - cannot load calibration from %s, the one in use is kept", JDTS_CALIBRATION_FILE);
+    } else {
+        ALOGI("HAL - calibration loaded from %s", JDTS_CALIBRATION_FILE);
+    }
+
+    ret = jdts_compensation_load(&compensation, JDTS_COMPENSATION_FILE);
+    if (ret == -ENOENT) {
+        ALOGI("HAL - no compensation model in %s, the object temperature is reported", JDTS_COMPENSATION_FILE);
+    } else if (ret < 0) {
+        ALOGE("HAL - cannot load the compensation model from %s", JDTS_COMPENSATION_FILE);
+    } else {
+        ALOGI("HAL - compensation model loaded from %s", JDTS_COMPENSATION_FILE);
+    }
 
-    fd = open(DEVICE_NAME, O_RDWR);
-    if (fd <= 0) {
+    ret = jdts_backend_open(&backend, name);
+    if (ret < 0) {
         ALOGE("HAL - cannot open device driver");
+        free(dev);
         return -1;
     }
+    strncpy(backend_name, name != NULL && name[0] != '\0' ? name : backend.ops->name, sizeof(backend_name) - 1);
+
+    // replayed data is corrected the way it was when it was recorded
+    if (backend.has_calibration) {
+        int ch;
+        memcpy(calibration.models, backend.calibration, sizeof(calibration.models));
+        for (ch = 0; ch < TECHART_MS_JDTS_CHANNEL_COUNT; ch++) {
+            jdts_calibration_build(&calibration, ch);
+        }
+        ALOGI("HAL - using the calibration provided by the '%s' backend", backend.ops->name);
+    }
+
+    ret = setup_pipeline();
+    if (ret < 0) {
+        ALOGE("HAL - cannot set up the processing pipeline");
+        jdts_backend_close(&backend);
+        free(dev);
+        return ret;
+    }
+
+    *device = (struct hw_device_t*) dev;
 
     ALOGD("HAL - has been initialized");
     return 0;
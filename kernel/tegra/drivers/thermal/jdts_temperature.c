@@ -23,6 +23,12 @@
 #include <linux/workqueue.h>      // Required to make IRQ event into deferred handler task
 #include <linux/mutex.h>          // Required to sync data buffer usage between IRQ-work and outer read requests
 #include <linux/delay.h>
+#include <linux/poll.h>           // poll() support for the sample FIFO
+#include <linux/wait.h>           // readers sleep until the IRQ work adds a sample
+#include <linux/sched.h>
+#include <linux/list.h>           // the open files and their power and mode votes
+
+#include "jdts_temperature.h"      // the commands written to the device, shared with user space
 
 #define  DEVICE_NAME "jdts_temperature"   ///< The device will appear at /dev/jdts_temperature using this value
 #define  CLASS_NAME  "jdts"               ///< The device class -- this is a character device driver
@@ -42,14 +48,27 @@ From address 0x08 10 bytes data has:
 [8,9] - (int16_t) ntc3 temperature in 0.01C
 */
 
-#define CMD_TYPE_POWER        0x00
-#define CMD_TYPE_MEAS_MODE    0x01
-
-#define CMD_POWER_SLEEP       0x00
-#define CMD_POWER_WAKEUP      0x01
+/*
+Every sample read on IRQ is also appended to a FIFO of FIFO_FRAMES frames. A read()
+of exactly I2C_DATA_SIZE bytes returns the latest sample as before, a read() of a
+larger multiple of I2C_DATA_SIZE returns the samples this file has not seen yet,
+oldest first, and the number of bytes read. It blocks until there is at least one
+sample unless the file is O_NONBLOCK. A reader falling more than FIFO_FRAMES behind
+loses the oldest samples, which shows as a jump of the measurements counter.
+*/
+#define FIFO_FRAMES           256  // a power of two
 
-#define CMD_MEAS_MODE_CONT    0x00
-#define CMD_MEAS_MODE_BURST   0x01
+/*
+A power or mode command written to a file is that file's vote, kept until it writes
+another one or is closed. The sensor is awake while any file votes for it and asleep
+while a file asks for sleep and none for a wake up; it measures continuously while any
+file asks for continuous mode and in bursts while a file asks for that and none for
+continuous mode. A process closing its file, or dying, thus drops its votes rather than
+leave the sensor off under another one. Once the last vote is gone the sensor returns
+to the state it had before the first one. A read in burst mode wakes the sensor for its
+measurement and then puts it back to what the votes ask for.
+*/
+#define VOTE_NONE             0xff
 
 MODULE_LICENSE("GPL");            ///< The license type -- this affects available functionality
 MODULE_AUTHOR("Pavel Akimov");    ///< The author -- visible when you use modinfo
@@ -65,14 +84,35 @@ static const u8 i2c_meas_mode_continuous[] = { 0x00, 0x20, 0x01, 0x01 };// a com
 static const u8 i2c_meas_mode_burst[] = { 0x00, 0x20, 0x01, 0x01 }; // FIXIT: a command to write I2C meas mode to the sensor
 static u8 sensor_data_buffer[I2C_DATA_SIZE] = { 0 }; ///< Data buffer for temperatures
 static u8 sensor_mode;                       ///< Continous - awake, burst - single meas after wake up
+static u8 sensor_power;                      ///< JDTS_CMD_POWER_*, the state outside of a burst read, under votes_mutex
+
+static u8 fifo_frames[FIFO_FRAMES][I2C_DATA_SIZE]; ///< Samples read on IRQ, a ring shared by all readers
+static u64 fifo_head;                        ///< Number of samples ever added, under read_data_mutex
+static DECLARE_WAIT_QUEUE_HEAD(fifo_wait);   ///< Readers waiting for a new sample
+
+/// Per open file state
+struct jdts_file {
+   u64 fifo_tail;                            ///< Next sample this file gets out of the FIFO
+   u8 power_vote;                            ///< JDTS_CMD_POWER_* or VOTE_NONE, under votes_mutex
+   u8 mode_vote;                             ///< JDTS_CMD_MEAS_MODE_* or VOTE_NONE, under votes_mutex
+   struct list_head node;                    ///< In jdts_files
+};
+
+static LIST_HEAD(jdts_files);                ///< The open files, under votes_mutex
+static DEFINE_MUTEX(votes_mutex);            ///< Serializes the votes and the commands they apply
+static int votes_held;                       ///< Whether some file votes, the idle state is saved then
+static u8 idle_power;                        ///< The state restored once no file votes
+static u8 idle_mode;
 
 // I2C client to access and write sensor parameters
 struct i2c_client *tms_jdts_i2c_client = NULL;
 
 // The prototype functions for the character driver -- must come before the struct definition
 static int dev_open(struct inode *, struct file *);
+static int dev_release(struct inode *, struct file *);
 static ssize_t dev_read(struct file *, char *, size_t, loff_t *);
 static ssize_t dev_write(struct file *, const char *, size_t, loff_t *);
+static unsigned int dev_poll(struct file *, poll_table *);
 
 // The prototype functions for the I2C characters
 static int tms_jdts_i2c_probe(struct i2c_client *client, const struct i2c_device_id *id);
@@ -80,6 +120,7 @@ static int tms_jdts_i2c_remove(struct i2c_client *i2c_client);
 static int tms_jdts_i2c_detect(struct i2c_client *client, struct i2c_board_info *info);
 
 static int execute_command(u8 type, u8 cmd);
+static int apply_votes_locked(void);
 static int set_sensor_power(u8 enabled);
 static int read_raw_temperatures(void);
 static irq_handler_t jdts_data_irq_handler(unsigned int irq, void *dev_id, struct pt_regs *regs);
@@ -98,8 +139,10 @@ static struct mutex read_data_mutex; /* shared between the threads */
 static struct file_operations fops =
 {
    .open = dev_open,
+   .release = dev_release,
    .read = dev_read,
-   .write = dev_write
+   .write = dev_write,
+   .poll = dev_poll
 };
 
 static const unsigned short normal_i2c[] = {
@@ -219,12 +262,13 @@ static int __init jdts_temperature_init(void){
    // *******************************************************
    // Configure sensor state
    // *******************************************************  
-   sensor_mode = CMD_MEAS_MODE_CONT;
-   err = execute_command(CMD_TYPE_MEAS_MODE, CMD_MEAS_MODE_CONT);
+   sensor_mode = JDTS_CMD_MEAS_MODE_CONT;
+   err = execute_command(JDTS_CMD_TYPE_MEAS_MODE, JDTS_CMD_MEAS_MODE_CONT);
    if (err < 0) {
       pr_err("TechartMicroSystems JDTS: Error: %s: sensor meas mode failed, error=%d\n", __func__, err);
       goto err_drv;
    }
+   sensor_power = gpio_get_value(GPIO_PWR_DOWN) ? JDTS_CMD_POWER_WAKEUP : JDTS_CMD_POWER_SLEEP;
 
    err = request_irq(
       tms_jdts_i2c_client->irq,
@@ -298,10 +342,126 @@ static void __exit jdts_temperature_exit(void) {
  *  @param filep A pointer to a file object (defined in linux/fs.h)
  */
 static int dev_open(struct inode *node, struct file *filep) {
+   struct jdts_file *jfile;
+
    printk(KERN_INFO "TechartMicroSystems JDTS: Open the LKM!\n");
+
+   jfile = kzalloc(sizeof(*jfile), GFP_KERNEL);
+   if (!jfile) {
+      return -ENOMEM;
+   }
+
+   // a new reader starts with the samples that come after the open
+   mutex_lock(&read_data_mutex);
+   jfile->fifo_tail = fifo_head;
+   mutex_unlock(&read_data_mutex);
+
+   jfile->power_vote = VOTE_NONE;
+   jfile->mode_vote = VOTE_NONE;
+   mutex_lock(&votes_mutex);
+   list_add(&jfile->node, &jdts_files);
+   mutex_unlock(&votes_mutex);
+
+   filep->private_data = jfile;
+   return 0;
+}
+
+/** @brief Drops the votes of the file and frees its FIFO position.
+ *  @param inode A pointer to a general device read-only data
+ *  @param filep A pointer to a file object
+ */
+static int dev_release(struct inode *node, struct file *filep) {
+   struct jdts_file *jfile = filep->private_data;
+
+   mutex_lock(&votes_mutex);
+   list_del(&jfile->node);
+   if (jfile->power_vote != VOTE_NONE || jfile->mode_vote != VOTE_NONE) {
+      apply_votes_locked();
+   }
+   mutex_unlock(&votes_mutex);
+
+   kfree(jfile);
+   filep->private_data = NULL;
    return 0;
 }
 
+/** @brief Copies the samples the file has not seen yet, up to 'count', to user space.
+ *  Called with read_data_mutex held.
+ *  @return the number of samples copied or a negative error
+ */
+static ssize_t fifo_copy_locked(struct jdts_file *jfile, char *buffer, size_t count) {
+   size_t copied = 0;
+   size_t index, run;
+
+   // overrun: skip what has been overwritten already
+   if (fifo_head - jfile->fifo_tail > FIFO_FRAMES) {
+      jfile->fifo_tail = fifo_head - FIFO_FRAMES;
+   }
+
+   if (count > fifo_head - jfile->fifo_tail) {
+      count = fifo_head - jfile->fifo_tail;
+   }
+
+   // at most two contiguous runs of the ring
+   while (copied < count) {
+      index = (size_t)(jfile->fifo_tail & (FIFO_FRAMES - 1));
+      run = min(count - copied, (size_t)FIFO_FRAMES - index);
+      if (copy_to_user(buffer + copied * I2C_DATA_SIZE, fifo_frames[index], run * I2C_DATA_SIZE) != 0) {
+         return copied > 0 ? (ssize_t)copied : -EFAULT;
+      }
+      jfile->fifo_tail += run;
+      copied += run;
+   }
+
+   return copied;
+}
+
+/** @brief Reads queued samples, see the FIFO description at the top.
+ *  @return the number of bytes read or a negative error
+ */
+static ssize_t dev_read_fifo(struct file *filep, char *buffer, size_t len) {
+   struct jdts_file *jfile = filep->private_data;
+   ssize_t ret;
+
+   for (;;) {
+      mutex_lock(&read_data_mutex);
+      ret = fifo_copy_locked(jfile, buffer, len / I2C_DATA_SIZE);
+      mutex_unlock(&read_data_mutex);
+
+      if (ret != 0) {
+         return ret < 0 ? ret : ret * I2C_DATA_SIZE;
+      }
+
+      if (filep->f_flags & O_NONBLOCK) {
+         return -EAGAIN;
+      }
+
+      ret = wait_event_interruptible(fifo_wait, ACCESS_ONCE(fifo_head) != jfile->fifo_tail);
+      if (ret != 0) {
+         return -ERESTARTSYS;
+      }
+   }
+}
+
+/** @brief Reports the file readable while it has samples in the FIFO.
+ *  @param filep A pointer to a file object
+ *  @param wait The poll table
+ */
+static unsigned int dev_poll(struct file *filep, poll_table *wait) {
+   struct jdts_file *jfile = filep->private_data;
+   unsigned int mask = 0;
+
+   poll_wait(filep, &fifo_wait, wait);
+
+   mutex_lock(&read_data_mutex);
+   if (fifo_head != jfile->fifo_tail) {
+      mask |= POLLIN | POLLRDNORM;
+   }
+   mutex_unlock(&read_data_mutex);
+
+   return mask;
+}
+
 /** @brief This function is called whenever device is being read from user space i.e. data is
  *  being sent from the device to the user.
  *  @param filep A pointer to a file object (defined in linux/fs.h)
@@ -314,15 +474,22 @@ static ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *of
 
    printk(KERN_INFO "TechartMicroSystems JDTS: dev_read() called\n");
 
+   if (buffer && len > I2C_DATA_SIZE && len % I2C_DATA_SIZE == 0) {
+      return dev_read_fifo(filep, buffer, len);
+   }
+
    if (!buffer || len != I2C_DATA_SIZE) {
       pr_err(KERN_INFO "TechartMicroSystems JDTS: Output buffer is NULL or data len equals zero\n");
       return -EINVAL;
    }
 
-   if (sensor_mode == CMD_MEAS_MODE_BURST) {
+   // the whole cycle under votes_mutex, so that no vote changes the sensor under it
+   mutex_lock(&votes_mutex);
+   if (sensor_mode == JDTS_CMD_MEAS_MODE_BURST) {
       // wake up sensor
       ret = set_sensor_power(1);
       if (ret < 0) {
+         mutex_unlock(&votes_mutex);
          return ret;
       }
 
@@ -334,14 +501,15 @@ static ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *of
       mutex_lock(&read_data_mutex);
       ret = read_raw_temperatures();
       mutex_unlock(&read_data_mutex);
+
+      // back to the power the votes ask for rather than off
+      apply_votes_locked();
       if (ret < 0) {
-         set_sensor_power(0);
+         mutex_unlock(&votes_mutex);
          return ret;
       }
-
-      // sleep off sensor
-      set_sensor_power(0);
    }
+   mutex_unlock(&votes_mutex);
 
    mutex_lock(&read_data_mutex);
    ret = copy_to_user(buffer, sensor_data_buffer, I2C_DATA_SIZE);
@@ -359,13 +527,15 @@ static ssize_t dev_read(struct file *filep, char *buffer, size_t len, loff_t *of
 /** @brief Write command takes two bytes array pointer (see above):
  *  [0] - command type
  *  [1] - command argument
- *  which basically can switch device`s power mode or change the measurement mode
+ *  which is the file's vote for the device`s power mode or the measurement mode, see the
+ *  votes description at the top
  *  @param filep A pointer to a file object
  *  @param buffer The buffer to that contains the string to write to the device
  *  @param len The length of the array of data that is being passed in the const char buffer
  *  @param offset The offset if required
  */
 static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, loff_t *offset){
+   struct jdts_file *jfile = filep->private_data;
    int ret;
    u8 raw_buffer[2];
 
@@ -382,11 +552,82 @@ static ssize_t dev_write(struct file *filep, const char *buffer, size_t len, lof
       return -ENOMEM;
    }
 
-   ret = execute_command(raw_buffer[0], raw_buffer[1]);
-   if (ret == 0) {
-      printk(KERN_INFO "TechartMicroSystems JDTS: dev_write() call OK\n");
+   if ((raw_buffer[0] == JDTS_CMD_TYPE_POWER &&
+            raw_buffer[1] != JDTS_CMD_POWER_WAKEUP && raw_buffer[1] != JDTS_CMD_POWER_SLEEP) ||
+         (raw_buffer[0] == JDTS_CMD_TYPE_MEAS_MODE &&
+            raw_buffer[1] != JDTS_CMD_MEAS_MODE_CONT && raw_buffer[1] != JDTS_CMD_MEAS_MODE_BURST) ||
+         (raw_buffer[0] != JDTS_CMD_TYPE_POWER && raw_buffer[0] != JDTS_CMD_TYPE_MEAS_MODE)) {
+      pr_err(KERN_INFO "TechartMicroSystems JDTS: invalid command to write\n");
+      return -EINVAL;
+   }
+
+   mutex_lock(&votes_mutex);
+   if (raw_buffer[0] == JDTS_CMD_TYPE_POWER) {
+      jfile->power_vote = raw_buffer[1];
+   } else {
+      jfile->mode_vote = raw_buffer[1];
+   }
+   ret = apply_votes_locked();
+   mutex_unlock(&votes_mutex);
+
+   if (ret < 0) {
+      return ret;
+   }
+
+   printk(KERN_INFO "TechartMicroSystems JDTS: dev_write() call OK\n");
+   return 0;
+}
+
+/** @brief Puts the sensor in the state the votes of the open files ask for, see the votes
+ *  description at the top. Called with votes_mutex held.
+ *  @return 0 or the error of the command that failed
+ */
+static int apply_votes_locked(void) {
+   struct jdts_file *jfile;
+   int wakeup = 0, sleep = 0, continuous = 0, burst = 0;
+   u8 power = sensor_power;
+   u8 mode = sensor_mode;
+   int ret;
+
+   list_for_each_entry(jfile, &jdts_files, node) {
+      wakeup |= jfile->power_vote == JDTS_CMD_POWER_WAKEUP;
+      sleep |= jfile->power_vote == JDTS_CMD_POWER_SLEEP;
+      continuous |= jfile->mode_vote == JDTS_CMD_MEAS_MODE_CONT;
+      burst |= jfile->mode_vote == JDTS_CMD_MEAS_MODE_BURST;
    }
 
+   if (wakeup || sleep || continuous || burst) {
+      if (!votes_held) {
+         votes_held = 1;
+         idle_power = sensor_power;
+         idle_mode = sensor_mode;
+      }
+      if (wakeup || sleep) {
+         power = wakeup ? JDTS_CMD_POWER_WAKEUP : JDTS_CMD_POWER_SLEEP;
+      }
+      if (continuous || burst) {
+         mode = continuous ? JDTS_CMD_MEAS_MODE_CONT : JDTS_CMD_MEAS_MODE_BURST;
+      }
+   } else if (votes_held) {
+      votes_held = 0;
+      power = idle_power;
+      mode = idle_mode;
+   }
+
+   // the mode first, so that the sensor wakes up in the mode it is wanted in
+   if (mode != sensor_mode) {
+      ret = execute_command(JDTS_CMD_TYPE_MEAS_MODE, mode);
+      if (ret < 0) {
+         return ret;
+      }
+   }
+   // the line too, a burst read leaves the sensor on
+   if (power != sensor_power || (gpio_get_value(GPIO_PWR_DOWN) != 0) != (power == JDTS_CMD_POWER_WAKEUP)) {
+      ret = execute_command(JDTS_CMD_TYPE_POWER, power);
+      if (ret < 0) {
+         return ret;
+      }
+   }
    return 0;
 }
 
@@ -396,37 +637,40 @@ static int execute_command(u8 type, u8 cmd) {
    write_message.addr = I2C_SLAVE_ADDRESS;
    write_message.flags = 0; // plain write
 
-   if (type == CMD_TYPE_POWER) {
-      if (cmd == CMD_POWER_WAKEUP) {
+   if (type == JDTS_CMD_TYPE_POWER) {
+      if (cmd == JDTS_CMD_POWER_WAKEUP) {
          ret = set_sensor_power(1);
          if (ret < 0) {
             pr_err(KERN_INFO "TechartMicroSystems JDTS: Cannot wake up the sensor\n");
             return ret;
          }
-      } else if (cmd == CMD_POWER_SLEEP) {
+         sensor_power = JDTS_CMD_POWER_WAKEUP;
+      } else if (cmd == JDTS_CMD_POWER_SLEEP) {
          ret = set_sensor_power(0);
          if (ret < 0) {
             pr_err(KERN_INFO "TechartMicroSystems JDTS: Cannot sleep off the sensor\n");
             return ret;
          }
+         sensor_power = JDTS_CMD_POWER_SLEEP;
       } else {
          pr_err(KERN_INFO "TechartMicroSystems JDTS: invalid power mode to write\n");
          return -EINVAL;
       }
-   } else if (type == CMD_TYPE_MEAS_MODE) {
-      if (cmd == CMD_MEAS_MODE_CONT) {
+   } else if (type == JDTS_CMD_TYPE_MEAS_MODE) {
+      if (cmd == JDTS_CMD_MEAS_MODE_CONT) {
          write_message.buf = (char*)i2c_meas_mode_continuous;
          write_message.len = sizeof(i2c_meas_mode_continuous);
          ret = i2c_transfer(tms_jdts_i2c_client->adapter, &write_message, 1);
-         if (ret == 0)
-            sensor_mode = CMD_MEAS_MODE_CONT;
+         // the number of messages transferred
+         if (ret == 1)
+            sensor_mode = JDTS_CMD_MEAS_MODE_CONT;
 
-      } else if (cmd == CMD_MEAS_MODE_BURST) {
+      } else if (cmd == JDTS_CMD_MEAS_MODE_BURST) {
          write_message.buf = (char*)i2c_meas_mode_burst;
          write_message.len = sizeof(i2c_meas_mode_burst);
          ret = i2c_transfer(tms_jdts_i2c_client->adapter, &write_message, 1);
-         if (ret == 0)
-            sensor_mode = CMD_MEAS_MODE_BURST;
+         if (ret == 1)
+            sensor_mode = JDTS_CMD_MEAS_MODE_BURST;
 
       } else {
          pr_err(KERN_INFO "TechartMicroSystems JDTS: invalid measurement mode to write\n");
@@ -435,7 +679,7 @@ static int execute_command(u8 type, u8 cmd) {
 
       if (ret <= 0) {
          pr_err(KERN_INFO "TechartMicroSystems JDTS: Cannot write measurement mode command\n");
-         return ret;
+         return ret < 0 ? ret : -EIO;
       }
    } else {
       pr_err(KERN_INFO "TechartMicroSystems JDTS: invalid command type to apply\n");
@@ -498,8 +742,16 @@ static void read_data_work_handler(struct work_struct *w) {
 
    mutex_lock(&read_data_mutex);
    ret = read_raw_temperatures();
+   if (ret == 0) {
+      memcpy(fifo_frames[fifo_head & (FIFO_FRAMES - 1)], sensor_data_buffer, I2C_DATA_SIZE);
+      fifo_head++;
+   }
    mutex_unlock(&read_data_mutex);
 
+   if (ret == 0) {
+      wake_up_interruptible(&fifo_wait);
+   }
+
    printk(KERN_INFO "TechartMicroSystems JDTS: read_data_work_handler. Ret = %d\n", ret);
 }
  
@@ -0,0 +1,19 @@
+/**
+ * @file   jdts_temperature.h
+ * @brief  The commands of the /dev/jdts_temperature driver, shared with the user space
+ * tools writing them. A command is a write() of two bytes: [0] - command type, [1] - argument.
+ */
+
+#ifndef _JDTS_TEMPERATURE_H
+#define _JDTS_TEMPERATURE_H
+
+#define JDTS_CMD_TYPE_POWER        0x00
+#define JDTS_CMD_TYPE_MEAS_MODE    0x01
+
+#define JDTS_CMD_POWER_SLEEP       0x00
+#define JDTS_CMD_POWER_WAKEUP      0x01
+
+#define JDTS_CMD_MEAS_MODE_CONT    0x00
+#define JDTS_CMD_MEAS_MODE_BURST   0x01
+
+#endif /* _JDTS_TEMPERATURE_H */
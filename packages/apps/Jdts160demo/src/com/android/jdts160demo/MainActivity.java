@@ -2,6 +2,7 @@ package com.android.jdts160demo;
 
 import android.app.Activity;
 import android.os.Bundle;
+import android.os.Handler;
 import android.util.Log;
 import android.widget.CompoundButton;
 import android.widget.ImageView;
@@ -14,10 +15,25 @@ public class MainActivity extends Activity {
 
     private final String TAG = "jdts160demo";
 
-    private final int POLLING_PERIOD_MS = 200;
+    // the gauges are refreshed at most this often in continuous mode
+    private final int SAMPLING_PERIOD_US = 200000;
+    // and in burst mode, which the service only runs for clients reading no faster
+    private final int BURST_SAMPLING_PERIOD_US = 1000000;
+    // the IRQ led dims when no sample has come for this many periods
+    private final int NO_DATA_PERIODS = 5;
+    // the gauges show 0.01C, a sample differing by less would not change them; the
+    // heartbeat keeps the IRQ led lit while the temperature is flat
+    private final int CHANGE_THRESHOLD = 1;
+    // the needles follow an exponential average of the delivered readings, the weight of
+    // a new one; the HAL filter is shared by every client of the service, not the demo's
+    private final float NEEDLE_ALPHA = 0.3f;
 
     private JdtsManager mServiceManager = null;
     private JdtsTemperatureData mSensorData = null;
+    private int mNoDataTimeoutMs;
+    private final float[] mNeedles = new float[JdtsTemperatureData.CHANNEL_COUNT];
+    private final float[] mReadings = new float[JdtsTemperatureData.CHANNEL_COUNT];
+    private boolean mHasNeedles = false;
 
     private GaugeView mGaugeObj;
     private GaugeView mGaugeNtc1;
@@ -32,31 +48,33 @@ public class MainActivity extends Activity {
     private TextView mTextNtc3;
 
     // all temperatures are .2 points precision values in degrees Celsius
-    final private Object mDataSync = new Object();
-    private boolean mMeasModeUpdateRequired;
-    // set up when user switches between measurement modes and queues I2C expander command
-    // to switch the mode
-    private boolean mIsContinuousMode;
-    // continuous mode (power is always on, no control)
-    // burst mode (every cycle power on, read and power off required)
-
-    private boolean mPowerState;
-    private boolean mPowerUpdateRequired;
-
-    private Thread mCommThread = null;
-    private boolean mIsRunning = true; // the communication thread goes on unless onDestroy method is called
-        
+
+    private final Handler mHandler = new Handler();
+
+    // samples are pushed by the service on the UI thread, no polling thread is needed
+    private final JdtsManager.SampleListener mSampleListener = new JdtsManager.SampleListener() {
+        @Override
+        public void onSamples(JdtsTemperatureData[] samples) {
+            mSensorData = samples[samples.length - 1];
+            updateUI();
+
+            mHandler.removeCallbacks(mNoDataRunnable);
+            mHandler.postDelayed(mNoDataRunnable, mNoDataTimeoutMs);
+        }
+    };
+
+    private final Runnable mNoDataRunnable = new Runnable() {
+        @Override
+        public void run() {
+            updateNonIRQUI();
+        }
+    };
+
     @Override
     protected void onCreate(Bundle savedInstanceState) {
         super.onCreate(savedInstanceState);
         setContentView(R.layout.activity_main);
 
-        // enforce the sensor to switch into continuous mode on startup
-        mPowerUpdateRequired = true;
-        mPowerState = true;
-        mMeasModeUpdateRequired = true;
-        mIsContinuousMode = true;
-
         mIrqImage = (ImageView) findViewById(R.id.image_led_irq);
 
         mGaugeObj = (GaugeView) findViewById(R.id.gauge_view_obj);
@@ -70,14 +88,19 @@ public class MainActivity extends Activity {
         mTextNtc2 = (TextView) findViewById(R.id.text_ntc2);
         mTextNtc3 = (TextView) findViewById(R.id.text_ntc3);
 
+        mServiceManager = (JdtsManager) getSystemService(JDTS_TEMPERATURE_SERVICE);
+
+        // continuous mode: power is always on, no control
+        // burst mode: the sensor powers up for every sample, the gauges then refresh slower,
+        // a faster listener would keep the service in continuous mode
         Switch switch_mode = (Switch) findViewById(R.id.switch1);
         switch_mode.setOnCheckedChangeListener(new CompoundButton.OnCheckedChangeListener() {
             @Override
             public void onCheckedChanged(CompoundButton buttonView, boolean isChecked) {
-                synchronized (mDataSync) {
-                    mIsContinuousMode = isChecked;
-                    mMeasModeUpdateRequired = true;
+                if (!mServiceManager.setMode(isChecked)) {
+                    Log.w(TAG, "Cannot update measurement mode");
                 }
+                registerSampleListener(isChecked ? SAMPLING_PERIOD_US : BURST_SAMPLING_PERIOD_US);
             }
         });
 
@@ -85,120 +108,96 @@ public class MainActivity extends Activity {
         switch_power.setOnCheckedChangeListener(new CompoundButton.OnCheckedChangeListener() {
             @Override
             public void onCheckedChanged(CompoundButton buttonView, boolean isChecked) {
-                synchronized (mDataSync) {
-                    mPowerState = isChecked;
-                    mPowerUpdateRequired = true;
+                if (!mServiceManager.activate(isChecked)) {
+                    Log.w(TAG, "Cannot update power state");
                 }
             }
         });
         switch_power.setChecked(true); // power is on by default
 
-        mServiceManager = (JdtsManager) getSystemService(JDTS_TEMPERATURE_SERVICE);
+        // enforce the sensor to power on at startup
+        if (!mServiceManager.activate(true)) {
+            Log.w(TAG, "Cannot update power state");
+        }
 
-        mCommThread = new Thread() {
-            @Override
-            public void run() {
-                while(mIsRunning) {
-
-                    synchronized (mDataSync) {
-                        if (mPowerUpdateRequired) {
-                            if (mServiceManager.activate(mPowerState)) {
-                                mPowerUpdateRequired = false;
-                            } else {
-                                Log.w(TAG, "Cannot update power state");
-                            }
-                        }
-
-                        if (mMeasModeUpdateRequired) {
-                            if (mServiceManager.setMode(mIsContinuousMode)) {
-                                mMeasModeUpdateRequired = false;
-                            } else {
-                                Log.w(TAG, "Cannot update measurement mode");
-                            }
-                        }
-                    }
-
-                    mSensorData = mServiceManager.readSample();
-                    if (mSensorData != null) {
-                        updateUI();
-                    } else {
-                        updateNonIRQUI();
-                    }
-
-                    try {
-                        Thread.sleep(POLLING_PERIOD_MS);
-                    } catch (InterruptedException e) {
-                        e.printStackTrace();
-                    }
-                }
-            }
-        };
+        // continuous mode at startup, which registers for the samples
+        switch_mode.setChecked(true);
+    }
 
-        mCommThread.setUncaughtExceptionHandler(new Thread.UncaughtExceptionHandler() {
-            @Override
-            public void uncaughtException(Thread t, Throwable e) {
-                e.printStackTrace();
-            }
-        });
-        mCommThread.start();
+    // registering again updates the rate, the heartbeat keeps the IRQ led lit
+    private void registerSampleListener(int periodUs) {
+        mNoDataTimeoutMs = NO_DATA_PERIODS * periodUs / 1000;
+        if (!mServiceManager.registerListener(mSampleListener, periodUs, 0, false,
+                CHANGE_THRESHOLD, mNoDataTimeoutMs / 2, null)) {
+            Log.w(TAG, "Cannot register for samples");
+        }
+        mHandler.removeCallbacks(mNoDataRunnable);
+        mHandler.postDelayed(mNoDataRunnable, mNoDataTimeoutMs);
     }
 
     @Override
     protected void onDestroy() {
         super.onDestroy();
 
-        try {
-            mCommThread.join(POLLING_PERIOD_MS * 2);
-        } catch (InterruptedException e) {
-            e.printStackTrace();
-        }
+        mServiceManager.unregisterListener(mSampleListener);
+        // the power and mode switches are votes of this activity, not of the process
+        mServiceManager.releaseVotes();
+        mHandler.removeCallbacks(mNoDataRunnable);
     }
 
     private void updateUI() {
-        runOnUiThread(new Runnable() {
-            public void run() {
-                float obj_temp = mSensorData.objectTemperature / 100.F;
-                float ntc1_temp = mSensorData.ntc1Temperature / 100.F;
-                float ntc2_temp = mSensorData.ntc2Temperature / 100.F;
-                float ntc3_temp = mSensorData.ntc3Temperature / 100.F;
+        float obj_temp = mSensorData.objectTemperature / 100.F;
+        float ntc1_temp = mSensorData.ntc1Temperature / 100.F;
+        float ntc2_temp = mSensorData.ntc2Temperature / 100.F;
+        float ntc3_temp = mSensorData.ntc3Temperature / 100.F;
 
-                String s_obj = String.format("%.2f °C", obj_temp);
-                String s_ntc1 = String.format("%.2f °C", ntc1_temp);
-                String s_ntc2 = String.format("%.2f °C", ntc2_temp);
-                String s_ntc3 = String.format("%.2f °C", ntc3_temp);
-                String s_synchro = String.format("Synchro = %d", mSensorData.synchro);
+        String s_obj = String.format("%.2f °C", obj_temp);
+        String s_ntc1 = String.format("%.2f °C", ntc1_temp);
+        String s_ntc2 = String.format("%.2f °C", ntc2_temp);
+        String s_ntc3 = String.format("%.2f °C", ntc3_temp);
+        String s_synchro = String.format("Synchro = %d", mSensorData.synchro);
 
-                mGaugeObj.setTargetValue(obj_temp);
-                mTextObj.setText(s_obj);
+        // the needles move with the smoothed values, the text shows the readings
+        smoothNeedles(obj_temp, ntc1_temp, ntc2_temp, ntc3_temp);
+        mGaugeObj.setTargetValue(mNeedles[JdtsTemperatureData.CHANNEL_OBJECT]);
+        mTextObj.setText(s_obj);
 
-                mGaugeNtc1.setTargetValue(ntc1_temp);
-                mTextNtc1.setText(s_ntc1);
+        mGaugeNtc1.setTargetValue(mNeedles[JdtsTemperatureData.CHANNEL_NTC1]);
+        mTextNtc1.setText(s_ntc1);
 
-                mGaugeNtc2.setTargetValue(ntc2_temp);
-                mTextNtc2.setText(s_ntc2);
+        mGaugeNtc2.setTargetValue(mNeedles[JdtsTemperatureData.CHANNEL_NTC2]);
+        mTextNtc2.setText(s_ntc2);
 
-                mGaugeNtc3.setTargetValue(ntc3_temp);
-                mTextNtc3.setText(s_ntc3);
+        mGaugeNtc3.setTargetValue(mNeedles[JdtsTemperatureData.CHANNEL_NTC3]);
+        mTextNtc3.setText(s_ntc3);
 
-                mTextSynchro.setText(s_synchro);
+        mTextSynchro.setText(s_synchro);
 
-                mIrqImage.setImageDrawable(getResources().getDrawable(R.drawable.led_green_hi));
+        mIrqImage.setImageDrawable(getResources().getDrawable(R.drawable.led_green_hi));
 
-                Log.d(TAG, 
-                    s_synchro
-                    + "Obj = " + s_obj 
-                    + " NTC1 = " + s_ntc1 
-                    + " NTC2 = " + s_ntc2 
-                    + " NTC3 = " + s_ntc3);
-            }
-        });
+        Log.d(TAG, 
+            s_synchro
+            + "Obj = " + s_obj 
+            + " NTC1 = " + s_ntc1 
+            + " NTC2 = " + s_ntc2 
+            + " NTC3 = " + s_ntc3);
+    }
+
+    private void smoothNeedles(float obj, float ntc1, float ntc2, float ntc3) {
+        mReadings[JdtsTemperatureData.CHANNEL_OBJECT] = obj;
+        mReadings[JdtsTemperatureData.CHANNEL_NTC1] = ntc1;
+        mReadings[JdtsTemperatureData.CHANNEL_NTC2] = ntc2;
+        mReadings[JdtsTemperatureData.CHANNEL_NTC3] = ntc3;
+
+        for (int ch = 0; ch < JdtsTemperatureData.CHANNEL_COUNT; ch++) {
+            // the first reading sets the needle, there is nothing to average it with
+            mNeedles[ch] = mHasNeedles ? mNeedles[ch] + NEEDLE_ALPHA * (mReadings[ch] - mNeedles[ch])
+                    : mReadings[ch];
+        }
+        mHasNeedles = true;
     }
 
     private void updateNonIRQUI() {
-        runOnUiThread(new Runnable() {
-            public void run() {
-                mIrqImage.setImageDrawable(getResources().getDrawable(R.drawable.led_green_md));
-            }
-        });
+        mIrqImage.setImageDrawable(getResources().getDrawable(R.drawable.led_green_md));
     }
 }